@@ -0,0 +1,299 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstddef>
+
+//--------------------------------------------------------------------
+// 预分配的 64 字节对齐缓冲池：按 2 的幂分大小级，每级一个空闲链表。
+// 释放的块回到所属级的链表，不还给系统，稳态下的分配只是出入链表，
+// 不再触碰堆；从系统取得的总字节数不超过 limit（0 = 不限），
+// 超出时分配失败，内存占用有确定的上限。
+// 块在第一次用到时才向系统申请：开始服务前用 reserve() 或一次预热（见 HoldReleases）
+// 把稳态所需的块备好，之后的请求就不再触碰堆
+//--------------------------------------------------------------------
+struct BufferPoolStats {
+    // 从系统取得的字节数（含块头），不超过 limit
+    size_t reserved_bytes = 0;
+    // 正在使用的块的大小级字节数，及其峰值
+    size_t in_use_bytes = 0;
+    size_t peak_in_use_bytes = 0;
+    uint64_t allocations = 0;
+    // 链表为空、需要向系统申请的次数；预热之后应不再增长
+    uint64_t system_allocations = 0;
+    // 因超出 limit 而失败的次数
+    uint64_t failures = 0;
+};
+
+struct BufferPool {
+    static constexpr size_t kAlignment = 64;
+    // 最小的大小级为 64 字节，最大为 2^47
+    static constexpr int kMinClass = 6;
+    static constexpr int kClasses = 48;
+
+    explicit BufferPool(size_t limit_bytes = 0) : limit_(limit_bytes) {}
+
+    // 存续期间释放的块先扣住，析构时才回到空闲链表。用于开始服务前的预热：
+    // 依次做的几次分配各自取得自己的块，池中留下的块数如同它们同时进行。不可嵌套
+    struct HoldReleases {
+        explicit HoldReleases(BufferPool& pool) : pool(pool) { pool.holding_.store(true, std::memory_order_release); }
+        ~HoldReleases() { pool.releaseHeld(); }
+
+        HoldReleases(const HoldReleases&) = delete;
+        HoldReleases& operator=(const HoldReleases&) = delete;
+
+        BufferPool& pool;
+    };
+
+    // 把空闲链表中的块还给系统；仍在使用的块此时不应存在
+    ~BufferPool() { trim(); }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // 预先为 size 字节的请求备好 count 个块（如每种 batch 的输入/输出缓冲），超出 limit 时抛 std::bad_alloc
+    void reserve(size_t size, size_t count) {
+        const int cls = classFor(size);
+        if (cls >= kClasses) {
+            throw std::bad_alloc();
+        }
+        for (size_t i = 0; i < count; ++i) {
+            void* block = systemAllocate(cls);
+            if (!block) {
+                throw std::bad_alloc();
+            }
+            push(cls, static_cast<Block*>(block));
+        }
+    }
+
+    // 至少 size 字节、64 字节对齐的块；超出 limit 时返回 nullptr
+    void* tryAllocate(size_t size) {
+        const int cls = classFor(size);
+        if (cls >= kClasses) {
+            failures_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        void* block = pop(cls);
+        if (!block) {
+            block = systemAllocate(cls);
+            if (!block) {
+                return nullptr;
+            }
+        }
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        const size_t in_use = in_use_.fetch_add(classBytes(cls), std::memory_order_relaxed) + classBytes(cls);
+        size_t peak = peak_in_use_.load(std::memory_order_relaxed);
+        while (in_use > peak && !peak_in_use_.compare_exchange_weak(peak, in_use, std::memory_order_relaxed)) {
+        }
+        return block;
+    }
+
+    // 同上，失败时抛 std::bad_alloc
+    void* allocate(size_t size) {
+        void* p = tryAllocate(size);
+        if (!p) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    // 归还 allocate 得到的块；p 可为空
+    void release(void* p) {
+        if (!p) {
+            return;
+        }
+        const int cls = header(p)->cls;
+        in_use_.fetch_sub(classBytes(cls), std::memory_order_relaxed);
+        if (holding_.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(held_mutex_);
+            if (holding_.load(std::memory_order_relaxed)) {
+                Block* block = static_cast<Block*>(p);
+                block->next = held_;
+                held_ = block;
+                return;
+            }
+        }
+        push(cls, static_cast<Block*>(p));
+    }
+
+    // 把空闲链表中的块还给系统（不计入 limit 了），如预热在上限内放不下时退回按需分配
+    void trim() {
+        for (int cls = 0; cls < kClasses; ++cls) {
+            Class& c = classes_[cls];
+            std::lock_guard<std::mutex> lock(c.mutex);
+            while (c.free) {
+                Block* block = c.free;
+                c.free = block->next;
+                std::free(header(block));
+                reserved_.fetch_sub(classBytes(cls) + kAlignment, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t limit() const { return limit_; }
+
+    BufferPoolStats stats() const {
+        BufferPoolStats s;
+        s.reserved_bytes = reserved_.load(std::memory_order_relaxed);
+        s.in_use_bytes = in_use_.load(std::memory_order_relaxed);
+        s.peak_in_use_bytes = peak_in_use_.load(std::memory_order_relaxed);
+        s.allocations = allocations_.load(std::memory_order_relaxed);
+        s.system_allocations = system_allocations_.load(std::memory_order_relaxed);
+        s.failures = failures_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // Prometheus 文本格式的内存用量（与 Metrics::writePrometheus 并列输出）
+    void writePrometheus(std::ostream& out, const char* prefix = "mnist") const {
+        const BufferPoolStats s = stats();
+        out << "# HELP " << prefix << "_arena_bytes Tensor arena memory by state.\n"
+            << "# TYPE " << prefix << "_arena_bytes gauge\n"
+            << prefix << "_arena_bytes{state=\"reserved\"} " << s.reserved_bytes << '\n'
+            << prefix << "_arena_bytes{state=\"in_use\"} " << s.in_use_bytes << '\n'
+            << prefix << "_arena_bytes{state=\"peak_in_use\"} " << s.peak_in_use_bytes << '\n'
+            << prefix << "_arena_bytes{state=\"limit\"} " << limit_ << '\n'
+            << "# HELP " << prefix << "_arena_allocations_total Tensor arena allocations by source.\n"
+            << "# TYPE " << prefix << "_arena_allocations_total counter\n"
+            << prefix << "_arena_allocations_total{source=\"pool\"} " << s.allocations - s.system_allocations << '\n'
+            << prefix << "_arena_allocations_total{source=\"system\"} " << s.system_allocations << '\n'
+            << prefix << "_arena_allocations_total{source=\"failed\"} " << s.failures << '\n';
+    }
+
+    // 人读的一行摘要
+    void writeSummary(std::ostream& out) const {
+        const BufferPoolStats s = stats();
+        out << "arena: reserved=" << s.reserved_bytes / 1024 << "KiB in_use=" << s.in_use_bytes / 1024
+            << "KiB peak=" << s.peak_in_use_bytes / 1024 << "KiB limit=";
+        if (limit_) {
+            out << limit_ / 1024 << "KiB";
+        } else {
+            out << "none";
+        }
+        out << " allocations=" << s.allocations << " system=" << s.system_allocations
+            << " failed=" << s.failures << '\n';
+        out.flush();
+    }
+
+private:
+    // 每个块前面有一个对齐宽度的块头，记录所属的大小级；空闲时块体的开头存链表指针
+    struct Header {
+        int cls;
+    };
+    struct Block {
+        Block* next;
+    };
+
+    struct alignas(64) Class {
+        std::mutex mutex;
+        Block* free = nullptr;
+    };
+
+    static size_t classBytes(int cls) { return size_t(1) << cls; }
+
+    static int classFor(size_t size) {
+        if (size <= classBytes(kMinClass)) {
+            return kMinClass;
+        }
+        return 64 - __builtin_clzll(size - 1);
+    }
+
+    static Header* header(void* block) {
+        return reinterpret_cast<Header*>(static_cast<char*>(block) - kAlignment);
+    }
+
+    void* pop(int cls) {
+        Class& c = classes_[cls];
+        std::lock_guard<std::mutex> lock(c.mutex);
+        Block* block = c.free;
+        if (block) {
+            c.free = block->next;
+        }
+        return block;
+    }
+
+    void push(int cls, Block* block) {
+        Class& c = classes_[cls];
+        std::lock_guard<std::mutex> lock(c.mutex);
+        block->next = c.free;
+        c.free = block;
+    }
+
+    // 结束 HoldReleases：扣住的块回到各自的空闲链表
+    void releaseHeld() {
+        std::lock_guard<std::mutex> lock(held_mutex_);
+        holding_.store(false, std::memory_order_relaxed);
+        while (held_) {
+            Block* block = held_;
+            held_ = block->next;
+            push(header(block)->cls, block);
+        }
+    }
+
+    // 向系统申请一个 cls 级的块；计入 limit，超出时返回 nullptr
+    void* systemAllocate(int cls) {
+        const size_t bytes = classBytes(cls) + kAlignment;
+        size_t reserved = reserved_.load(std::memory_order_relaxed);
+        do {
+            if (limit_ && reserved + bytes > limit_) {
+                failures_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        } while (!reserved_.compare_exchange_weak(reserved, reserved + bytes, std::memory_order_relaxed));
+
+        void* base = std::aligned_alloc(kAlignment, bytes);
+        if (!base) {
+            reserved_.fetch_sub(bytes, std::memory_order_relaxed);
+            failures_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        system_allocations_.fetch_add(1, std::memory_order_relaxed);
+        static_cast<Header*>(base)->cls = cls;
+        return static_cast<char*>(base) + kAlignment;
+    }
+
+    const size_t limit_;
+    std::array<Class, kClasses> classes_;
+    std::atomic<size_t> reserved_{0};
+    std::atomic<size_t> in_use_{0};
+    std::atomic<size_t> peak_in_use_{0};
+    std::atomic<uint64_t> allocations_{0};
+    std::atomic<uint64_t> system_allocations_{0};
+    std::atomic<uint64_t> failures_{0};
+    // HoldReleases 期间释放的块
+    std::atomic<bool> holding_{false};
+    std::mutex held_mutex_;
+    Block* held_ = nullptr;
+};
+
+// 从 BufferPool 分配的 STL 分配器（如 std::promise 的共享状态）；pool 为空时用全局堆
+template <typename T>
+struct PoolStlAllocator {
+    using value_type = T;
+
+    explicit PoolStlAllocator(BufferPool* pool = nullptr) : pool(pool) {}
+    template <typename U>
+    PoolStlAllocator(const PoolStlAllocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(pool ? pool->allocate(n * sizeof(T)) : ::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t) {
+        if (pool) {
+            pool->release(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const PoolStlAllocator<U>& other) const { return pool == other.pool; }
+    template <typename U>
+    bool operator!=(const PoolStlAllocator<U>& other) const { return pool != other.pool; }
+
+    BufferPool* pool;
+};
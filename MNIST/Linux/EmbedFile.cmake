@@ -0,0 +1,21 @@
+# 用法：cmake -DINPUT=<模型文件> -DOUTPUT=<生成的 .cpp> -P EmbedFile.cmake
+# 把 INPUT 的全部字节写成 C++ 数组 embedded_model_data / embedded_model_size（见 ModelSource.h）
+file(READ "${INPUT}" hex HEX)
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${hex}")
+# 每行 16 字节（CMake 的正则不支持 {n}，手工拼出 16 次重复）
+set(group "")
+foreach(i RANGE 15)
+    string(APPEND group "0x[0-9a-f][0-9a-f],")
+endforeach()
+string(REGEX REPLACE "(${group})" "\\1\n    " bytes "${bytes}")
+get_filename_component(name "${INPUT}" NAME)
+file(WRITE "${OUTPUT}"
+"// 由 EmbedFile.cmake 从 ${name} 生成，请勿手工修改
+#include <cstddef>
+
+// ORT 格式模型会被会话直接引用，按缓存行对齐
+alignas(64) extern const unsigned char embedded_model_data[] = {
+    ${bytes}
+};
+extern const size_t embedded_model_size = sizeof(embedded_model_data);
+")
@@ -0,0 +1,272 @@
+#pragma once
+
+#ifdef MNIST_WITH_CUDA
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#include <cuda_runtime.h>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "MNISTModel.h"
+
+// GpuPreprocess.cu：n 张 width×height 的 u8 灰度画布 → n×28×28 的 float / half，在 stream 上异步执行
+cudaError_t gpuResizeGray(const uint8_t* src, size_t n, int width, int height, float* dst, cudaStream_t stream);
+cudaError_t gpuResizeGrayHalf(const uint8_t* src, size_t n, int width, int height, uint16_t* dst, cudaStream_t stream);
+
+static inline void cudaCheck(cudaError_t status, const char* what) {
+    if (status != cudaSuccess) {
+        throw std::runtime_error(std::string(what) + ": " + cudaGetErrorString(status));
+    }
+}
+
+// 持有一个 cudaStream_t；作为会话的计算流时须先于会话创建（见 SessionConfig::cuda_stream）、晚于它销毁
+struct CudaStream {
+    CudaStream() { cudaCheck(cudaStreamCreateWithFlags(&stream_, cudaStreamNonBlocking), "cudaStreamCreate"); }
+    ~CudaStream() { cudaStreamDestroy(stream_); }
+
+    CudaStream(const CudaStream&) = delete;
+    CudaStream& operator=(const CudaStream&) = delete;
+
+    cudaStream_t get() const { return stream_; }
+
+private:
+    cudaStream_t stream_ = nullptr;
+};
+
+//--------------------------------------------------------------------
+// CUDA / TensorRT 执行提供者下的批量推理流水线。输入、输出都绑定在显存上，
+// ORT 不再在每次 Run 时把 CPU 张量拷上拷下；主机侧只经由页锁定（pinned）的暂存缓冲做异步 DMA。
+// 有 slots 个槽位，每个槽位一组缓冲与一个拷贝流：第 k 批在计算流上推理时，
+// 第 k+1 批的上传与第 k-1 批的回传在各自的拷贝流上同时进行。
+// gpu_preprocess 时上传的是 u8 像素（只有 float 的 1/4），由 GpuPreprocess.cu 在显存里归一化。
+//
+// 会话须以 SessionConfig::cuda_stream = compute.get() 创建，Run 才与这里的事件同在一条流上；
+// 模型输入须为 float32 或 float16
+//--------------------------------------------------------------------
+struct GpuPipeline {
+    struct Options {
+        // 每批最多的图像数
+        size_t batch = 64;
+        // 同时在途的批数
+        size_t slots = 2;
+        // 在 GPU 上做缩放/归一化，而不是在主机上转换后上传
+        bool gpu_preprocess = false;
+        int device_id = 0;
+    };
+
+    GpuPipeline(MNISTModel& model, const CudaStream& compute, const Options& options)
+        : model_(model), compute_(compute.get()), options_(options),
+          device_memory_("Cuda", OrtDeviceAllocator, options.device_id, OrtMemTypeDefault) {
+        if (options_.batch == 0 || options_.slots == 0) {
+            throw std::invalid_argument("GPU pipeline needs a positive batch size and slot count");
+        }
+        if (!model_.acceptsBatch(options_.batch)) {
+            throw std::invalid_argument("GPU pipeline batch size does not match the model's N");
+        }
+        if (model_.inputType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8) {
+            throw std::invalid_argument("GPU pipeline needs a float32 or float16 model");
+        }
+        input_bytes_ = model_.inputType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16 ? sizeof(Half) : sizeof(float);
+        cudaCheck(cudaSetDevice(options_.device_id), "cudaSetDevice");
+        // Run 只把内核排进计算流，不等它算完；结果由槽位的事件同步
+        run_options_.AddConfigEntry("disable_synchronize_execution_providers", "1");
+
+        slots_.resize(options_.slots);
+        try {
+            for (Slot& s : slots_) {
+                allocate(s);
+            }
+        } catch (...) {
+            for (Slot& s : slots_) {
+                release(s);
+            }
+            throw;
+        }
+    }
+
+    ~GpuPipeline() {
+        for (Slot& s : slots_) {
+            if (s.busy) {
+                cudaEventSynchronize(s.output_ready);
+            }
+            release(s);
+        }
+    }
+
+    GpuPipeline(const GpuPipeline&) = delete;
+    GpuPipeline& operator=(const GpuPipeline&) = delete;
+
+    size_t slots() const { return slots_.size(); }
+
+    // 把 n 张 u8 灰度图（0 = 背景，28×28）交给槽位 slot：拷进 pinned 暂存区后异步上传、推理、回传，
+    // 不等 GPU 完成即返回。槽位须空闲（从未使用，或已 wait 过）
+    void submit(size_t slot, const uint8_t* gray, size_t n) {
+        Slot& s = slots_.at(slot);
+        if (s.busy) {
+            throw std::logic_error("GPU pipeline slot is still in flight");
+        }
+        if (n == 0 || n > options_.batch || !model_.acceptsBatch(n)) {
+            throw std::invalid_argument("batch does not fit the GPU pipeline");
+        }
+        if (n != s.bound) {
+            bind(s, n);
+        }
+
+        // 1) 主机侧：写入 pinned 暂存区（这一步与其他槽位在 GPU 上的工作重叠）
+        const size_t pixels = n * MNIST_IMAGE_SIZE;
+        {
+            StageTimer timer(model_.metrics_, Stage::Convert);
+            if (options_.gpu_preprocess) {
+                std::memcpy(s.host_input, gray, pixels);
+            } else {
+                model_.visitInputType([&](auto* tag) {
+                    using T = std::remove_pointer_t<decltype(tag)>;
+                    if constexpr (!std::is_same<T, uint8_t>::value) {
+                        grayToTensor(gray, pixels, static_cast<T*>(s.host_input));
+                    }
+                });
+            }
+        }
+
+        // 2) 拷贝流：上传（gpu_preprocess 时接着在显存里归一化）
+        if (options_.gpu_preprocess) {
+            cudaCheck(cudaMemcpyAsync(s.device_staging, s.host_input, pixels, cudaMemcpyHostToDevice, s.copy),
+                      "cudaMemcpyAsync");
+            const uint8_t* staged = static_cast<const uint8_t*>(s.device_staging);
+            cudaCheck(input_bytes_ == sizeof(float)
+                          ? gpuResizeGray(staged, n, MNIST_WIDTH, MNIST_HEIGHT, static_cast<float*>(s.device_input), s.copy)
+                          : gpuResizeGrayHalf(staged, n, MNIST_WIDTH, MNIST_HEIGHT,
+                                              static_cast<uint16_t*>(s.device_input), s.copy),
+                      "GPU preprocess");
+        } else {
+            cudaCheck(cudaMemcpyAsync(s.device_input, s.host_input, pixels * input_bytes_, cudaMemcpyHostToDevice, s.copy),
+                      "cudaMemcpyAsync");
+        }
+        cudaCheck(cudaEventRecord(s.input_ready, s.copy), "cudaEventRecord");
+
+        // 3) 计算流：等输入就绪后推理
+        cudaCheck(cudaStreamWaitEvent(compute_, s.input_ready, 0), "cudaStreamWaitEvent");
+        model_.onnx().session().Run(run_options_, s.io);
+        cudaCheck(cudaEventRecord(s.compute_done, compute_), "cudaEventRecord");
+
+        // 4) 拷贝流：等推理完成后回传 logits
+        cudaCheck(cudaStreamWaitEvent(s.copy, s.compute_done, 0), "cudaStreamWaitEvent");
+        cudaCheck(cudaMemcpyAsync(s.host_output, s.device_output, n * MNIST_CLASSES * sizeof(float),
+                                  cudaMemcpyDeviceToHost, s.copy),
+                  "cudaMemcpyAsync");
+        cudaCheck(cudaEventRecord(s.output_ready, s.copy), "cudaEventRecord");
+        s.busy = true;
+        s.n = n;
+    }
+
+    // 等槽位 slot 的结果并做 softmax（模型的 compute_probabilities_ 为 false 时保留 logits）；
+    // 返回 n×10 的结果（pinned 内存，该槽位下次 submit 前有效），predicted 非空时写入 n 个预测数字
+    const float* wait(size_t slot, int* predicted = nullptr) {
+        Slot& s = slots_.at(slot);
+        if (!s.busy) {
+            throw std::logic_error("GPU pipeline slot has nothing in flight");
+        }
+        {
+            StageTimer timer(model_.metrics_, Stage::Run);
+            cudaCheck(cudaEventSynchronize(s.output_ready), "cudaEventSynchronize");
+        }
+        s.busy = false;
+        {
+            StageTimer timer(model_.metrics_, Stage::Softmax);
+            softmaxArgmax<MNIST_CLASSES>(s.host_output, s.n, predicted, model_.compute_probabilities_);
+        }
+        if (model_.metrics_) {
+            model_.metrics_->addImages(s.n);
+        }
+        return s.host_output;
+    }
+
+private:
+    struct Slot {
+        // pinned 暂存区：gpu_preprocess 时为 u8 像素，否则为模型输入类型
+        void* host_input = nullptr;
+        float* host_output = nullptr;
+        // 显存：上传的 u8 像素（仅 gpu_preprocess）、模型输入与输出
+        void* device_staging = nullptr;
+        void* device_input = nullptr;
+        float* device_output = nullptr;
+        cudaStream_t copy = nullptr;
+        cudaEvent_t input_ready = nullptr;
+        cudaEvent_t compute_done = nullptr;
+        cudaEvent_t output_ready = nullptr;
+        Ort::IoBinding io{nullptr};
+        Ort::Value input_tensor{nullptr};
+        Ort::Value output_tensor{nullptr};
+        size_t bound = 0;
+        size_t n = 0;
+        bool busy = false;
+    };
+
+    void allocate(Slot& s) {
+        const size_t images = options_.batch;
+        const size_t staged = images * MNIST_IMAGE_SIZE * (options_.gpu_preprocess ? 1 : input_bytes_);
+        cudaCheck(cudaHostAlloc(&s.host_input, staged, cudaHostAllocWriteCombined), "cudaHostAlloc");
+        cudaCheck(cudaHostAlloc(reinterpret_cast<void**>(&s.host_output), images * MNIST_CLASSES * sizeof(float),
+                                cudaHostAllocDefault),
+                  "cudaHostAlloc");
+        if (options_.gpu_preprocess) {
+            cudaCheck(cudaMalloc(&s.device_staging, images * MNIST_IMAGE_SIZE), "cudaMalloc");
+        }
+        cudaCheck(cudaMalloc(&s.device_input, images * MNIST_IMAGE_SIZE * input_bytes_), "cudaMalloc");
+        cudaCheck(cudaMalloc(reinterpret_cast<void**>(&s.device_output), images * MNIST_CLASSES * sizeof(float)),
+                  "cudaMalloc");
+        cudaCheck(cudaStreamCreateWithFlags(&s.copy, cudaStreamNonBlocking), "cudaStreamCreate");
+        // 只用于排序与同步，不计时
+        cudaCheck(cudaEventCreateWithFlags(&s.input_ready, cudaEventDisableTiming), "cudaEventCreate");
+        cudaCheck(cudaEventCreateWithFlags(&s.compute_done, cudaEventDisableTiming), "cudaEventCreate");
+        cudaCheck(cudaEventCreateWithFlags(&s.output_ready, cudaEventDisableTiming), "cudaEventCreate");
+        bind(s, images);
+    }
+
+    static void release(Slot& s) {
+        s.io = Ort::IoBinding(nullptr);
+        s.input_tensor = Ort::Value(nullptr);
+        s.output_tensor = Ort::Value(nullptr);
+        if (s.output_ready) cudaEventDestroy(s.output_ready);
+        if (s.compute_done) cudaEventDestroy(s.compute_done);
+        if (s.input_ready) cudaEventDestroy(s.input_ready);
+        if (s.copy) cudaStreamDestroy(s.copy);
+        cudaFree(s.device_output);
+        cudaFree(s.device_input);
+        cudaFree(s.device_staging);
+        cudaFreeHost(s.host_output);
+        cudaFreeHost(s.host_input);
+    }
+
+    // 把槽位的显存缓冲按 n 张图绑定为会话的输入/输出（最后不足一批时重新绑定）
+    void bind(Slot& s, size_t n) {
+        const auto input_shape = MNISTModel::InputShape::withBatch(static_cast<int64_t>(n));
+        const auto output_shape = MNISTModel::OutputShape::withBatch(static_cast<int64_t>(n));
+        s.input_tensor = Ort::Value::CreateTensor(device_memory_, s.device_input, n * MNIST_IMAGE_SIZE * input_bytes_,
+                                                  input_shape.data(), input_shape.size(), model_.inputType());
+        s.output_tensor = Ort::Value::CreateTensor<float>(device_memory_, s.device_output, n * MNIST_CLASSES,
+                                                          output_shape.data(), output_shape.size());
+        s.io = Ort::IoBinding(model_.onnx().session());
+        s.io.BindInput(model_.onnx().inputNames()[0], s.input_tensor);
+        s.io.BindOutput(model_.onnx().outputNames()[0], s.output_tensor);
+        s.bound = n;
+    }
+
+    MNISTModel& model_;
+    const cudaStream_t compute_;
+    const Options options_;
+    Ort::MemoryInfo device_memory_;
+    Ort::RunOptions run_options_;
+    size_t input_bytes_ = sizeof(float);
+    std::vector<Slot> slots_;
+};
+
+#endif  // MNIST_WITH_CUDA
@@ -0,0 +1,66 @@
+#include <cstdint>
+#include <cstddef>
+
+#include <cuda_runtime.h>
+#include <cuda_fp16.h>
+
+//--------------------------------------------------------------------
+// GPU 上的前处理（见 GpuPipeline.h）：n 张 width×height 的 u8 灰度画布
+// （0 = 背景，255 = 笔迹）面积平均缩放为 28×28 的模型输入。
+// 取源矩形的方式与 AreaResampler 的 bounds() 相同；画布正好是 28×28 时即逐像素归一化
+//--------------------------------------------------------------------
+namespace {
+
+constexpr int kOut = 28;
+
+__device__ inline void bounds(int i, int src, int& first, int& second) {
+    first = min(i * src / kOut, src - 1);
+    second = max((i + 1) * src / kOut, first + 1);
+}
+
+__device__ inline void store(float* dst, float v) { *dst = v; }
+__device__ inline void store(__half* dst, float v) { *dst = __float2half(v); }
+
+// blockIdx.y 为第几张图，每个线程算一个输出像素
+template <typename T>
+__global__ void areaResizeKernel(const uint8_t* src, int width, int height, T* dst) {
+    const int pixel = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pixel >= kOut * kOut) {
+        return;
+    }
+    const size_t image = blockIdx.y;
+    const uint8_t* canvas = src + image * width * height;
+    int x0, x1, y0, y1;
+    bounds(pixel % kOut, width, x0, x1);
+    bounds(pixel / kOut, height, y0, y1);
+
+    uint32_t sum = 0;
+    for (int y = y0; y < y1; ++y) {
+        const uint8_t* row = canvas + static_cast<size_t>(y) * width;
+        for (int x = x0; x < x1; ++x) {
+            sum += row[x];
+        }
+    }
+    store(dst + image * kOut * kOut + pixel, sum / (255.0f * (x1 - x0) * (y1 - y0)));
+}
+
+template <typename T>
+cudaError_t launch(const uint8_t* src, size_t n, int width, int height, T* dst, cudaStream_t stream) {
+    if (n == 0) {
+        return cudaSuccess;
+    }
+    constexpr int threads = 256;
+    const dim3 grid((kOut * kOut + threads - 1) / threads, static_cast<unsigned>(n));
+    areaResizeKernel<<<grid, threads, 0, stream>>>(src, width, height, dst);
+    return cudaGetLastError();
+}
+
+}  // namespace
+
+cudaError_t gpuResizeGray(const uint8_t* src, size_t n, int width, int height, float* dst, cudaStream_t stream) {
+    return launch(src, n, width, height, dst, stream);
+}
+
+cudaError_t gpuResizeGrayHalf(const uint8_t* src, size_t n, int width, int height, uint16_t* dst, cudaStream_t stream) {
+    return launch(src, n, width, height, reinterpret_cast<__half*>(dst), stream);
+}
@@ -0,0 +1,399 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
+#include <strings.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "BufferPool.h"
+
+//--------------------------------------------------------------------
+// 最小的 HTTP/1.1 服务端：每个连接一个线程，支持 keep-alive、流水线请求与
+// Content-Length 请求体（不支持 chunked）。请求体读进该连接复用的缓冲区（设了 buffers 时从中取），
+// 处理函数拿到的 body 指向它；只有随头部一起读进来的那部分（至多 kMaxHeader 字节）要从头部缓冲区挪过去。
+// 连接数达到上限时，新连接直接得到 503 并被关闭
+//--------------------------------------------------------------------
+struct HttpRequest {
+    std::string method;
+    // 不含查询串
+    std::string path;
+    std::string query;
+    std::string content_type;
+    const uint8_t* body = nullptr;
+    size_t body_size = 0;
+};
+
+struct HttpResponse {
+    int status = 200;
+    std::string content_type = "text/plain";
+    std::string body;
+    // 额外的响应头，如 {"Retry-After", "1"}
+    std::vector<std::pair<std::string, std::string>> headers;
+};
+
+struct HttpServerOptions {
+    std::string address = "0.0.0.0";
+    // 0 = 由系统分配（见 HttpServer::port）
+    int port = 8080;
+    size_t max_connections = 64;
+    // 请求体的上限，超过时返回 413
+    size_t max_body = 1 << 20;
+    // 连接上这么久读不到数据即关闭
+    std::chrono::seconds idle_timeout{30};
+    // 非空时各连接的请求体缓冲区从这里分配（64 字节对齐），否则用全局堆；须晚于服务端析构
+    BufferPool* buffers = nullptr;
+};
+
+struct HttpServer {
+    using Options = HttpServerOptions;
+    using Handler = std::function<void(const HttpRequest&, HttpResponse&)>;
+
+    // 请求头（请求行 + 各头部）的上限，超过时返回 431
+    static constexpr size_t kMaxHeader = 8192;
+
+    // 绑定并开始监听，失败时抛 std::runtime_error。handler 在各连接线程上并发调用，
+    // 抛出的异常转为 500
+    HttpServer(Options options, Handler handler)
+        : options_(std::move(options)), handler_(std::move(handler)) {
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            throw std::runtime_error("cannot create socket");
+        }
+        int one = 1;
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(options_.port));
+        if (::inet_pton(AF_INET, options_.address.c_str(), &addr.sin_addr) != 1) {
+            ::close(listen_fd_);
+            throw std::runtime_error("invalid listen address " + options_.address);
+        }
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd_, SOMAXCONN) != 0) {
+            const std::string error = std::strerror(errno);
+            ::close(listen_fd_);
+            throw std::runtime_error("cannot listen on " + options_.address + ':' + std::to_string(options_.port) +
+                                     ": " + error);
+        }
+        socklen_t len = sizeof(addr);
+        ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+    }
+
+    ~HttpServer() {
+        stop();
+        closeConnections();
+        ::close(listen_fd_);
+    }
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    int port() const { return port_; }
+
+    size_t connections() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connections_.size();
+    }
+
+    // 在当前线程接受连接，直到 stop()；返回前关闭所有连接并等待其线程结束
+    void serve() {
+        while (!stopping_.load()) {
+            const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                    // 文件描述符等资源耗尽：稍后再试，期间新连接留在 backlog 里
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                } else if (errno != EINTR && errno != ECONNABORTED) {
+                    break;
+                }
+                continue;
+            }
+            configure(fd);
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (stopping_.load() || connections_.size() >= options_.max_connections) {
+                lock.unlock();
+                static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/plain\r\n"
+                                           "Content-Length: 5\r\nRetry-After: 1\r\nConnection: close\r\n\r\nbusy\n";
+                sendAll(fd, busy, sizeof(busy) - 1, 0);
+                ::close(fd);
+                continue;
+            }
+            connections_.insert(fd);
+            lock.unlock();
+
+            std::thread([this, fd] {
+                serveConnection(fd);
+                std::lock_guard<std::mutex> guard(mutex_);
+                connections_.erase(fd);
+                ::close(fd);
+                closed_.notify_all();
+            }).detach();
+        }
+        closeConnections();
+    }
+
+    // 让 serve() 返回；可在其他线程调用（如等待信号的线程），可重复调用
+    void stop() {
+        if (!stopping_.exchange(true)) {
+            // 唤醒阻塞在 accept 上的 serve()
+            ::shutdown(listen_fd_, SHUT_RDWR);
+        }
+    }
+
+private:
+    void configure(int fd) const {
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        timeval timeout{};
+        timeout.tv_sec = static_cast<time_t>(options_.idle_timeout.count());
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    }
+
+    // 叫停所有连接：只关读方向，阻塞在 recv 上的线程随即返回，正在处理的请求照常写回
+    void closeConnections() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (int fd : connections_) {
+            ::shutdown(fd, SHUT_RD);
+        }
+        closed_.wait(lock, [this] { return connections_.empty(); });
+    }
+
+    static bool sendAll(int fd, const char* data, size_t size, int flags) {
+        while (size > 0) {
+            const ssize_t n = ::send(fd, data, size, flags | MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static const char* statusText(int status) {
+        switch (status) {
+        case 100: return "Continue";
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+        }
+    }
+
+    static bool sendResponse(int fd, const HttpResponse& response, bool keep_alive) {
+        std::string head = "HTTP/1.1 " + std::to_string(response.status) + ' ' + statusText(response.status) + "\r\n"
+                           "Content-Type: " + response.content_type + "\r\n"
+                           "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+        for (const auto& header : response.headers) {
+            head += header.first + ": " + header.second + "\r\n";
+        }
+        if (!keep_alive) {
+            head += "Connection: close\r\n";
+        }
+        head += "\r\n";
+        // MSG_MORE：头部与正文合成同一个 TCP 段发出
+        return sendAll(fd, head.data(), head.size(), response.body.empty() ? 0 : MSG_MORE) &&
+               sendAll(fd, response.body.data(), response.body.size(), 0);
+    }
+
+    static bool sendError(int fd, int status, const char* message) {
+        HttpResponse response;
+        response.status = status;
+        response.body = std::string(message) + '\n';
+        return sendResponse(fd, response, false);
+    }
+
+    // 解析 [data, data + size) 中的请求行与头部（不含结尾的空行）
+    static bool parseHead(const char* data, size_t size, HttpRequest& req, size_t& content_length,
+                          bool& keep_alive, bool& expect_continue, bool& chunked) {
+        const std::string head(data, size);
+        size_t line_end = head.find("\r\n");
+        const std::string request_line = head.substr(0, line_end);
+        const size_t sp1 = request_line.find(' ');
+        const size_t sp2 = request_line.rfind(' ');
+        if (sp1 == std::string::npos || sp2 <= sp1) {
+            return false;
+        }
+        req.method = request_line.substr(0, sp1);
+        const std::string target = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+        const std::string version = request_line.substr(sp2 + 1);
+        if (version.compare(0, 5, "HTTP/") != 0) {
+            return false;
+        }
+        const size_t question = target.find('?');
+        req.path = target.substr(0, question);
+        req.query = question == std::string::npos ? std::string() : target.substr(question + 1);
+
+        content_length = 0;
+        keep_alive = version != "HTTP/1.0";
+        expect_continue = false;
+        chunked = false;
+        while (line_end != std::string::npos && line_end + 2 < head.size()) {
+            const size_t start = line_end + 2;
+            line_end = head.find("\r\n", start);
+            const std::string line = head.substr(start, line_end == std::string::npos ? std::string::npos : line_end - start);
+            const size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                return false;
+            }
+            const std::string name = line.substr(0, colon);
+            const size_t value_start = line.find_first_not_of(" \t", colon + 1);
+            const std::string value = value_start == std::string::npos ? std::string() : line.substr(value_start);
+
+            if (!strcasecmp(name.c_str(), "Content-Length")) {
+                char* end = nullptr;
+                content_length = std::strtoull(value.c_str(), &end, 10);
+                if (end == value.c_str() || *end != '\0') {
+                    return false;
+                }
+            } else if (!strcasecmp(name.c_str(), "Content-Type")) {
+                req.content_type = value.substr(0, value.find(';'));
+            } else if (!strcasecmp(name.c_str(), "Connection")) {
+                if (!strcasecmp(value.c_str(), "close")) keep_alive = false;
+                else if (!strcasecmp(value.c_str(), "keep-alive")) keep_alive = true;
+            } else if (!strcasecmp(name.c_str(), "Expect")) {
+                expect_continue = !strcasecmp(value.c_str(), "100-continue");
+            } else if (!strcasecmp(name.c_str(), "Transfer-Encoding")) {
+                chunked = true;
+            }
+        }
+        return true;
+    }
+
+    void serveConnection(int fd) {
+        std::vector<char> head(kMaxHeader);
+        // 请求体缓冲在连接内复用，只增不减
+        std::vector<uint8_t, PoolStlAllocator<uint8_t>> body{PoolStlAllocator<uint8_t>(options_.buffers)};
+        size_t have = 0;
+        for (;;) {
+            // 读到头部结尾的空行为止
+            size_t head_size = 0;
+            for (;;) {
+                static const char terminator[] = "\r\n\r\n";
+                const auto end = std::search(head.begin(), head.begin() + have, terminator, terminator + 4);
+                if (end != head.begin() + have) {
+                    head_size = static_cast<size_t>(end - head.begin());
+                    break;
+                }
+                if (have == head.size()) {
+                    sendError(fd, 431, "request header too large");
+                    return;
+                }
+                const ssize_t n = ::recv(fd, head.data() + have, head.size() - have, 0);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    // 对端关闭、空闲超时或 stop()
+                    return;
+                }
+                have += static_cast<size_t>(n);
+            }
+
+            HttpRequest req;
+            size_t length = 0;
+            bool keep_alive = true, expect_continue = false, chunked = false;
+            if (!parseHead(head.data(), head_size, req, length, keep_alive, expect_continue, chunked)) {
+                sendError(fd, 400, "malformed request");
+                return;
+            }
+            if (chunked) {
+                sendError(fd, 411, "chunked request bodies are not supported; send Content-Length");
+                return;
+            }
+            if (length > options_.max_body) {
+                sendError(fd, 413, "request body too large");
+                return;
+            }
+
+            // 头部之后已读进来的字节属于请求体（以及可能的下一个流水线请求）
+            const size_t body_start = head_size + 4;
+            const size_t buffered = std::min(have - body_start, length);
+            if (expect_continue && buffered < length) {
+                static const char proceed[] = "HTTP/1.1 100 Continue\r\n\r\n";
+                if (!sendAll(fd, proceed, sizeof(proceed) - 1, 0)) {
+                    return;
+                }
+            }
+            if (body.size() < length) {
+                body.resize(length);
+            }
+            if (buffered > 0) {
+                std::memcpy(body.data(), head.data() + body_start, buffered);
+            }
+            for (size_t got = buffered; got < length;) {
+                const ssize_t n = ::recv(fd, body.data() + got, length - got, 0);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    return;
+                }
+                got += static_cast<size_t>(n);
+            }
+            const size_t consumed = body_start + buffered;
+            std::memmove(head.data(), head.data() + consumed, have - consumed);
+            have -= consumed;
+
+            req.body = body.data();
+            req.body_size = length;
+            HttpResponse response;
+            try {
+                handler_(req, response);
+            } catch (const std::exception& e) {
+                response = HttpResponse();
+                response.status = 500;
+                response.body = std::string(e.what()) + '\n';
+            }
+            // stop() 之后写回当前响应即关闭连接，不再读 keep-alive / 流水线中的下一个请求
+            keep_alive = keep_alive && !stopping_.load();
+            if (!sendResponse(fd, response, keep_alive) || !keep_alive) {
+                return;
+            }
+        }
+    }
+
+    const Options options_;
+    const Handler handler_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::atomic<bool> stopping_{false};
+
+    // 活动连接的 fd，由 mutex_ 保护；连接线程结束时从中移除并通知 closed_
+    mutable std::mutex mutex_;
+    std::condition_variable closed_;
+    std::set<int> connections_;
+};
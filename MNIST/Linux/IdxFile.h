@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//--------------------------------------------------------------------
+// 以只读 mmap 方式打开 MNIST IDX 文件（图像 0x00000803 / 标签 0x00000801）
+// raw = true 时把整个文件当作连续的 u8 28×28 图像流
+//--------------------------------------------------------------------
+struct IdxFile {
+    IdxFile(const char* path, bool raw = false) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("cannot open ") + path);
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error(std::string("cannot stat or empty file: ") + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error(std::string("mmap failed: ") + path);
+        }
+        base_ = static_cast<const uint8_t*>(p);
+        // 顺序扫描，提示内核预读
+        ::madvise(p, size_, MADV_SEQUENTIAL);
+
+        if (raw) {
+            dims_ = {static_cast<uint32_t>(size_ / (28 * 28)), 28, 28};
+            data_ = base_;
+        } else {
+            parseHeader(path);
+        }
+    }
+
+    ~IdxFile() {
+        if (base_) {
+            ::munmap(const_cast<uint8_t*>(base_), size_);
+        }
+    }
+
+    IdxFile(const IdxFile&) = delete;
+    IdxFile& operator=(const IdxFile&) = delete;
+
+    // 样本数（第 0 维）
+    size_t count() const { return dims_[0]; }
+    // 每个样本的字节数（其余各维之积）
+    size_t sampleSize() const {
+        size_t n = 1;
+        for (size_t i = 1; i < dims_.size(); ++i) n *= dims_[i];
+        return n;
+    }
+    const uint8_t* data() const { return data_; }
+    const uint8_t* sample(size_t i) const { return data_ + i * sampleSize(); }
+    const std::vector<uint32_t>& dims() const { return dims_; }
+
+private:
+    void parseHeader(const char* path) {
+        // IDX 头：两个 0 字节、类型码(0x08 = u8)、维数，之后每维一个大端 uint32
+        if (size_ < 4 || base_[0] != 0 || base_[1] != 0 || base_[2] != 0x08) {
+            throw std::runtime_error(std::string("not a u8 IDX file: ") + path);
+        }
+        size_t ndims = base_[3];
+        size_t header = 4 + ndims * 4;
+        if (ndims == 0 || size_ < header) {
+            throw std::runtime_error(std::string("truncated IDX header: ") + path);
+        }
+        for (size_t i = 0; i < ndims; ++i) {
+            const uint8_t* d = base_ + 4 + i * 4;
+            dims_.push_back((uint32_t(d[0]) << 24) | (uint32_t(d[1]) << 16) | (uint32_t(d[2]) << 8) | d[3]);
+        }
+        data_ = base_ + header;
+        if (size_ - header < count() * sampleSize()) {
+            throw std::runtime_error(std::string("truncated IDX data: ") + path);
+        }
+    }
+
+    const uint8_t* base_ = nullptr;
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<uint32_t> dims_;
+};
@@ -0,0 +1,442 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <optional>
+#include <exception>
+
+#include "MNISTModel.h"
+#include "MpmcQueue.h"
+
+//--------------------------------------------------------------------
+// 推理线程池：所有工作线程共享一个 Ort::Session，
+// 每个线程有自己对齐的输入/输出缓冲区与 IoBinding。
+// 客户端经无锁 MPMC 队列提交请求，通过 future 取回结果。
+//
+// max_batch > 1 时启用动态微批：同一时刻只有一个工作线程在“收集”，
+// 它把请求直接取进自己的批缓冲区，凑满 max_batch 或距第一条请求入队
+// 超过 max_wait 即发出；收集权随即交给下一个线程，本线程执行这一批
+// 并把结果逐条写回各自的 promise。
+//
+// 队列中的请求只带图像指针：Submit / TrySubmit 把图像拷进（u8 像素先转换为 [0,1] 的 float）
+// 线程池自有的 queue_capacity 个图像槽位之一，工作线程取入批缓冲区后即归还槽位；
+// float16 / uint8 模型由工作线程在取入批缓冲区时转换为模型的输入类型。
+// TrySubmitInPlace 不占图像槽位，工作线程直接从调用方内存（如共享内存中的槽位）
+// 取入批缓冲区，结果经 PoolCompletion 回调写回，不创建 promise / future
+//--------------------------------------------------------------------
+struct PoolOptions {
+    // 0 = 全部硬件线程
+    size_t workers = 0;
+    // 必须是 2 的幂
+    size_t queue_capacity = 1024;
+    // 每批最多的图像数，1 = 不做微批
+    size_t max_batch = 1;
+    // 一批从第一条请求入队起最多等待的时间
+    std::chrono::microseconds max_wait{0};
+    // 非空时记录请求的排队时间，并设为共享模型的 metrics_（见 Metrics.h）
+    Metrics* metrics = nullptr;
+    // 非空时提交的图像先在提交线程查这个缓存，命中的请求不进队列，结果由工作线程写回缓存
+    PredictionCache* cache = nullptr;
+    // 共享会话的配置；intra_op_threads 为 0 时取 核心数 / 工作线程数，避免超额订阅。
+    // 设置了 session.arena 时，批缓冲区、图像槽位与每个请求的 promise 状态也从其中分配；
+    // 构造时预热 arena（见 primeArena），稳态下提交与推理不再触碰堆
+    SessionConfig session;
+};
+
+// TrySubmitInPlace 的结果回调：在工作线程（缓存命中时在提交线程）上调用，须很快返回且不抛出异常
+struct PoolCompletion {
+    using Result = Prediction;
+
+    virtual ~PoolCompletion() = default;
+    virtual void complete(uint64_t tag, const Prediction& p) = 0;
+    virtual void fail(uint64_t tag, std::exception_ptr error) = 0;
+};
+
+struct InferencePool {
+    using Clock = std::chrono::steady_clock;
+
+    using Options = PoolOptions;
+    using Completion = PoolCompletion;
+
+    InferencePool(const ModelSource& source, Options options = {})
+        : options_(options), queue_(options.queue_capacity), free_images_(options.queue_capacity) {
+        const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        if (options_.workers == 0) {
+            options_.workers = cores;
+        }
+        if (options_.session.intra_op_threads <= 0) {
+            options_.session.intra_op_threads = static_cast<int>(std::max<size_t>(1, cores / options_.workers));
+        }
+        options_.max_batch = std::max<size_t>(1, options_.max_batch);
+        model_ = std::make_unique<MNISTModel>(source, options_.session);
+        BufferPool* buffers = options_.session.arena ? &options_.session.arena->pool() : nullptr;
+        promise_allocator_ = PoolStlAllocator<char>(buffers);
+        images_ = allocAligned<float>(options_.queue_capacity * MNIST_IMAGE_SIZE, buffers);
+        for (uint32_t i = 0; i < options_.queue_capacity; ++i) {
+            free_images_.tryPush(uint32_t(i));
+        }
+
+        // 先在当前线程完成所有分配与绑定，出错时直接抛给调用方
+        workers_.resize(options_.workers);
+        for (Worker& w : workers_) {
+            // 按 float 的大小分配，足以容纳任一种输入类型
+            w.input = allocAligned<uint8_t>(options_.max_batch * MNIST_IMAGE_SIZE * sizeof(float), buffers);
+            w.output = allocAligned(options_.max_batch * MNIST_CLASSES, buffers);
+            w.predicted.resize(options_.max_batch);
+            w.requests.resize(options_.max_batch);
+            if (model_->acceptsBatch(options_.max_batch)) {
+                model_->visitInputType([&](auto* tag) {
+                    using T = std::remove_pointer_t<decltype(tag)>;
+                    w.binding = model_->Bind(reinterpret_cast<T*>(w.input.get()), w.output.get(), options_.max_batch);
+                });
+                w.bound = true;
+            }
+        }
+        if (buffers) {
+            primeArena(*buffers);
+        }
+        model_->metrics_ = options_.metrics;
+        for (Worker& w : workers_) {
+            w.thread = std::thread([this, &w] { workerLoop(w); });
+        }
+    }
+
+    // 处理完队列中剩余的请求后退出
+    ~InferencePool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        for (Worker& w : workers_) {
+            w.thread.join();
+        }
+    }
+
+    InferencePool(const InferencePool&) = delete;
+    InferencePool& operator=(const InferencePool&) = delete;
+
+    // 提交一张 28×28 图像（拷贝进线程池的图像槽位），队列满时等待。
+    // image 为 [0,1] 的 float，或 0~255 的 u8 像素
+    template <typename T>
+    std::future<Prediction> Submit(const T* image) {
+        const uint64_t key = options_.cache ? imageKey(image) : 0;
+        std::future<Prediction> cached;
+        if (lookup(key, cached)) {
+            return cached;
+        }
+        uint32_t slot = 0;
+        while (!free_images_.tryPop(slot)) {
+            std::this_thread::yield();
+        }
+        Request req = makeRequest(image, key, slot);
+        std::future<Prediction> result = req.promise->get_future();
+        while (!queue_.tryPush(std::move(req))) {
+            std::this_thread::yield();
+        }
+        notifyWorker();
+        return result;
+    }
+
+    // 队列满时不等待，返回 false（用于向上游施加背压）
+    template <typename T>
+    bool TrySubmit(const T* image, std::future<Prediction>& result) {
+        const uint64_t key = options_.cache ? imageKey(image) : 0;
+        if (lookup(key, result)) {
+            return true;
+        }
+        uint32_t slot = 0;
+        if (!free_images_.tryPop(slot)) {
+            return false;
+        }
+        Request req = makeRequest(image, key, slot);
+        std::future<Prediction> f = req.promise->get_future();
+        if (!queue_.tryPush(std::move(req))) {
+            free_images_.tryPush(uint32_t(slot));
+            return false;
+        }
+        result = std::move(f);
+        notifyWorker();
+        return true;
+    }
+
+    // 不拷贝图像：[0,1] 的 float 图像须保持不变，直到 done 以同一 tag 被调用。
+    // 队列满时返回 false，done 不会被调用
+    bool TrySubmitInPlace(const float* image, PoolCompletion& done, uint64_t tag) {
+        const uint64_t key = options_.cache ? imageKey(image) : 0;
+        Prediction cached;
+        if (options_.cache && options_.cache->lookup(key, cached)) {
+            done.complete(tag, cached);
+            return true;
+        }
+        Request req{image, kBorrowed, std::nullopt, Clock::now(), key, &done, tag};
+        if (!queue_.tryPush(std::move(req))) {
+            return false;
+        }
+        notifyWorker();
+        return true;
+    }
+
+    const Options& options() const { return options_; }
+    size_t workerCount() const { return workers_.size(); }
+    // 队列中等待的请求数（近似值）
+    size_t queued() const { return queue_.sizeApprox(); }
+    MNISTModel& model() { return *model_; }
+
+private:
+    // TrySubmitInPlace 的请求不占图像槽位
+    static constexpr uint32_t kBorrowed = UINT32_MAX;
+
+    struct Request {
+        // 图像在 images_ 的第 slot 个槽位，或（slot 为 kBorrowed 时）在调用方内存中
+        const float* image;
+        uint32_t slot;
+        // 经 TrySubmitInPlace 提交的请求没有 promise，结果交给 done
+        std::optional<std::promise<Prediction>> promise;
+        Clock::time_point enqueued;
+        // 结果缓存的键（未启用缓存时为 0）
+        uint64_t key;
+        PoolCompletion* done;
+        uint64_t tag;
+
+        void finish(const Prediction& p) {
+            if (done) {
+                done->complete(tag, p);
+            } else {
+                promise->set_value(p);
+            }
+        }
+
+        void finish(std::exception_ptr error) {
+            if (done) {
+                done->fail(tag, error);
+            } else {
+                promise->set_exception(error);
+            }
+        }
+    };
+
+    struct Worker {
+        // 模型输入类型的批缓冲区
+        AlignedBuffer<uint8_t> input;
+        AlignedFloats output;
+        std::vector<int> predicted;
+        std::vector<Request> requests;
+        MNISTModel::Binding binding;
+        bool bound = false;
+        std::thread thread;
+    };
+
+    // promise 的共享状态直接按 promise_allocator_ 分配（先默认构造再替换会多一次堆分配）
+    Request newRequest(uint64_t key, uint32_t slot) {
+        return Request{images_.get() + static_cast<size_t>(slot) * MNIST_IMAGE_SIZE, slot,
+                       std::promise<Prediction>(std::allocator_arg, promise_allocator_), {}, key, nullptr, 0};
+    }
+
+    // 启用了缓存且命中时返回已就绪的 future
+    bool lookup(uint64_t key, std::future<Prediction>& result) {
+        if (!options_.cache) {
+            return false;
+        }
+        Prediction p;
+        if (!options_.cache->lookup(key, p)) {
+            return false;
+        }
+        std::promise<Prediction> ready(std::allocator_arg, promise_allocator_);
+        ready.set_value(p);
+        result = ready.get_future();
+        return true;
+    }
+
+    Request makeRequest(const float* image, uint64_t key, uint32_t slot) {
+        Request req = newRequest(key, slot);
+        std::memcpy(const_cast<float*>(req.image), image, MNIST_IMAGE_SIZE * sizeof(float));
+        req.enqueued = Clock::now();
+        return req;
+    }
+
+    Request makeRequest(const uint8_t* image, uint64_t key, uint32_t slot) {
+        Request req = newRequest(key, slot);
+        grayToTensor(image, MNIST_IMAGE_SIZE, const_cast<float*>(req.image));
+        req.enqueued = Clock::now();
+        return req;
+    }
+
+    void notifyWorker() {
+        // 与 popUntil 中 sleeping_ 的递增配对：要么工作线程在睡前看到新请求，
+        // 要么这里看到它已在等待并唤醒它
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_.notify_one();
+        }
+    }
+
+    // 取一条请求，最多等到 deadline；超时或线程池停止（且队列已空）时返回 false
+    bool popUntil(Request& req, Clock::time_point deadline) {
+        const bool forever = deadline == Clock::time_point::max();
+        // 短暂自旋后再睡眠，减少高负载下的唤醒开销
+        for (int spin = 0; spin < 64; ++spin) {
+            if (queue_.tryPop(req)) {
+                return true;
+            }
+            if (!forever && Clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        for (;;) {
+            if (queue_.tryPop(req)) {
+                return true;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleeping_.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto ready = [this] { return stop_ || queue_.sizeApprox() > 0; };
+            bool woke = forever ? (wakeup_.wait(lock, ready), true)
+                                : wakeup_.wait_until(lock, deadline, ready);
+            sleeping_.fetch_sub(1);
+            if (!woke || (stop_ && queue_.sizeApprox() == 0)) {
+                return queue_.tryPop(req);
+            }
+        }
+    }
+
+    void workerLoop(Worker& w) {
+        for (;;) {
+            size_t n = 0;
+            {
+                // 不做微批时各线程直接并发取队列，无需收集锁
+                std::unique_lock<std::mutex> collecting(collect_mutex_, std::defer_lock);
+                if (options_.max_batch > 1) {
+                    collecting.lock();
+                }
+                if (!popUntil(w.requests[0], Clock::time_point::max())) {
+                    return;
+                }
+                dequeued(w, 0);
+                n = 1;
+
+                const Clock::time_point deadline = w.requests[0].enqueued + options_.max_wait;
+                while (n < options_.max_batch && popUntil(w.requests[n], deadline)) {
+                    dequeued(w, n);
+                    ++n;
+                }
+            }
+            runBatch(w, n);
+        }
+    }
+
+    // 记录第 i 条请求的排队时间并把它取入批缓冲区
+    void dequeued(Worker& w, size_t i) {
+        if (options_.metrics) {
+            options_.metrics->record(Stage::Queue, Clock::now() - w.requests[i].enqueued);
+        }
+        stage(w, i);
+    }
+
+    // 把第 i 条请求的图像写入批缓冲区的第 i 个槽位（float 模型即拷贝），随即归还图像槽位
+    void stage(Worker& w, size_t i) {
+        Request& req = w.requests[i];
+        model_->visitInputType([&](auto* tag) {
+            using T = std::remove_pointer_t<decltype(tag)>;
+            toTensorElements(req.image, MNIST_IMAGE_SIZE, reinterpret_cast<T*>(w.input.get()) + i * MNIST_IMAGE_SIZE);
+        });
+        if (req.slot != kBorrowed) {
+            // 槽位数等于容量，归还总能成功
+            free_images_.tryPush(uint32_t(req.slot));
+        }
+    }
+
+    // 推理批缓冲区中的前 n 张图像
+    void infer(Worker& w, size_t n) {
+        if (w.bound && n == options_.max_batch) {
+            model_->Run(w.binding, w.predicted.data());
+        } else {
+            model_->visitInputType([&](auto* tag) {
+                using T = std::remove_pointer_t<decltype(tag)>;
+                model_->RunBatch(reinterpret_cast<const T*>(w.input.get()), n, w.output.get(), w.predicted.data());
+            });
+        }
+    }
+
+    // 开始服务前把稳态所需的块备进 arena：
+    //   - 每种批大小都在各工作线程的缓冲上推理一次，推迟归还，于是 ORT 中间张量的每个大小级
+    //     都备有够全部工作线程同时使用的块（第一个线程没有向系统申请新块时，其余线程跳过）；
+    //   - 备好队列容量加上各线程一整批那么多个 promise 共享状态。
+    // 之后的提交与推理只在空闲链表中出入。推迟归还会比实际的并发峰值多备一些；
+    // 上限内放不下时（计入 arena 的 failed）把备下的块还给系统，退回按需分配
+    void primeArena(BufferPool& buffers) {
+        for (Worker& w : workers_) {
+            std::memset(w.input.get(), 0, options_.max_batch * MNIST_IMAGE_SIZE * sizeof(float));
+        }
+        std::vector<std::promise<Prediction>> states;
+        try {
+            for (size_t n = 1; n <= options_.max_batch; ++n) {
+                const BufferPool::HoldReleases hold(buffers);
+                const uint64_t before = buffers.stats().system_allocations;
+                infer(workers_[0], n);
+                if (buffers.stats().system_allocations == before) {
+                    continue;
+                }
+                for (size_t i = 1; i < workers_.size(); ++i) {
+                    infer(workers_[i], n);
+                }
+            }
+
+            const size_t count = options_.queue_capacity + options_.workers * options_.max_batch;
+            states.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                states.emplace_back(std::allocator_arg, promise_allocator_);
+                states.back().set_value(Prediction());
+            }
+        } catch (const std::exception&) {
+            states.clear();
+            buffers.trim();
+        }
+    }
+
+    void runBatch(Worker& w, size_t n) {
+        try {
+            infer(w, n);
+            for (size_t i = 0; i < n; ++i) {
+                Prediction p;
+                p.digit = w.predicted[i];
+                const float* row = w.output.get() + i * MNIST_CLASSES;
+                std::copy(row, row + MNIST_CLASSES, p.probabilities.begin());
+                if (options_.cache) {
+                    options_.cache->insert(w.requests[i].key, p);
+                }
+                w.requests[i].finish(p);
+            }
+        } catch (...) {
+            for (size_t i = 0; i < n; ++i) {
+                w.requests[i].finish(std::current_exception());
+            }
+        }
+    }
+
+    Options options_;
+    PoolStlAllocator<char> promise_allocator_;
+    std::unique_ptr<MNISTModel> model_;
+    MpmcQueue<Request> queue_;
+    // Submit / TrySubmit 的图像槽位（queue_capacity 个 28×28 float）与空闲槽位的下标
+    AlignedFloats images_;
+    MpmcQueue<uint32_t> free_images_;
+    std::vector<Worker> workers_;
+
+    std::mutex collect_mutex_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::atomic<int> sleeping_{0};
+    bool stop_ = false;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include "MNISTModel.h"
+
+//--------------------------------------------------------------------
+// 书写过程中的实时预测：预处理与推理在后台线程进行，UI 线程只提交画面。
+// 待处理画面只有一个槽位（latest wins）：后台忙时新提交的变化区域并入槽位，
+// 中间状态不再单独推理，后台空闲下来时总是处理最新的画面。
+// 构造后 model 归后台线程独占，UI 线程不可再调用它
+//--------------------------------------------------------------------
+struct LivePredictor {
+    // width × height 为 8 位灰度画布（PixelFormat::Gray8）的尺寸，初始为空白。
+    // on_result 非空时在后台线程每产生一个结果后调用（须线程安全，如 SDL_PushEvent）
+    LivePredictor(MNISTModel& model, int width, int height, std::function<void()> on_result = {})
+        : model_(model), width_(width), height_(height), on_result_(std::move(on_result)),
+          staging_(static_cast<size_t>(width) * height, 0),
+          snapshot_(staging_) {
+        model_.convertImage(snapshot_, width_, height_, PixelFormat::Gray8);
+        thread_ = std::thread([this] { workerLoop(); });
+    }
+
+    ~LivePredictor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_one();
+        thread_.join();
+    }
+
+    LivePredictor(const LivePredictor&) = delete;
+    LivePredictor& operator=(const LivePredictor&) = delete;
+
+    // 把 canvas（width × height 灰度）中 dirty 区域的像素并入待处理画面
+    void post(const uint8_t* canvas, const DirtyRect& dirty) {
+        if (dirty.empty()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            copyRect(canvas, staging_.data(), dirty);
+            if (!pending_.empty()) {
+                ++dropped_;
+            }
+            pending_.add(dirty.x0, dirty.y0, dirty.x1, dirty.y1, width_, height_);
+        }
+        wakeup_.notify_one();
+    }
+
+    // 有比上次取走时更新的结果时写入 out 并返回 true
+    bool latest(Prediction& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (result_sequence_ == taken_sequence_) {
+            return false;
+        }
+        taken_sequence_ = result_sequence_;
+        out = result_;
+        return true;
+    }
+
+    // 因后台忙而被后续提交覆盖、没有单独推理的提交次数
+    size_t dropped() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+
+private:
+    // 按行拷贝 rect 覆盖的像素（两块缓冲尺寸相同）
+    void copyRect(const uint8_t* src, uint8_t* dst, const DirtyRect& rect) const {
+        const size_t bytes = static_cast<size_t>(rect.x1 - rect.x0);
+        for (int y = rect.y0; y < rect.y1; ++y) {
+            const size_t offset = static_cast<size_t>(y) * width_ + rect.x0;
+            std::memcpy(dst + offset, src + offset, bytes);
+        }
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wakeup_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+            if (stop_) {
+                return;
+            }
+            // 持锁期间只拷贝变化的区域，预处理与推理都在锁外
+            const DirtyRect dirty = pending_;
+            pending_.clear();
+            copyRect(staging_.data(), snapshot_.data(), dirty);
+            lock.unlock();
+
+            Prediction p;
+            model_.convertRegion(snapshot_, width_, height_, dirty, PixelFormat::Gray8);
+            p.digit = model_.Run();
+            std::copy(model_.results_.begin(), model_.results_.end(), p.probabilities.begin());
+
+            lock.lock();
+            result_ = p;
+            ++result_sequence_;
+            if (on_result_) {
+                on_result_();
+            }
+        }
+    }
+
+    MNISTModel& model_;
+    const int width_;
+    const int height_;
+    const std::function<void()> on_result_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+
+    // staging_ 与 pending_ 由 mutex_ 保护；snapshot_ 只由后台线程访问
+    std::vector<uint8_t> staging_;
+    DirtyRect pending_;
+    std::vector<uint8_t> snapshot_;
+    size_t dropped_ = 0;
+
+    Prediction result_;
+    uint64_t result_sequence_ = 0;
+    uint64_t taken_sequence_ = 0;
+
+    std::thread thread_;
+};
@@ -1,142 +1,145 @@
 #include <SDL2/SDL.h>
 #include <iostream>
 #include <vector>
-#include <array>
 #include <algorithm>
-#include <cmath>
 #include <memory>
 #include <cstdint>
+#include <cstring>
 
-// ONNX Runtime C++ API (需已安装)
-#include <onnxruntime_cxx_api.h>
-
-static constexpr int MNIST_WIDTH = 28;
-static constexpr int MNIST_HEIGHT = 28;
-
-//--------------------------------------------------------------------
-// Softmax 函数：对向量进行数值稳定的 softmax 运算
-//--------------------------------------------------------------------
-template <typename T>
-static void softmax(T& input) {
-    // 1) 找到最大值，用以数值稳定
-    float rowmax = *std::max_element(input.begin(), input.end());
-    std::vector<float> y(input.size());
-    float sum = 0.0f;
-
-    // 2) e^(x - rowmax) 并求和
-    for (size_t i = 0; i < input.size(); ++i) {
-        float val = std::exp(input[i] - rowmax);
-        y[i] = val;
-        sum += val;
-    }
-    // 3) 每个元素除以总和
-    for (size_t i = 0; i < input.size(); ++i) {
-        input[i] = y[i] / sum;
-    }
-}
+#include "MNISTModel.h"
+#include "LivePredictor.h"
+#include "StrokeCanvas.h"
 
 //--------------------------------------------------------------------
-// 封装 MNIST 模型推理
+// 概率条形图：每个数字一根柱子，预测结果高亮，柱子下方画出数字
 //--------------------------------------------------------------------
-struct MNISTModel {
-    MNISTModel(const char* model_path) {
-        // 创建 ONNX Runtime 环境和会话
-        Ort::SessionOptions session_options;
-        session_ = Ort::Session(env_, model_path, session_options);
-
-        // 创建输入、输出张量
-        auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
-
-        input_tensor_ = Ort::Value::CreateTensor<float>(
-            memory_info, input_image_.data(), input_image_.size(),
-            input_shape_.data(), input_shape_.size()
-        );
-
-        output_tensor_ = Ort::Value::CreateTensor<float>(
-            memory_info, results_.data(), results_.size(),
-            output_shape_.data(), output_shape_.size()
-        );
-    }
-
-    // 运行推理，返回推断结果（数字 0~9）
-    int Run() {
-        // onnx 模型里对应的输入、输出名称（需与实际模型对应）
-        const char* input_names[] = {"Input3"};
-        const char* output_names[] = {"Plus214_Output_0"};
-
-        Ort::RunOptions run_options;
-        session_.Run(run_options, input_names, &input_tensor_, 1, output_names, &output_tensor_, 1);
-
-        // 对获取到的输出做 softmax
-        softmax(results_);
 
-        // 找到概率最大的元素下标
-        int index = std::distance(results_.begin(),
-                                  std::max_element(results_.begin(), results_.end()));
-        return index;
-    }
+// 3×5 点阵数字，每行 3 位（高位在左），自上而下 5 行
+static const uint16_t kDigitGlyphs[10] = {
+    075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111, 075757, 075717,
+};
 
-    // 计算 28×28 中每个像素的灰度(0 或 1 等)
-    // 此处仅简单地把 0/255 作为黑/白，如果需要更精确的笔迹识别，可做卷积或 Gaussian
-    void convertImage(const std::vector<uint8_t>& sdl_pixels, int bigWidth, int bigHeight) {
-        // 清空输入图像
-        std::fill(input_image_.begin(), input_image_.end(), 0.0f);
-
-        // 将 bigWidth × bigHeight 的像素缩放/投影到 28×28
-        // 最简单方法：“整块”按比例缩小
-        for(int row = 0; row < MNIST_HEIGHT; ++row) {
-            for(int col = 0; col < MNIST_WIDTH; ++col) {
-                // 这里采用最近邻插值
-                int srcY = row * bigHeight / MNIST_HEIGHT;
-                int srcX = col * bigWidth  / MNIST_WIDTH;
-                // sdl_pixels 里每个像素 4 字节(RGBA)，取灰度
-                int idx = (srcY * bigWidth + srcX) * 4;
-
-                // 这里简单判断 R/G/B 都接近 0 就算“黑”
-                // 也可取平均
-                uint8_t r = sdl_pixels[idx + 0];
-                uint8_t g = sdl_pixels[idx + 1];
-                uint8_t b = sdl_pixels[idx + 2];
-
-                float val = (r + g + b) / 3.0f; // [0..255]
-                // 简单判断：越黑 => val 越小 => 记为 1.0
-                // 这里直接做  1.0 - (val / 255)
-                input_image_[row*MNIST_WIDTH + col] = (255.0f - val) / 255.0f;
+static void drawDigit(SDL_Renderer* renderer, int digit, int x, int y, int px) {
+    for (int row = 0; row < 5; ++row) {
+        const int bits = (kDigitGlyphs[digit] >> ((4 - row) * 3)) & 7;
+        for (int col = 0; col < 3; ++col) {
+            if (bits & (4 >> col)) {
+                SDL_Rect r{x + col * px, y + row * px, px, px};
+                SDL_RenderFillRect(renderer, &r);
             }
         }
     }
+}
 
-    // 用于存放 28×28 的浮点图像数据
-    std::array<float, MNIST_WIDTH*MNIST_HEIGHT> input_image_{};
-    // 模型的输出概率（10 个数字的概率分布）
-    std::array<float, 10> results_{};
-
-private:
-    Ort::Env env_{ORT_LOGGING_LEVEL_WARNING, "mnist-env"};
-    Ort::Session session_{nullptr};
-    Ort::Value input_tensor_{nullptr};
-    Ort::Value output_tensor_{nullptr};
-
-    // 输入形状：N=1, C=1, H=28, W=28
-    std::array<int64_t,4> input_shape_{1, 1, MNIST_HEIGHT, MNIST_WIDTH};
-    // 输出形状：1 x 10
-    std::array<int64_t,2> output_shape_{1, 10};
-};
+static void drawChart(SDL_Renderer* renderer, const Prediction& p, const SDL_Rect& area) {
+    SDL_SetRenderDrawColor(renderer, 40,40,40,255);
+    SDL_RenderFillRect(renderer, &area);
+
+    const int slot = area.w / MNIST_CLASSES;
+    const int px = 2;                 // 数字点阵的像素大小
+    const int label_h = 5 * px + 4;
+    const int bar_max = area.h - label_h - 4;
+    for (int i = 0; i < MNIST_CLASSES; ++i) {
+        const int x = area.x + i * slot;
+        const int h = static_cast<int>(std::clamp(p.probabilities[i], 0.0f, 1.0f) * bar_max + 0.5f);
+        if (i == p.digit) {
+            SDL_SetRenderDrawColor(renderer, 240,160,40,255);
+        } else {
+            SDL_SetRenderDrawColor(renderer, 90,160,230,255);
+        }
+        SDL_Rect bar{x + 3, area.y + 2 + bar_max - h, slot - 6, h};
+        SDL_RenderFillRect(renderer, &bar);
+
+        SDL_SetRenderDrawColor(renderer, 220,220,220,255);
+        drawDigit(renderer, i, x + (slot - 3 * px) / 2, area.y + area.h - label_h + 2, px);
+    }
+}
 
 //--------------------------------------------------------------------
 // 主函数：SDL2 窗口，允许用户在画板书写，然后调用 ONNX Runtime 推理
 //--------------------------------------------------------------------
 int main(int argc, char* argv[])
 {
-    // 模型路径可自定义，如 "./mnist.onnx"
-    const char* model_path = "mnist.onnx";
+    // 模型路径可自定义，如 "./mnist.onnx"；未指定时优先用编译进程序的模型
+    const char* model_path = nullptr;
+    SessionConfig session_config;
+    // --live：书写时在后台线程持续预测，结果只画在条形图上
+    bool live_mode = false;
+    // --wait：阻塞等待事件，只在画面有变化时重绘；--vsync：呈现与显示器刷新同步
+    bool event_driven = false;
+    bool vsync = false;
+    // --center：MNIST 式归一化（裁剪、缩放进 20×20、按质心居中）
+    bool centered = false;
+    // --stats：退出时打印各阶段耗时摘要
+    bool print_stats = false;
+    // --cache <n>：按输入缓存最近 n 个结果，画布没变时不再重跑模型
+    size_t cache_entries = 0;
+    // --digits：松开鼠标时把画布切分成多个数字，一次批量推理后输出整个数字串
+    bool digits_mode = false;
+    for (int i = 1; i < argc; ++i) {
+        if (parseSessionFlag(argc, argv, i, session_config)) {
+            continue;
+        } else if (!std::strcmp(argv[i], "--live")) {
+            live_mode = true;
+        } else if (!std::strcmp(argv[i], "--wait")) {
+            event_driven = true;
+        } else if (!std::strcmp(argv[i], "--vsync")) {
+            vsync = true;
+        } else if (!std::strcmp(argv[i], "--center")) {
+            centered = true;
+        } else if (!std::strcmp(argv[i], "--stats")) {
+            print_stats = true;
+        } else if (!std::strcmp(argv[i], "--digits")) {
+            digits_mode = true;
+        } else if (!std::strcmp(argv[i], "--cache") && i + 1 < argc) {
+            cache_entries = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argv[i][0] != '-') {
+            model_path = argv[i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [options] [model.onnx]\n"
+                      << "  --live           predict continuously on a background thread while drawing\n"
+                      << "  --wait           block on events and redraw only when something changed\n"
+                      << "  --vsync          synchronize presentation with the display refresh\n"
+                      << "  --center         crop, fit to 20x20 and center by mass like the MNIST data\n"
+                      << "  --stats          print per-stage latency statistics on exit\n"
+                      << "  --cache <n>      reuse results for the last n distinct inputs\n"
+                      << "  --digits         also read a multi-digit number off the canvas on release (not with --live)\n"
+                      << sessionFlagsUsage();
+            return -1;
+        }
+    }
+    // --live 时模型归后台线程所有，松开鼠标时不在主线程推理，也就没有机会切分数字
+    if (digits_mode && live_mode) {
+        std::cerr << "--digits cannot be combined with --live" << std::endl;
+        return -1;
+    }
     std::unique_ptr<MNISTModel> mnistModel;
+    Metrics metrics;
+    std::unique_ptr<PredictionCache> cache;
 
     try {
-        mnistModel = std::make_unique<MNISTModel>(model_path);
+#ifdef MNIST_EMBEDDED_MODEL
+        const ModelSource source = model_path ? ModelSource(model_path) : embeddedModel();
+#else
+        const ModelSource source = model_path ? model_path : "mnist.onnx";
+#endif
+        mnistModel = std::make_unique<MNISTModel>(source, session_config);
+        if (centered) {
+            mnistModel->preprocess_mode_ = MNISTModel::PreprocessMode::Centered;
+        }
+        if (print_stats) {
+            mnistModel->metrics_ = &metrics;
+        }
+        if (cache_entries > 0) {
+            cache = std::make_unique<PredictionCache>(cache_entries);
+            mnistModel->cache_ = cache.get();
+        }
     } catch(const Ort::Exception& e) {
         std::cerr << "ONNX Runtime error: " << e.what() << std::endl;
         return -1;
+    } catch(const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
     }
 
     // SDL 初始化
@@ -148,11 +151,13 @@ int main(int argc, char* argv[])
     // 选个大一点的画板，比如 112 = 28*4 倍
     const int width = MNIST_WIDTH * 10;
     const int height = MNIST_HEIGHT * 8;
+    // 画板下方的概率条形图
+    const int chart_height = 64;
 
     SDL_Window* window = SDL_CreateWindow(
         "MNIST Drawing - WSL2 Demo",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        width, height,
+        width, height + chart_height,
         SDL_WINDOW_SHOWN
     );
     if (!window) {
@@ -162,7 +167,8 @@ int main(int argc, char* argv[])
     }
 
    // 创建渲染器  
-   SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);  
+   SDL_Renderer* renderer = SDL_CreateRenderer(window, -1,
+                                               SDL_RENDERER_ACCELERATED | (vsync ? SDL_RENDERER_PRESENTVSYNC : 0));  
    if(!renderer) {  
        std::cerr << "Failed to create renderer: " << SDL_GetError() << std::endl;  
        SDL_DestroyWindow(window);  
@@ -171,30 +177,94 @@ int main(int argc, char* argv[])
    }  
        // MODIFIED: 初始化渲染参数  
        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);  
-       SDL_RenderSetScale(renderer, 1.5f, 1.5f);  // 增加线条粗细  
+       // 笔刷半径（画布像素）
+       const float brush_radius = 8.0f;
 
-    // 创建用于绘制的纹理(ARGB8888)
+    // 笔画在 CPU 侧光栅化到灰度画布，模型直接读取它；纹理只用于显示(RGBA8888)
+    StrokeCanvas canvas(width, height);
     SDL_Texture* texture = SDL_CreateTexture(renderer,
                                              SDL_PIXELFORMAT_RGBA8888,
-                                             SDL_TEXTUREACCESS_TARGET,
+                                             SDL_TEXTUREACCESS_STREAMING,
                                              width, height);
 
-    // 清空为白色背景
-    SDL_SetRenderTarget(renderer, texture);
-    SDL_SetRenderDrawColor(renderer, 255,255,255,255);
-    SDL_RenderClear(renderer);
-    SDL_SetRenderTarget(renderer, NULL);
+    // 把画布的 rect 区域上传到纹理（白底黑字）
+    auto uploadCanvas = [&](const DirtyRect& rect) {
+        if (rect.empty()) {
+            return;
+        }
+        SDL_Rect area{rect.x0, rect.y0, rect.x1 - rect.x0, rect.y1 - rect.y0};
+        void* locked = nullptr;
+        int pitch = 0;
+        if (SDL_LockTexture(texture, &area, &locked, &pitch) == 0) {
+            canvas.toRgba(rect, static_cast<uint8_t*>(locked), pitch);
+            SDL_UnlockTexture(texture);
+        }
+    };
+    // 初始为空白画布
+    uploadCanvas(DirtyRect::full(width, height));
 
     bool quit = false;
     bool drawing = false;
     SDL_Point lastPos{0,0};
 
+    // 输入张量只重算受影响的格子；dirty 为尚未同步给模型的区域，display_dirty 为尚未上传的区域
+    mnistModel->convertImage(canvas.pixels(), width, height, PixelFormat::Gray8);
+    DirtyRect dirty;
+    DirtyRect display_dirty;
+    int livePredicted = -1;
+    // 条形图当前显示的结果
+    Prediction shown;
+
+    // 实时模式下模型归后台线程所有（须在 mnistModel 之后构造、之前析构）
+    std::unique_ptr<LivePredictor> live;
+    // 后台线程出结果时投递的事件，用来唤醒阻塞在 SDL_WaitEventTimeout 上的主循环
+    const Uint32 result_event = SDL_RegisterEvents(1);
+    if (live_mode) {
+        live = std::make_unique<LivePredictor>(*mnistModel, width, height, [result_event] {
+            if (result_event != static_cast<Uint32>(-1)) {
+                SDL_Event event{};
+                event.type = result_event;
+                SDL_PushEvent(&event);
+            }
+        });
+    }
+
+    // 事件驱动模式下没有事件时最长的阻塞时间（毫秒）
+    const int idle_timeout_ms = 1000;
+    bool redraw = true;
+
+    // 把 dirty 区域同步给模型：实时模式交给后台线程，否则就地增量更新模型输入
+    auto syncCanvas = [&]() {
+        if (dirty.empty()) {
+            return;
+        }
+        if (live) {
+            live->post(canvas.data(), dirty);
+        } else {
+            mnistModel->convertRegion(canvas.pixels(), width, height, dirty, PixelFormat::Gray8);
+        }
+        dirty.clear();
+    };
+
+    // 同步推理并更新条形图
+    auto runNow = [&]() {
+        shown.digit = mnistModel->Run();
+        std::copy(mnistModel->results_.begin(), mnistModel->results_.end(), shown.probabilities.begin());
+        return shown.digit;
+    };
+
     std::cout << "Left-click to draw, right-click to clear. Press ESC or close window to quit.\n";
 
     while(!quit) {
         SDL_Event e;
-        while (SDL_PollEvent(&e)) {
+        // 事件驱动模式先阻塞等到第一个事件，然后与轮询模式一样取空队列
+        bool has_event = event_driven ? SDL_WaitEventTimeout(&e, idle_timeout_ms) : SDL_PollEvent(&e);
+        for (; has_event; has_event = SDL_PollEvent(&e)) {
             switch(e.type) {
+                case SDL_WINDOWEVENT:
+                    // 窗口被遮挡/恢复、改变大小等情况需要重绘
+                    redraw = true;
+                    break;
                 case SDL_QUIT:
                     quit = true;
                     break;
@@ -210,34 +280,46 @@ int main(int argc, char* argv[])
                     lastPos.y = std::clamp(e.button.y, 0, height-1);  
                     drawing = true;  
                 }   else if (e.button.button == SDL_BUTTON_RIGHT) {
-                        // 右键清空画布
-                        SDL_SetRenderTarget(renderer, texture);
-                        SDL_SetRenderDrawColor(renderer, 255,255,255,255);
-                        SDL_RenderClear(renderer);
-                        SDL_SetRenderTarget(renderer, NULL);
+                        // 右键清空画布（输入张量同步重置）
+                        canvas.clear();
+                        if (live) {
+                            live->post(canvas.data(), DirtyRect::full(width, height));
+                        } else {
+                            mnistModel->convertImage(canvas.pixels(), width, height, PixelFormat::Gray8);
+                        }
+                        dirty.clear();
+                        display_dirty = DirtyRect::full(width, height);
+                        livePredicted = -1;
+                        shown = Prediction();
+                        redraw = true;
                     }
                     break;
                 case SDL_MOUSEBUTTONUP:
                     if (e.button.button == SDL_BUTTON_LEFT) {
                         drawing = false;
                         // 松开鼠标后，可以进行推理
-                        // 1) 读取当前纹理数据
-                        std::vector<uint8_t> pixels(width*height*4); // RGBA
-                        SDL_SetRenderTarget(renderer, texture);
-                        SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGBA8888, pixels.data(), width*4);
-                        SDL_SetRenderTarget(renderer, NULL);
-
-                        // 2) 转换到 mnist 输入
-                        mnistModel->convertImage(pixels, width, height);
+                        // 1) 读回尚未同步的区域，增量更新 mnist 输入
+                        syncCanvas();
+                        if (live) {
+                            // 最后一笔已提交给后台线程，结果会出现在条形图上
+                            break;
+                        }
 
-                        // 3) 模型推理
-                        int predicted = mnistModel->Run();
+                        // 2) 模型推理
+                        int predicted = runNow();
+                        livePredicted = -1;
+                        redraw = true;
 
-                        // 4) 打印结果
+                        // 3) 打印结果
                         std::cout << "Predicted digit index: " << predicted << "\nProbabilities:\n";
                         for (int i = 0; i < 10; i++) {
                             std::cout << "  " << i << ": " << mnistModel->results_[i] << std::endl;
                         }
+                        if (digits_mode) {
+                            std::cout << "Digits: "
+                                      << mnistModel->RunDigits(canvas.data(), width, height, PixelFormat::Gray8)
+                                      << std::endl;
+                        }
                     }
                     break;
                 case SDL_MOUSEMOTION:
@@ -246,34 +328,74 @@ int main(int argc, char* argv[])
                         int x = std::clamp(e.motion.x, 0, width-1);  
                         int y = std::clamp(e.motion.y, 0, height-1);  
 
-                        SDL_SetRenderTarget(renderer, texture);  
-                        
-                        // 绘制粗线条  
-                        SDL_RenderDrawLine(renderer, lastPos.x, lastPos.y, x, y);  
-                        for(int i = -2; i <= 2; ++i) {  // 5像素宽  
-                            SDL_RenderDrawLine(renderer,   
-                                lastPos.x + i, lastPos.y,   
-                                x + i, y);  
-                        }  
-                        
-                        SDL_SetRenderTarget(renderer, NULL);  
+                        // 以像素中心为端点画抗锯齿粗线，并记录这一段修改的像素
+                        const DirtyRect stroke = canvas.line(lastPos.x + 0.5f, lastPos.y + 0.5f,
+                                                             x + 0.5f, y + 0.5f, brush_radius);
+                        dirty.add(stroke.x0, stroke.y0, stroke.x1, stroke.y1, width, height);
+                        display_dirty.add(stroke.x0, stroke.y0, stroke.x1, stroke.y1, width, height);
                         lastPos = {x, y}; 
+                        redraw = true;
                     }
                     break;
             }
         }
 
-        // 每帧渲染
+        // 书写过程中每帧同步一次变化的区域并推理，预测改变时输出
+        if (drawing && !dirty.empty()) {
+            syncCanvas();
+            if (!live) {
+                int predicted = runNow();
+                redraw = true;
+                if (predicted != livePredicted) {
+                    livePredicted = predicted;
+                    std::cout << "Live prediction: " << predicted << '\n' << std::flush;
+                }
+            }
+        }
+        // 取后台线程的最新结果（没有新结果时保持原样）
+        if (live && live->latest(shown)) {
+            redraw = true;
+            if (shown.digit != livePredicted) {
+                livePredicted = shown.digit;
+                std::cout << "Live prediction: " << shown.digit << '\n' << std::flush;
+            }
+        }
+
+        // 事件驱动模式下画面没有变化就不重绘
+        if (event_driven && !redraw) {
+            continue;
+        }
+        redraw = false;
+
+        // 每帧渲染：先上传画布变化的区域
+        uploadCanvas(display_dirty);
+        display_dirty.clear();
         SDL_SetRenderDrawColor(renderer, 200,200,200,255);
         SDL_RenderClear(renderer);
 
-        // 将画板纹理贴到窗口上
-        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        // 将画板纹理贴到窗口上，下方画概率条形图
+        SDL_Rect canvas_rect{0, 0, width, height};
+        SDL_RenderCopy(renderer, texture, NULL, &canvas_rect);
+        drawChart(renderer, shown, SDL_Rect{0, height, width, chart_height});
         SDL_RenderPresent(renderer);
 
-        SDL_Delay(10); // 降低 CPU 占用
+        if (!event_driven) {
+            SDL_Delay(10); // 降低 CPU 占用
+        }
     }
 
+    // 先停掉后台线程，避免在 SDL_Quit 之后还投递事件
+    live.reset();
+    if (print_stats) {
+        metrics.writeSummary(std::cout);
+        if (cache) {
+            cache->writeSummary(std::cout);
+        }
+    }
+    const std::string profile = mnistModel->onnx().endProfiling();
+    if (!profile.empty()) {
+        std::cout << "ORT profile written to " << profile << std::endl;
+    }
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
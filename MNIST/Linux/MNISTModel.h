@@ -0,0 +1,695 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#include <cmath>
+
+// ONNX Runtime C++ API (需已安装)
+#include <onnxruntime_cxx_api.h>
+
+#include "OnnxModel.h"
+#include "Preprocess.h"
+#include "Postprocess.h"
+#include "Metrics.h"
+#include "ResultCache.h"
+#include "Segmentation.h"
+#include "NativeCnn.h"
+
+static constexpr int MNIST_WIDTH = 28;
+static constexpr int MNIST_HEIGHT = 28;
+static constexpr int MNIST_IMAGE_SIZE = MNIST_WIDTH * MNIST_HEIGHT;
+static constexpr int MNIST_CLASSES = 10;
+static constexpr size_t MNIST_BUFFER_ALIGNMENT = ONNX_BUFFER_ALIGNMENT;
+
+// 精度名 → 随仓库提供的模型文件（均为动态 batch，输出都是 float32 logits）：
+//   fp32：mnist_batch.onnx
+//   fp16：mnist_batch_fp16.onnx，全图半精度，面向 CUDA / TensorRT 与带 fp16 内核的 ARM64 CPU
+//   int8：mnist_batch_int8.onnx，uint8 权重 + 运行时动态量化激活，输入直接是 u8 像素
+// 未知的精度名返回 nullptr
+static inline const char* mnistModelForPrecision(const std::string& precision) {
+    if (precision == "fp32") return "mnist_batch.onnx";
+    if (precision == "fp16") return "mnist_batch_fp16.onnx";
+    if (precision == "int8") return "mnist_batch_int8.onnx";
+    return nullptr;
+}
+
+// 单张图像的推理结果
+struct Prediction {
+    int digit = -1;
+    std::array<float, MNIST_CLASSES> probabilities{};
+};
+
+// 以输入图像为键的结果缓存（见 ResultCache.h）
+using PredictionCache = ResultCache<Prediction>;
+
+// 28×28 输入的缓存键：先量化为 u8 再哈希，相差不到一个灰度级的输入得到同一个键。
+// half 输入直接哈希其位模式（同一画布转换出的 half 完全一致）
+static inline uint64_t imageKey(const uint8_t* image) {
+    return hashBytes(image, MNIST_IMAGE_SIZE);
+}
+
+static inline uint64_t imageKey(const float* image) {
+    uint8_t quantized[MNIST_IMAGE_SIZE];
+    toTensorElements(image, MNIST_IMAGE_SIZE, quantized);
+    return imageKey(quantized);
+}
+
+static inline uint64_t imageKey(const Half* image) {
+    return hashBytes(image, MNIST_IMAGE_SIZE * sizeof(Half));
+}
+
+// 同一输入在两种元素类型之间转换（级联时把本模型的输入交给类型不同的第一级）。
+// float / u8 可转为任一类型；half 没有回转的路径，只能交给同为 half 的模型
+template <typename From, typename To>
+static inline void convertInput(const From* src, size_t count, To* dst) {
+    if constexpr (std::is_same<From, To>::value) {
+        std::memcpy(dst, src, count * sizeof(From));
+    } else if constexpr (std::is_same<From, float>::value) {
+        toTensorElements(src, count, dst);
+    } else if constexpr (std::is_same<From, uint8_t>::value) {
+        grayToTensor(src, count, dst);
+    } else {
+        throw std::invalid_argument("a float16 model can only cascade from a float16 first stage");
+    }
+}
+
+//--------------------------------------------------------------------
+// 封装 MNIST 模型推理：OnnxModel 针对固定形状 N×1×28×28 → N×10 的专用版本。
+// 输入/输出名称取自会话，形状在加载时与编译期常量核对，缓冲仍是定长数组
+//--------------------------------------------------------------------
+struct MNISTModel {
+    using InputShape = StaticShape<1, 1, MNIST_HEIGHT, MNIST_WIDTH>;
+    using OutputShape = StaticShape<1, MNIST_CLASSES>;
+
+    // 一组绑定到会话上的输入/输出缓冲区。绑定一次之后，每次推理
+    // 既不创建张量也不按名称查找，缓冲区由调用方持有。
+    // input 的元素类型与模型输入一致（见 inputType()），output 总是 float。
+    // Ort::Session::Run 是线程安全的：不同线程各用自己的 Binding 时，
+    // Run(Binding&) / RunBatch 可以在同一个 MNISTModel 上并发调用
+    struct Binding {
+        Ort::IoBinding io{nullptr};
+        Ort::Value input_tensor{nullptr};
+        Ort::Value output_tensor{nullptr};
+        void* input = nullptr;
+        float* output = nullptr;
+        size_t batch = 0;
+    };
+
+    // source 为模型文件路径或内存中的模型字节（见 ModelSource.h）；
+    // config 控制图优化、线程数与执行提供者等会话选项
+    MNISTModel(const ModelSource& source, const SessionConfig& config = SessionConfig())
+        : model_(source, config) {
+        init(source, config);
+    }
+
+    // 在共用的 Env 上创建（见 ModelRegistry.h）；prepacked 非空时与其他会话共享预打包权重
+    MNISTModel(Ort::Env& env, const ModelSource& source, const SessionConfig& config,
+               OrtPrepackedWeightsContainer* prepacked = nullptr)
+        : model_(env, source, config, prepacked) {
+        init(source, config);
+    }
+
+    // binding_ 指向自身成员，不可拷贝/移动
+    MNISTModel(const MNISTModel&) = delete;
+    MNISTModel& operator=(const MNISTModel&) = delete;
+
+    // 底层的通用封装（名称、形状等）
+    OnnxModel& onnx() { return model_; }
+
+    // 模型能否以 n 为 batch 运行（动态 N，或固定 N 恰好等于 n；原生后端不受 N 的限制）
+    bool acceptsBatch(size_t n) const {
+        return n > 0 && (native_cnn_ || model_batch_ <= 0 || n == static_cast<size_t>(model_batch_));
+    }
+
+    // 是否由原生内核（SessionConfig::native）推理
+    bool usesNativeCnn() const { return native_cnn_ != nullptr; }
+
+    // 模型输入的元素类型
+    ONNXTensorElementDataType inputType() const { return input_type_; }
+
+    // 以模型输入的元素类型调用 fn(static_cast<T*>(nullptr))，T 为 float / Half / uint8_t，
+    // 调用方据此选择对应类型的缓冲区与重载
+    template <typename Fn>
+    void visitInputType(Fn&& fn) const {
+        switch (input_type_) {
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16: fn(static_cast<Half*>(nullptr)); break;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8: fn(static_cast<uint8_t*>(nullptr)); break;
+        default: fn(static_cast<float*>(nullptr)); break;
+        }
+    }
+
+    // 把调用方的缓冲区绑定为 n×1×28×28 输入和 n×10 输出。
+    // input 的元素类型 T 须与 inputType() 一致；
+    // 两个缓冲区都须按 MNIST_BUFFER_ALIGNMENT 对齐（可用 allocAligned 分配），
+    // 并在 Binding 使用期间保持有效
+    template <typename T>
+    Binding Bind(T* input, float* output, size_t n) {
+        checkInputType<T>();
+        if (reinterpret_cast<uintptr_t>(input) % MNIST_BUFFER_ALIGNMENT != 0 ||
+            reinterpret_cast<uintptr_t>(output) % MNIST_BUFFER_ALIGNMENT != 0) {
+            throw std::invalid_argument("bound buffers must be 64-byte aligned");
+        }
+        if (!acceptsBatch(n)) {
+            throw std::invalid_argument("bound batch size does not match the model's N");
+        }
+
+        const auto input_shape = InputShape::withBatch(static_cast<int64_t>(n));
+        const auto output_shape = OutputShape::withBatch(static_cast<int64_t>(n));
+
+        Binding b;
+        b.input_tensor = Ort::Value::CreateTensor(
+            model_.memoryInfo(), input, n * InputShape::item_count * sizeof(T),
+            input_shape.data(), input_shape.size(), TensorElement<T>::type
+        );
+        b.output_tensor = Ort::Value::CreateTensor<float>(
+            model_.memoryInfo(), output, n * OutputShape::item_count,
+            output_shape.data(), output_shape.size()
+        );
+        b.io = Ort::IoBinding(model_.session());
+        b.io.BindInput(model_.inputNames()[0], b.input_tensor);
+        b.io.BindOutput(model_.outputNames()[0], b.output_tensor);
+        b.input = input;
+        b.output = output;
+        b.batch = n;
+        return b;
+    }
+
+    // 在已绑定的缓冲区上推理：结果直接写入 b.output 并做 softmax
+    // （compute_probabilities_ 为 false 时保留 logits），
+    // predicted 非空时写入 b.batch 个预测数字
+    void Run(Binding& b, int* predicted = nullptr) {
+        RunLogits(b);
+        postprocess(b.output, b.batch, predicted);
+    }
+
+    // 只运行会话，b.output 中留下 logits；之后由调用方（可在别的线程）对它调用 Postprocess()
+    void RunLogits(Binding& b) {
+        StageTimer timer(metrics_, Stage::Run);
+        if (native_cnn_) {
+            mnistCnnForward(*native_cnn_, static_cast<const float*>(b.input), b.batch, b.output);
+        } else {
+            model_.session().Run(model_.run_options_, b.io);
+        }
+    }
+
+    // 对 n×10 的 logits 做 softmax（compute_probabilities_ 为 false 时保留 logits），
+    // predicted 非空时写入 n 个预测数字
+    void Postprocess(float* results, size_t n, int* predicted = nullptr) {
+        postprocess(results, n, predicted);
+    }
+
+    // 运行推理，返回推断结果（数字 0~9）。
+    // 设置了 cache_ 时先按当前输入查缓存，命中则直接把缓存的概率写入 results_，不运行会话；
+    // 设置了 first_stage_ 时先跑第一级，置信度不足才运行本模型
+    int Run() {
+        uint64_t key = 0;
+        if (cache_) {
+            visitInputType([&](auto* tag) {
+                using T = std::remove_pointer_t<decltype(tag)>;
+                key = imageKey(nativeInput<T>());
+            });
+            Prediction cached;
+            if (cache_->lookup(key, cached)) {
+                std::copy(cached.probabilities.begin(), cached.probabilities.end(), results_.begin());
+                return cached.digit;
+            }
+        }
+        int index = 0;
+        if (!first_stage_ || !runFirstStage(index)) {
+            Run(binding_, &index);
+        }
+        if (cache_) {
+            Prediction p;
+            p.digit = index;
+            std::copy(results_.begin(), results_.end(), p.probabilities.begin());
+            cache_->insert(key, p);
+        }
+        return index;
+    }
+
+    // 批量推理：images 为调用方持有的 n×1×28×28 连续内存（元素类型须与 inputType() 一致），
+    // results 同样由调用方提供，需容纳 n×10 个 float，返回时为每张图的 softmax 概率
+    // （compute_probabilities_ 为 false 时为 logits）；
+    // predicted 非空时写入 n 个预测数字。
+    // 动态 N 的模型一次 Run 完成整批，固定 N 的模型则按其 N 分块运行
+    // 设置了 first_stage_ 时整批先经第一级，只把置信度不足的图像收集起来交给本模型
+    template <typename T>
+    void RunBatch(const T* images, size_t n, float* results, int* predicted = nullptr) {
+        checkInputType<T>();
+        if (n == 0) {
+            return;
+        }
+        if (first_stage_) {
+            runCascade(images, n, results, predicted);
+        } else {
+            runChunks(images, n, results, predicted);
+        }
+    }
+
+    // 在 n 张空白图像上跑一次 RunBatch，结果丢弃。会话设置了 SessionConfig::arena 时，
+    // ORT 这一批大小所需的中间张量由此在开始服务前从池中取得，随后留在空闲链表里。
+    // 宜在设置 metrics_ 之前调用，预热不计入统计
+    void WarmUp(size_t n) {
+        AlignedBuffer<uint8_t> images = allocAligned<uint8_t>(n * MNIST_IMAGE_SIZE * sizeof(float));
+        std::memset(images.get(), 0, n * MNIST_IMAGE_SIZE * sizeof(float));
+        AlignedFloats results = allocAligned<float>(n * MNIST_CLASSES);
+        visitInputType([&](auto* tag) {
+            using T = std::remove_pointer_t<decltype(tag)>;
+            RunBatch(reinterpret_cast<const T*>(images.get()), n, results.get());
+        });
+    }
+
+    // 多位数字：把画布切分成各个数字（见 Segmentation.h），逐个裁剪居中后一次 RunBatch 打分，
+    // 返回从左到右的数字串（画布上没有笔迹时为空串）。
+    // digits 非空时写入每个数字的结果，boxes 非空时写入各自在画布上的外接框。
+    // 与 Run() 一样使用模型自带的缓冲，不能与 Run() / convertImage 并发调用
+    std::string RunDigits(const uint8_t* pixels, int width, int height, PixelFormat format = PixelFormat::Rgba8888,
+                          std::vector<Prediction>* digits = nullptr, std::vector<DirtyRect>* boxes = nullptr) {
+        const size_t n = segmenter_.segment(pixels, width, height, format);
+        if (digits) {
+            digits->assign(n, Prediction());
+        }
+        if (boxes) {
+            boxes->clear();
+            for (const DigitSegment& s : segmenter_.segments()) {
+                boxes->push_back(s.box);
+            }
+        }
+        if (n == 0) {
+            return std::string();
+        }
+        if (n > digits_capacity_) {
+            digits_capacity_ = std::max(n, 2 * digits_capacity_);
+            digits_input_ = allocAligned<uint8_t>(digits_capacity_ * MNIST_IMAGE_SIZE * sizeof(float));
+            digits_output_ = allocAligned<float>(digits_capacity_ * MNIST_CLASSES);
+            digits_predicted_.resize(digits_capacity_);
+        }
+
+        visitInputType([&](auto* tag) {
+            using T = std::remove_pointer_t<decltype(tag)>;
+            T* typed = reinterpret_cast<T*>(digits_input_.get());
+            {
+                StageTimer timer(metrics_, Stage::Convert);
+                for (size_t i = 0; i < n; ++i) {
+                    segmenter_.normalize(i, typed + i * MNIST_IMAGE_SIZE);
+                }
+            }
+            RunBatch(typed, n, digits_output_.get(), digits_predicted_.data());
+        });
+
+        std::string text(n, '0');
+        for (size_t i = 0; i < n; ++i) {
+            text[i] = static_cast<char>('0' + digits_predicted_[i]);
+            if (digits) {
+                Prediction& p = (*digits)[i];
+                p.digit = digits_predicted_[i];
+                std::copy(digits_output_.get() + i * MNIST_CLASSES, digits_output_.get() + (i + 1) * MNIST_CLASSES,
+                          p.probabilities.begin());
+            }
+        }
+        return text;
+    }
+
+    // 切分参数（噪点阈值、合并比例等）
+    DigitSegmenter& segmenter() { return segmenter_; }
+
+    // 级联统计：经过第一级的图像数，及其中置信度不足、回落到本模型的图像数
+    uint64_t cascadeImages() const { return cascade_images_.load(std::memory_order_relaxed); }
+    uint64_t cascadeFallbacks() const { return cascade_fallbacks_.load(std::memory_order_relaxed); }
+
+    double fallbackRate() const {
+        const uint64_t n = cascadeImages();
+        return n ? static_cast<double>(cascadeFallbacks()) / n : 0.0;
+    }
+
+    // 画布 → 28×28 的缩放方式
+    enum class PreprocessMode {
+        Nearest,   // 最近邻：每个输出像素只采样一个源像素
+        Area,      // 面积平均：取覆盖区域内所有像素的均值（SIMD）
+        Centered,  // MNIST 式：裁剪到笔迹外接框、缩放进 20×20、按质心居中于 28×28
+    };
+
+    // 把 bigWidth × bigHeight 的画布（默认 RGBA8888）转换为 Run() 的输入
+    // （float 模型写入 input_image_，其他模型直接写成其输入类型）
+    void convertImage(const std::vector<uint8_t>& sdl_pixels, int bigWidth, int bigHeight,
+                      PixelFormat format = PixelFormat::Rgba8888) {
+        visitInputType([&](auto* tag) {
+            using T = std::remove_pointer_t<decltype(tag)>;
+            convertImage(sdl_pixels.data(), bigWidth, bigHeight, nativeInput<T>(), format);
+        });
+    }
+
+    // 同上，但写入调用方给定的 28×28 缓冲（如 Bind() 的某个 batch 槽位）；
+    // T 为 float / Half / uint8_t，预处理直接输出该类型，不经过中间的 float 张量
+    template <typename T>
+    void convertImage(const uint8_t* sdl_pixels, int bigWidth, int bigHeight, T* dst,
+                      PixelFormat format = PixelFormat::Rgba8888) {
+        StageTimer timer(metrics_, Stage::Convert);
+        if (preprocess_mode_ == PreprocessMode::Area) {
+            resampler_(sdl_pixels, bigWidth, bigHeight, dst, format);
+        } else if (preprocess_mode_ == PreprocessMode::Centered) {
+            centering_(sdl_pixels, bigWidth, bigHeight, dst, format);
+        } else {
+            resampler_.nearest(sdl_pixels, bigWidth, bigHeight, dst, format);
+        }
+    }
+
+    // 增量转换：只重算与画布上 dirty 矩形相交的输入像素，其余保持上一次转换的结果。
+    // 须在同一画布（尺寸不变）的完整 convertImage 之后使用。
+    // Centered 模式下外接框与质心取决于整幅画布，总是完整转换
+    void convertRegion(const std::vector<uint8_t>& sdl_pixels, int bigWidth, int bigHeight, const DirtyRect& dirty,
+                       PixelFormat format = PixelFormat::Rgba8888) {
+        if (preprocess_mode_ == PreprocessMode::Centered) {
+            convertImage(sdl_pixels, bigWidth, bigHeight, format);
+            return;
+        }
+        StageTimer timer(metrics_, Stage::Convert);
+        visitInputType([&](auto* tag) {
+            using T = std::remove_pointer_t<decltype(tag)>;
+            resampler_.region(sdl_pixels.data(), bigWidth, bigHeight, nativeInput<T>(), dirty,
+                              preprocess_mode_ == PreprocessMode::Area, format);
+        });
+    }
+
+    PreprocessMode preprocess_mode_ = PreprocessMode::Area;
+    // 只需要预测数字时可关闭 softmax，results 中保留原始 logits
+    bool compute_probabilities_ = true;
+    // 非空时各阶段耗时与推理的图像数记入其中（见 Metrics.h）；可由多个模型/线程共用
+    Metrics* metrics_ = nullptr;
+    // 非空时 Run() 经由这个结果缓存；切换 compute_probabilities_ 后须 clear()
+    PredictionCache* cache_ = nullptr;
+    // 非空时组成两级级联：Run() / RunBatch 先用这个更小的模型预测，最大概率不低于
+    // confidence_threshold_ 的图像直接采用其结果，其余再由本模型重算。
+    // first_stage_ 须保持 compute_probabilities_ 为 true 并比本模型活得久；
+    // 被采用的图像在 results 中总是第一级的 softmax 概率
+    MNISTModel* first_stage_ = nullptr;
+    float confidence_threshold_ = 0.9f;
+
+    // 用于存放 28×28 的浮点图像数据
+    alignas(MNIST_BUFFER_ALIGNMENT) std::array<float, MNIST_IMAGE_SIZE> input_image_{};
+    // 模型的输出概率（10 个数字的概率分布）
+    alignas(MNIST_BUFFER_ALIGNMENT) std::array<float, MNIST_CLASSES> results_{};
+
+private:
+    // 核对模型的输入/输出并绑定 Run() 用的缓冲
+    void init(const ModelSource& source, const SessionConfig& config) {
+        if (model_.inputs().size() != 1 || model_.outputs().size() != 1) {
+            throw std::runtime_error("model must have exactly one input and one output");
+        }
+        const TensorSpec& input = model_.inputs()[0];
+        const TensorSpec& output = model_.outputs()[0];
+        if (!InputShape::matches(input.shape) || !OutputShape::matches(output.shape)) {
+            throw std::runtime_error("model input/output must be N x 1 x 28 x 28 / N x 10");
+        }
+
+        // 模型输入的 N 维：-1 表示动态 batch（如 mnist_batch.onnx），
+        // 否则为固定值（原版 mnist.onnx 固定为 1）
+        model_batch_ = input.shape[0];
+
+        // 输入可以是 float32 / float16 / uint8，输出须是 float32 logits
+        input_type_ = input.type;
+        if (input_type_ != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT &&
+            input_type_ != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16 &&
+            input_type_ != ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8) {
+            throw std::runtime_error("model input must be float32, float16 or uint8");
+        }
+        if (output.type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+            throw std::runtime_error("model output must be float32 logits");
+        }
+
+        // 把 input_image_（非 float 模型为 native_input_）/ results_ 绑定到会话上，供 Run() 使用
+        visitInputType([this](auto* tag) {
+            using T = std::remove_pointer_t<decltype(tag)>;
+            binding_ = Bind(nativeInput<T>(), results_.data(), 1);
+        });
+
+        if (config.native) {
+            if (input_type_ != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+                throw std::runtime_error("the native backend needs a float32 model");
+            }
+            auto native = std::make_unique<MnistCnn>();
+            loadMnistCnn(*native, source);
+            checkNative(*native);
+            native_cnn_ = std::move(native);
+        }
+    }
+
+    // 用几张确定的探测图像比较原生内核与 ORT 的 logits，超出容差时拒绝使用原生后端
+    void checkNative(const MnistCnn& native) {
+        constexpr size_t probes = 4;
+        AlignedFloats images = allocAligned<float>(probes * MNIST_IMAGE_SIZE);
+        AlignedFloats expected = allocAligned<float>(probes * MNIST_CLASSES);
+        AlignedFloats actual = allocAligned<float>(probes * MNIST_CLASSES);
+        // 全黑一张，其余为稀疏的随机笔迹
+        uint32_t seed = 2463534242u;
+        for (size_t i = 0; i < probes * MNIST_IMAGE_SIZE; ++i) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            images.get()[i] = i < MNIST_IMAGE_SIZE || seed % 4 ? 0.0f : (seed >> 8) / 16777216.0f;
+        }
+        runSession(images.get(), probes, expected.get());
+        mnistCnnForward(native, images.get(), probes, actual.get());
+
+        float scale = 1.0f, diff = 0.0f;
+        for (size_t i = 0; i < probes * MNIST_CLASSES; ++i) {
+            scale = std::max(scale, std::fabs(expected.get()[i]));
+            diff = std::max(diff, std::fabs(expected.get()[i] - actual.get()[i]));
+        }
+        if (diff > 1e-3f * scale) {
+            throw std::runtime_error("native kernels disagree with ONNX Runtime (max |diff| " + std::to_string(diff) + ")");
+        }
+    }
+
+    // 运行本模型并做 softmax
+    template <typename T>
+    void runChunks(const T* images, size_t n, float* results, int* predicted) {
+        if constexpr (std::is_same<T, float>::value) {
+            if (native_cnn_) {
+                StageTimer timer(metrics_, Stage::Run);
+                mnistCnnForward(*native_cnn_, images, n, results);
+            } else {
+                runSession(images, n, results);
+            }
+        } else {
+            runSession(images, n, results);
+        }
+        postprocess(results, n, predicted);
+    }
+
+    // 在会话上按模型的固定 N 分块推理，results 中为 logits
+    template <typename T>
+    void runSession(const T* images, size_t n, float* results) {
+        const size_t chunk = model_batch_ > 0 ? static_cast<size_t>(model_batch_) : n;
+        if (n % chunk != 0) {
+            throw std::invalid_argument("batch size must be a multiple of the model's fixed N");
+        }
+
+        for (size_t begin = 0; begin < n; begin += chunk) {
+            const auto input_shape = InputShape::withBatch(static_cast<int64_t>(chunk));
+            const auto output_shape = OutputShape::withBatch(static_cast<int64_t>(chunk));
+
+            // 直接在调用方内存上创建张量，不做拷贝；ORT 不会写输入，const_cast 只为匹配接口
+            Ort::Value input = Ort::Value::CreateTensor(
+                model_.memoryInfo(), const_cast<T*>(images + begin * InputShape::item_count),
+                chunk * InputShape::item_count * sizeof(T),
+                input_shape.data(), input_shape.size(), TensorElement<T>::type
+            );
+            Ort::Value output = Ort::Value::CreateTensor<float>(
+                model_.memoryInfo(), results + begin * OutputShape::item_count, chunk * OutputShape::item_count,
+                output_shape.data(), output_shape.size()
+            );
+            StageTimer timer(metrics_, Stage::Run);
+            model_.Run(&input, &output);
+        }
+    }
+
+    // 用第一级预测 Run() 的当前输入；置信度足够时把其结果写入 results_ 并返回 true
+    bool runFirstStage(int& index) {
+        checkFirstStage();
+        visitInputType([&](auto* tag) {
+            using T = std::remove_pointer_t<decltype(tag)>;
+            first_stage_->visitInputType([&](auto* first_tag) {
+                using U = std::remove_pointer_t<decltype(first_tag)>;
+                convertInput(nativeInput<T>(), MNIST_IMAGE_SIZE, first_stage_->nativeInput<U>());
+            });
+        });
+        const int digit = first_stage_->Run();
+        cascade_images_.fetch_add(1, std::memory_order_relaxed);
+        if (first_stage_->results_[digit] < confidence_threshold_) {
+            cascade_fallbacks_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        results_ = first_stage_->results_;
+        index = digit;
+        return true;
+    }
+
+    // 整批先经第一级，再把最大概率低于阈值的图像收集成一批交给本模型，结果写回原位置
+    template <typename T>
+    void runCascade(const T* images, size_t n, float* results, int* predicted) {
+        checkFirstStage();
+        // 固定 N 的模型按 N 的整数倍运行，不足的槽位重复最后一张图像
+        const size_t chunk = model_batch_ > 0 ? static_cast<size_t>(model_batch_) : 1;
+        const CascadeScratchLease lease;
+        CascadeScratch& scratch = lease.scratch;
+        scratch.reserve(n + chunk);
+        int* digits = predicted ? predicted : scratch.digits.data();
+        first_stage_->visitInputType([&](auto* tag) {
+            using U = std::remove_pointer_t<decltype(tag)>;
+            if constexpr (std::is_same<T, U>::value) {
+                first_stage_->RunBatch(images, n, results, digits);
+            } else {
+                U* converted = reinterpret_cast<U*>(scratch.converted.get());
+                convertInput(images, n * MNIST_IMAGE_SIZE, converted);
+                first_stage_->RunBatch(converted, n, results, digits);
+            }
+        });
+
+        std::vector<size_t>& uncertain = scratch.uncertain;
+        uncertain.clear();
+        for (size_t i = 0; i < n; ++i) {
+            if (results[i * MNIST_CLASSES + digits[i]] < confidence_threshold_) {
+                uncertain.push_back(i);
+            }
+        }
+        cascade_images_.fetch_add(n, std::memory_order_relaxed);
+        cascade_fallbacks_.fetch_add(uncertain.size(), std::memory_order_relaxed);
+        if (uncertain.empty()) {
+            return;
+        }
+
+        const size_t m = (uncertain.size() + chunk - 1) / chunk * chunk;
+        T* gathered = reinterpret_cast<T*>(scratch.gathered.get());
+        float* rescored = scratch.rescored.get();
+        for (size_t k = 0; k < m; ++k) {
+            const size_t i = uncertain[std::min(k, uncertain.size() - 1)];
+            std::memcpy(gathered + k * MNIST_IMAGE_SIZE, images + i * MNIST_IMAGE_SIZE, MNIST_IMAGE_SIZE * sizeof(T));
+        }
+        runChunks(gathered, m, rescored, scratch.rescored_digits.data());
+        for (size_t k = 0; k < uncertain.size(); ++k) {
+            const size_t i = uncertain[k];
+            std::memcpy(results + i * MNIST_CLASSES, rescored + k * MNIST_CLASSES, MNIST_CLASSES * sizeof(float));
+            digits[i] = scratch.rescored_digits[k];
+        }
+    }
+
+    // runCascade 的暂存缓冲，只增不减（图像按 float 的大小分配，足以容纳任一种输入类型），
+    // 稳态下级联不再触碰堆
+    struct CascadeScratch {
+        size_t capacity = 0;
+        AlignedBuffer<uint8_t> converted;
+        AlignedBuffer<uint8_t> gathered;
+        AlignedFloats rescored;
+        std::vector<int> digits;
+        std::vector<int> rescored_digits;
+        std::vector<size_t> uncertain;
+
+        void reserve(size_t n) {
+            if (n <= capacity) {
+                return;
+            }
+            capacity = std::max(n, 2 * capacity);
+            converted = allocAligned<uint8_t>(capacity * MNIST_IMAGE_SIZE * sizeof(float));
+            gathered = allocAligned<uint8_t>(capacity * MNIST_IMAGE_SIZE * sizeof(float));
+            rescored = allocAligned<float>(capacity * MNIST_CLASSES);
+            digits.resize(capacity);
+            rescored_digits.resize(capacity);
+            uncertain.reserve(capacity);
+        }
+    };
+
+    // RunBatch 可被多个线程（如 InferencePool 的工作线程）并发调用，暂存缓冲按线程各一份；
+    // 第一级本身也是级联时，它的 runCascade 在同一线程上重入，所以每层嵌套再各用一份，
+    // 内层不会改动或重新分配外层仍在使用的缓冲
+    struct CascadeScratchLease {
+        CascadeScratchLease() : scratch(acquire()) {}
+        ~CascadeScratchLease() { --depth(); }
+
+        CascadeScratchLease(const CascadeScratchLease&) = delete;
+        CascadeScratchLease& operator=(const CascadeScratchLease&) = delete;
+
+        CascadeScratch& scratch;
+
+    private:
+        static size_t& depth() {
+            thread_local size_t d = 0;
+            return d;
+        }
+
+        // 每层一个独立分配的 CascadeScratch，levels 扩容时外层持有的引用不失效
+        static CascadeScratch& acquire() {
+            thread_local std::vector<std::unique_ptr<CascadeScratch>> levels;
+            const size_t level = depth();
+            if (level == levels.size()) {
+                levels.push_back(std::make_unique<CascadeScratch>());
+            }
+            ++depth();
+            return *levels[level];
+        }
+    };
+
+    // 阈值比较的是第一级的 softmax 概率
+    void checkFirstStage() const {
+        if (!first_stage_->compute_probabilities_) {
+            throw std::invalid_argument("the first-stage model must compute probabilities");
+        }
+    }
+
+    void postprocess(float* results, size_t n, int* predicted) {
+        StageTimer timer(metrics_, Stage::Softmax);
+        softmaxArgmax<MNIST_CLASSES>(results, n, predicted, compute_probabilities_);
+        if (metrics_) {
+            metrics_->addImages(n);
+        }
+    }
+
+    template <typename T>
+    void checkInputType() const {
+        if (TensorElement<T>::type != input_type_) {
+            throw std::invalid_argument("input buffer type does not match the model's input type");
+        }
+    }
+
+    // Run() 使用的单张输入缓冲
+    template <typename T>
+    T* nativeInput() {
+        if constexpr (std::is_same<T, float>::value) {
+            return input_image_.data();
+        } else {
+            return reinterpret_cast<T*>(native_input_.data());
+        }
+    }
+
+    // 会话与加载时读取的输入/输出信息
+    OnnxModel model_;
+    // input_image_ / results_ 的绑定
+    Binding binding_;
+    // 缩放用的边界/查找表与中间缓冲
+    AreaResampler<MNIST_WIDTH, MNIST_HEIGHT> resampler_;
+    CenteringResampler<MNIST_WIDTH, MNIST_HEIGHT, 20> centering_;
+    // 模型输入的 N 维，-1 表示动态
+    int64_t model_batch_ = 1;
+    // SessionConfig::native 时的原生内核与重排后的权重
+    std::unique_ptr<MnistCnn> native_cnn_;
+    ONNXTensorElementDataType input_type_ = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+    std::atomic<uint64_t> cascade_images_{0};
+    std::atomic<uint64_t> cascade_fallbacks_{0};
+    // RunDigits 的切分器与按需增长的批缓冲（按 float 的大小分配，足以容纳任一种输入类型）
+    DigitSegmenter segmenter_;
+    size_t digits_capacity_ = 0;
+    AlignedBuffer<uint8_t> digits_input_;
+    AlignedFloats digits_output_;
+    std::vector<int> digits_predicted_;
+    // float16 / uint8 模型 Run() 的输入
+    alignas(MNIST_BUFFER_ALIGNMENT) std::array<uint8_t, MNIST_IMAGE_SIZE * sizeof(Half)> native_input_{};
+};
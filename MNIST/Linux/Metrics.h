@@ -0,0 +1,201 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <ostream>
+#include <cstdint>
+
+//--------------------------------------------------------------------
+// 热路径计时：各阶段的耗时记入无锁直方图，可导出为 Prometheus 文本格式，
+// 或由 StatsReporter 定期打印摘要。未设置 Metrics 时计时器什么也不做
+//--------------------------------------------------------------------
+enum class Stage {
+    Queue,    // 请求在 InferencePool 队列中的等待
+    Convert,  // 画布 → 28×28 输入（convertImage / convertRegion）
+    Run,      // Session::Run
+    Softmax,  // softmax / argmax
+    Count,
+};
+
+static inline const char* stageName(Stage stage) {
+    switch (stage) {
+    case Stage::Queue: return "queue";
+    case Stage::Convert: return "convert";
+    case Stage::Run: return "run";
+    case Stage::Softmax: return "softmax";
+    default: return "unknown";
+    }
+}
+
+// 按 2 的幂纳秒分桶的延迟直方图：第 i 个桶收二进制位数为 i 的耗时，即 [2^(i-1), 2^i) ns，
+// 最后一个桶收其余（约 1 s 以上）。只用 relaxed 原子操作，多个线程可并发记录
+struct LatencyHistogram {
+    static constexpr int kBuckets = 32;
+
+    void record(uint64_t ns) {
+        const int bits = ns ? 64 - __builtin_clzll(ns) : 0;
+        buckets_[std::min(bits, kBuckets - 1)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t prev = max_ns_.load(std::memory_order_relaxed);
+        while (ns > prev && !max_ns_.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sumNs() const { return sum_ns_.load(std::memory_order_relaxed); }
+    uint64_t maxNs() const { return max_ns_.load(std::memory_order_relaxed); }
+    uint64_t bucket(int i) const { return buckets_[i].load(std::memory_order_relaxed); }
+
+    // 第 i 个桶的上界（不含），最后一个桶没有上界
+    static uint64_t upperBoundNs(int i) { return uint64_t(1) << i; }
+
+    // 近似分位数：第 q 分位所在桶的上界（落在最后一个桶时返回最大值）
+    uint64_t quantileNs(double q) const {
+        const uint64_t total = count();
+        if (!total) {
+            return 0;
+        }
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * total + 0.5));
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets - 1; ++i) {
+            seen += bucket(i);
+            if (seen >= rank) {
+                return std::min(upperBoundNs(i), maxNs());
+            }
+        }
+        return maxNs();
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_ns_{0};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+struct Metrics {
+    using Clock = std::chrono::steady_clock;
+
+    void record(Stage stage, Clock::duration elapsed) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        stages_[static_cast<size_t>(stage)].histogram.record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+    }
+
+    void addImages(uint64_t n) { images_.fetch_add(n, std::memory_order_relaxed); }
+
+    const LatencyHistogram& histogram(Stage stage) const { return stages_[static_cast<size_t>(stage)].histogram; }
+    uint64_t images() const { return images_.load(std::memory_order_relaxed); }
+
+    // Prometheus 文本格式：<prefix>_stage_seconds{stage="..."} 直方图与 <prefix>_images_total 计数。
+    // 只输出 1 µs 起的桶，更细的并入第一个桶
+    void writePrometheus(std::ostream& out, const char* prefix = "mnist") const {
+        constexpr int first_bucket = 10;
+        out << "# HELP " << prefix << "_stage_seconds Time spent in each inference stage.\n"
+            << "# TYPE " << prefix << "_stage_seconds histogram\n";
+        for (size_t s = 0; s < stages_.size(); ++s) {
+            const LatencyHistogram& h = stages_[s].histogram;
+            const char* name = stageName(static_cast<Stage>(s));
+            uint64_t cumulative = 0;
+            for (int i = 0; i < LatencyHistogram::kBuckets - 1; ++i) {
+                cumulative += h.bucket(i);
+                if (i >= first_bucket) {
+                    out << prefix << "_stage_seconds_bucket{stage=\"" << name << "\",le=\""
+                        << LatencyHistogram::upperBoundNs(i) * 1e-9 << "\"} " << cumulative << '\n';
+                }
+            }
+            out << prefix << "_stage_seconds_bucket{stage=\"" << name << "\",le=\"+Inf\"} " << h.count() << '\n'
+                << prefix << "_stage_seconds_sum{stage=\"" << name << "\"} " << h.sumNs() * 1e-9 << '\n'
+                << prefix << "_stage_seconds_count{stage=\"" << name << "\"} " << h.count() << '\n';
+        }
+        out << "# HELP " << prefix << "_images_total Images scored.\n"
+            << "# TYPE " << prefix << "_images_total counter\n"
+            << prefix << "_images_total " << images() << '\n';
+    }
+
+    // 人读的摘要：每个有记录的阶段一行（次数、平均、p50 / p99 的桶上界、最大值，单位 µs）
+    void writeSummary(std::ostream& out) const {
+        out << "images: " << images() << '\n';
+        for (size_t s = 0; s < stages_.size(); ++s) {
+            const LatencyHistogram& h = stages_[s].histogram;
+            if (!h.count()) {
+                continue;
+            }
+            out << "  " << stageName(static_cast<Stage>(s)) << ": n=" << h.count()
+                << " mean=" << h.sumNs() * 1e-3 / h.count() << "us"
+                << " p50<=" << h.quantileNs(0.50) * 1e-3 << "us"
+                << " p99<=" << h.quantileNs(0.99) * 1e-3 << "us"
+                << " max=" << h.maxNs() * 1e-3 << "us\n";
+        }
+        out.flush();
+    }
+
+private:
+    // 每个阶段独占缓存行，不同阶段的并发记录互不干扰
+    struct alignas(64) Slot {
+        LatencyHistogram histogram;
+    };
+    std::array<Slot, static_cast<size_t>(Stage::Count)> stages_{};
+    alignas(64) std::atomic<uint64_t> images_{0};
+};
+
+// 作用域计时器：析构时把经过的时间记入 metrics 的 stage；metrics 为空时不读时钟
+struct StageTimer {
+    StageTimer(Metrics* metrics, Stage stage)
+        : metrics_(metrics), stage_(stage), start_(metrics ? Metrics::Clock::now() : Metrics::Clock::time_point()) {}
+
+    ~StageTimer() {
+        if (metrics_) {
+            metrics_->record(stage_, Metrics::Clock::now() - start_);
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    Metrics* metrics_;
+    Stage stage_;
+    Metrics::Clock::time_point start_;
+};
+
+//--------------------------------------------------------------------
+// 后台线程每隔 interval 调用一次 report（如把 writeSummary 打印到 stderr）
+//--------------------------------------------------------------------
+struct StatsReporter {
+    StatsReporter(std::chrono::milliseconds interval, std::function<void()> report)
+        : interval_(interval), report_(std::move(report)) {
+        thread_ = std::thread([this] {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!wakeup_.wait_for(lock, interval_, [this] { return stop_; })) {
+                report_();
+            }
+        });
+    }
+
+    ~StatsReporter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_one();
+        thread_.join();
+    }
+
+    StatsReporter(const StatsReporter&) = delete;
+    StatsReporter& operator=(const StatsReporter&) = delete;
+
+private:
+    const std::chrono::milliseconds interval_;
+    const std::function<void()> report_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    std::thread thread_;
+};
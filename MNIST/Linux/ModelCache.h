@@ -0,0 +1,144 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "SessionConfig.h"
+#include "ModelSource.h"
+
+//--------------------------------------------------------------------
+// 优化后模型的启动缓存：首次加载时把优化过的图以 ORT 格式保存到
+// config.cache_dir，之后直接加载这份缓存，省去解析与图优化。
+// 缓存键 = 模型内容哈希 + ORT 版本 + 优化级别 + CPU 指令集，
+// 任何一项变化都会生成新的缓存文件
+//--------------------------------------------------------------------
+
+// 64 位 FNV-1a
+static inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static inline bool fileExists(const std::string& path) {
+    struct stat st{};
+    return ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// ORT_ENABLE_ALL 的布局优化与 CPU 指令集相关，缓存不能跨机型复用
+static inline const char* cpuIsaTag() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx512f")) return "avx512";
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    return "sse";
+#elif defined(__aarch64__)
+    return "arm64";
+#else
+    return "generic";
+#endif
+}
+
+// 返回该模型在 cache_dir 下的缓存路径；模型无法读取时返回空串
+static inline std::string modelCachePath(const ModelSource& source, const SessionConfig& config) {
+    std::vector<char> bytes;
+    if (!source.inMemory()) {
+        std::ifstream in(source.name, std::ios::binary);
+        if (!in) {
+            return std::string();
+        }
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    std::string key = std::string(OrtGetApiBase()->GetVersionString()) + '|' +
+                      std::to_string(static_cast<int>(config.optimization_level)) + '|' + cpuIsaTag();
+    uint64_t hash = source.inMemory() ? fnv1a(source.data, source.size) : fnv1a(bytes.data(), bytes.size());
+    hash = fnv1a(key.data(), key.size(), hash);
+
+    // 文件名：<模型名>.<哈希>.ort
+    std::string stem = source.name;
+    size_t slash = stem.find_last_of('/');
+    if (slash != std::string::npos) stem = stem.substr(slash + 1);
+    size_t dot = stem.find_last_of('.');
+    if (dot != std::string::npos) stem = stem.substr(0, dot);
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return config.cache_dir + '/' + stem + '.' + hex + ".ort";
+}
+
+// 按 config 创建会话；设置了 cache_dir 且只用 CPU 时经由 ORT 格式缓存加载。
+// prepacked 非空时，与共用同一容器的其他会话共享预打包后的权重。
+// config.mmap_model 时映射模型文件（及缓存文件）再从内存创建；ORT 格式的映射字节
+// 由会话直接引用（权重不再拷贝，多进程共用页缓存），此时映射存入 *mapping，
+// 调用方须让它与会话同生命周期（mapping 为空时不直接引用）
+static inline Ort::Session createSession(const Ort::Env& env, const ModelSource& source, const SessionConfig& config,
+                                         OrtPrepackedWeightsContainer* prepacked = nullptr,
+                                         std::shared_ptr<const MappedFile>* mapping = nullptr) {
+    Ort::SessionOptions options;
+    applySessionConfig(options, config);
+    auto open = [&](const ModelSource& src, Ort::SessionOptions& opts) {
+        if (!src.inMemory()) {
+            const char* path = src.name.c_str();
+            return prepacked ? Ort::Session(env, path, opts, prepacked) : Ort::Session(env, path, opts);
+        }
+        if (isOrtFormat(src.data, src.size) && (!src.mapping || mapping)) {
+            opts.AddConfigEntry("session.use_ort_model_bytes_directly", "1");
+            opts.AddConfigEntry("session.use_ort_model_bytes_for_initializers", "1");
+            if (mapping) {
+                *mapping = src.mapping;
+            }
+        }
+        return prepacked ? Ort::Session(env, src.data, src.size, opts, prepacked)
+                         : Ort::Session(env, src.data, src.size, opts);
+    };
+    auto resolve = [&](const ModelSource& src) {
+        return config.mmap_model && !src.inMemory() ? ModelSource::mapFile(src.name.c_str()) : src;
+    };
+    const ModelSource model = resolve(source);
+
+    // 编译型 EP（TensorRT / OpenVINO）用各自的引擎缓存（见 appendProvider），
+    // 分配给其他 EP 的图不能保存为 ORT 格式；用户自己指定了保存路径时也不介入
+    if (config.cache_dir.empty() || !config.providers.empty() || !config.optimized_model_path.empty()) {
+        return open(model, options);
+    }
+
+    const std::string cached = modelCachePath(model, config);
+    if (cached.empty()) {
+        return open(model, options);
+    }
+
+    if (fileExists(cached)) {
+        try {
+            // 缓存里已是优化后的图，不再重复优化
+            Ort::SessionOptions cached_options;
+            applySessionConfig(cached_options, config);
+            cached_options.SetGraphOptimizationLevel(ORT_DISABLE_ALL);
+            cached_options.AddConfigEntry("session.load_model_format", "ORT");
+            return open(resolve(cached.c_str()), cached_options);
+        } catch (const std::exception& e) {
+            // 缓存损坏、无法映射或与当前 ORT 不兼容：重新生成
+            std::cerr << "Ignoring unusable model cache " << cached << ": " << e.what() << std::endl;
+        }
+    }
+
+    // 先写到临时文件再 rename，避免同时启动的进程读到写了一半的缓存
+    const std::string tmp = cached + ".tmp." + std::to_string(::getpid());
+    options.SetOptimizedModelFilePath(tmp.c_str());
+    options.AddConfigEntry("session.save_model_format", "ORT");
+    Ort::Session session = open(model, options);
+    if (std::rename(tmp.c_str(), cached.c_str()) != 0) {
+        std::remove(tmp.c_str());
+    }
+    return session;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "MNISTModel.h"
+
+//--------------------------------------------------------------------
+// 进程内共用的 Env：带全局 intra-op / inter-op 线程池。
+// 第一次调用时按参数创建，之后的调用返回同一个 Env（参数被忽略）。
+// 在它上面创建的会话须设置 SessionConfig::global_threads
+//--------------------------------------------------------------------
+static inline Ort::Env& sharedEnv(int intra_op_threads = 0, int inter_op_threads = 0) {
+    static Ort::Env env = [&] {
+        Ort::ThreadingOptions threading;
+        if (intra_op_threads > 0) {
+            threading.SetGlobalIntraOpNumThreads(intra_op_threads);
+        }
+        if (inter_op_threads > 0) {
+            threading.SetGlobalInterOpNumThreads(inter_op_threads);
+        }
+        return Ort::Env(threading, ORT_LOGGING_LEVEL_WARNING, "shared-env");
+    }();
+    return env;
+}
+
+//--------------------------------------------------------------------
+// 在一个进程里按名称托管多个模型（不同模型或同一模型的不同版本）：
+// 所有会话共用 sharedEnv() 的线程池，并共用一个预打包权重容器——
+// 含相同初始化器的会话（如同一模型加载多次）只保留一份预打包后的权重。
+// Model 为 MNISTModel 或 OnnxModel 这类接受 (Env&, source, config, prepacked) 的封装
+//--------------------------------------------------------------------
+template <typename Model = MNISTModel>
+struct ModelRegistry {
+    // 线程数只在进程里第一次创建 sharedEnv() 时生效（0 = ORT 默认）
+    explicit ModelRegistry(int intra_op_threads = 0, int inter_op_threads = 0)
+        : env_(sharedEnv(intra_op_threads, inter_op_threads)),
+          prepacked_(std::make_shared<Ort::PrepackedWeightsContainer>()) {}
+
+    // 加载 source 并登记为 name（已有同名模型时替换它；仍在使用旧模型的调用方不受影响）。
+    // config 中的线程数被全局线程池取代
+    std::shared_ptr<Model> load(const std::string& name, const ModelSource& source, SessionConfig config = SessionConfig()) {
+        config.global_threads = true;
+        // 删除器持有容器的引用：模型比注册表活得久时，预打包权重仍然有效
+        std::shared_ptr<Ort::PrepackedWeightsContainer> prepacked = prepacked_;
+        std::shared_ptr<Model> model(new Model(env_, source, config, *prepacked),
+                                     [prepacked](Model* m) { delete m; });
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        models_[name] = model;
+        return model;
+    }
+
+    // 未登记时返回空指针
+    std::shared_ptr<Model> get(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = models_.find(name);
+        return it == models_.end() ? nullptr : it->second;
+    }
+
+    // 注销 name；模型在最后一个使用者释放后才销毁
+    bool unload(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return models_.erase(name) > 0;
+    }
+
+    std::vector<std::string> names() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::string> out;
+        for (const auto& entry : models_) {
+            out.push_back(entry.first);
+        }
+        return out;
+    }
+
+    Ort::Env& env() { return env_; }
+
+private:
+    Ort::Env& env_;
+    std::shared_ptr<Ort::PrepackedWeightsContainer> prepacked_;
+    mutable std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<Model>> models_;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//--------------------------------------------------------------------
+// 只读映射整个文件。MAP_SHARED：同一主机上映射同一文件的多个进程共用页缓存
+//--------------------------------------------------------------------
+struct MappedFile {
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open model file " + path);
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot read model file " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("cannot map model file " + path);
+        }
+        // 会话创建时整个模型都会被读一遍，提前预读
+        ::madvise(p, size_, MADV_WILLNEED);
+        data_ = p;
+    }
+
+    ~MappedFile() { ::munmap(data_, size_); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const void* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// ORT 格式模型（flatbuffer，文件标识 "ORTM" 位于偏移 4）；其余按 ONNX protobuf 处理
+static inline bool isOrtFormat(const void* data, size_t size) {
+    return size >= 8 && std::memcmp(static_cast<const uint8_t*>(data) + 4, "ORTM", 4) == 0;
+}
+
+//--------------------------------------------------------------------
+// 模型从哪里加载：文件路径，或内存中的模型字节（编译进程序的数据 / 映射的文件）。
+// 可由 const char* 隐式构造，原来传路径的调用处不变
+//--------------------------------------------------------------------
+struct ModelSource {
+    ModelSource(const char* path) : name(path ? path : "") {}
+
+    // 调用方的内存（如编译进程序的 embedded 模型），须在使用它的会话存续期间保持有效
+    static ModelSource fromMemory(const void* data, size_t size, const char* name = "embedded") {
+        ModelSource s(name);
+        s.data = data;
+        s.size = size;
+        return s;
+    }
+
+    // 映射 path 并从映射的字节加载；映射由 mapping 持有
+    static ModelSource mapFile(const char* path) {
+        ModelSource s(path);
+        s.mapping = std::make_shared<MappedFile>(path);
+        s.data = s.mapping->data();
+        s.size = s.mapping->size();
+        return s;
+    }
+
+    bool inMemory() const { return data != nullptr; }
+
+    // 文件路径；内存来源时只是名称（用于缓存文件名与日志）
+    std::string name;
+    const void* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const MappedFile> mapping;
+};
+
+#ifdef MNIST_EMBEDDED_MODEL
+// CMake 的 embed_model() 生成的模型字节（MNIST_EMBEDDED_MODEL 为原文件名）
+extern const unsigned char embedded_model_data[];
+extern const size_t embedded_model_size;
+
+static inline ModelSource embeddedModel() {
+    return ModelSource::fromMemory(embedded_model_data, embedded_model_size, MNIST_EMBEDDED_MODEL);
+}
+#endif
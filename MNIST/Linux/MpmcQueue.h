@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+//--------------------------------------------------------------------
+// 有界无锁多生产者/多消费者队列（Dmitry Vyukov 的环形数组算法）
+// 每个槽位带一个序号：生产者和消费者各自用 CAS 抢占位置，
+// 之后只通过该槽位的序号交接数据，不需要任何锁
+//--------------------------------------------------------------------
+template <typename T>
+struct MpmcQueue {
+    // capacity 必须是 2 的幂
+    explicit MpmcQueue(size_t capacity)
+        : mask_(capacity - 1), cells_(new Cell[capacity]) {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("MpmcQueue capacity must be a power of two");
+        }
+        for (size_t i = 0; i < capacity; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    // 队列满时返回 false，value 保持不变
+    bool tryPush(T&& value) {
+        Cell* cell;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 队列空时返回 false
+    bool tryPop(T& value) {
+        Cell* cell;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->data);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 近似的元素个数（并发修改时只作参考）
+    size_t sizeApprox() const {
+        size_t tail = enqueue_pos_.load(std::memory_order_acquire);
+        size_t head = dequeue_pos_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    // 生产者与消费者的位置各占一个缓存行，避免伪共享
+    static constexpr size_t kCacheLine = 64;
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(kCacheLine) std::atomic<size_t> enqueue_pos_{0};
+    alignas(kCacheLine) std::atomic<size_t> dequeue_pos_{0};
+};
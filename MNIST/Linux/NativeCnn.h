@@ -0,0 +1,299 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <stdexcept>
+
+#include "OnnxProto.h"
+#include "ModelSource.h"
+
+//--------------------------------------------------------------------
+// 原生推理后端：加载时从 .onnx 里取出 conv → relu → pool → conv → relu → pool → gemm 的权重，
+// 之后不经 ORT，直接用形状全部在编译期确定的融合内核推理。
+// 激活按 HWC（通道在最内层）排布，每次对 8 个输出通道做一次向量乘加；
+// 偏置、ReLU 与最大池化在卷积累加器上完成，卷积结果不落地。
+// 向量用 GCC 的 vector_size 扩展表示，x86-64 上整个前向再按 AVX2+FMA 与基线各编一份，
+// 运行时按 CPU 选择（与 Postprocess.h 的做法相同，只是由编译器生成分派）
+//--------------------------------------------------------------------
+namespace native_cnn {
+
+// aligned(4)：可直接在任意 float 地址上读写；GCC 的向量类型可与其元素类型互为别名
+using Vec8 = float __attribute__((vector_size(32), aligned(4)));
+
+#define NATIVE_CNN_INLINE inline __attribute__((always_inline))
+
+// 以引用访问，向量不经函数按值传递（否则在未开 AVX 的翻译单元里会有 -Wpsabi 提示）
+NATIVE_CNN_INLINE const Vec8& vec(const float* p) { return *reinterpret_cast<const Vec8*>(p); }
+NATIVE_CNN_INLINE Vec8& vec(float* p) { return *reinterpret_cast<Vec8*>(p); }
+
+}  // namespace native_cnn
+
+// Size×Size 单通道输入；两层 K×K（stride 1、same padding）卷积，输出 C1 / C2 个通道，
+// 各接 Pool1 / Pool2 的不重叠最大池化（向下取整）；最后全连接到 Classes 个 logits
+template <int Size, int C1, int C2, int K, int Pool1, int Pool2, int Classes>
+struct FusedCnn {
+    static_assert(C1 % 8 == 0 && C2 % 8 == 0, "channel counts must be multiples of the vector width");
+    static_assert(K % 2 == 1, "same padding needs an odd kernel");
+    static_assert(Size % Pool1 == 0, "the first pool must tile the image");
+
+    static constexpr int Pad = K / 2;
+    static constexpr int S1 = Size / Pool1;          // 第一次池化后的边长
+    static constexpr int S2 = S1 / Pool2;            // 第二次池化后的边长
+    static constexpr int Features = S2 * S2 * C2;    // 全连接的输入
+    static constexpr int ClassesPadded = (Classes + 7) / 8 * 8;
+    static constexpr int P0 = Size + 2 * Pad;        // 补零后的输入边长
+    static constexpr int P1 = S1 + 2 * Pad;          // 补零后的第一层输出边长
+
+    // 权重已重排为内层连续的输出通道：w1[ky][kx][oc]、w2[ky][kx][ic][oc]、wf[(y*S2+x)*C2+c][class]
+    alignas(64) float w1[K][K][C1];
+    alignas(64) float b1[C1];
+    alignas(64) float w2[K][K][C1][C2];
+    alignas(64) float b2[C2];
+    alignas(64) float wf[Features][ClassesPadded];
+    alignas(64) float bf[ClassesPadded];
+
+    // 一张图像：image 为 Size×Size 的 float，logits 写入 Classes 个 float
+    NATIVE_CNN_INLINE void forward(const float* image, float* logits) const {
+        using namespace native_cnn;
+        alignas(64) float in[P0][P0] = {};
+        alignas(64) float a1[P1][P1][C1] = {};
+        alignas(64) float a2[S2][S2][C2];
+
+        for (int y = 0; y < Size; ++y) {
+            std::memcpy(&in[y + Pad][Pad], image + y * Size, Size * sizeof(float));
+        }
+
+        // conv1 + bias + relu + pool1：每个池化窗口的 Pool1×Pool1 个卷积输出共用同一组权重向量
+        for (int py = 0; py < S1; ++py) {
+            for (int px = 0; px < S1; ++px) {
+                for (int g = 0; g < C1; g += 8) {
+                    Vec8 acc[Pool1][Pool1] = {};
+                    for (int ky = 0; ky < K; ++ky) {
+                        for (int kx = 0; kx < K; ++kx) {
+                            const Vec8 w = vec(&w1[ky][kx][g]);
+                            for (int dy = 0; dy < Pool1; ++dy) {
+                                for (int dx = 0; dx < Pool1; ++dx) {
+                                    acc[dy][dx] += w * in[py * Pool1 + dy + ky][px * Pool1 + dx + kx];
+                                }
+                            }
+                        }
+                    }
+                    // 偏置对窗口内各点相同，可在取最大值之后再加
+                    Vec8 m = acc[0][0];
+                    for (int dy = 0; dy < Pool1; ++dy) {
+                        for (int dx = 0; dx < Pool1; ++dx) m = acc[dy][dx] > m ? acc[dy][dx] : m;
+                    }
+                    m += vec(&b1[g]);
+                    vec(&a1[py + Pad][px + Pad][g]) = m > 0 ? m : 0;
+                }
+            }
+        }
+
+        // conv2 + bias + relu + pool2：只算被池化窗口覆盖的 S2*Pool2 行列；
+        // 一次算窗口的一行（Pool2 个像素 × C2 个通道），每个广播的输入标量供 C2/8 次乘加
+        constexpr int G2 = C2 / 8;
+        for (int qy = 0; qy < S2; ++qy) {
+            for (int qx = 0; qx < S2; ++qx) {
+                Vec8 m[G2];
+                for (Vec8& v : m) v = Vec8{} + std::numeric_limits<float>::lowest();
+                for (int dy = 0; dy < Pool2; ++dy) {
+                    const int y = qy * Pool2 + dy;
+                    Vec8 acc[Pool2][G2] = {};
+                    for (int ky = 0; ky < K; ++ky) {
+                        for (int kx = 0; kx < K; ++kx) {
+                            for (int ic = 0; ic < C1; ++ic) {
+                                Vec8 w[G2];
+                                for (int g = 0; g < G2; ++g) w[g] = vec(&w2[ky][kx][ic][g * 8]);
+                                for (int dx = 0; dx < Pool2; ++dx) {
+                                    const float v = a1[y + ky][qx * Pool2 + dx + kx][ic];
+                                    for (int g = 0; g < G2; ++g) acc[dx][g] += w[g] * v;
+                                }
+                            }
+                        }
+                    }
+                    for (int g = 0; g < G2; ++g) {
+                        for (int dx = 0; dx < Pool2; ++dx) m[g] = acc[dx][g] > m[g] ? acc[dx][g] : m[g];
+                    }
+                }
+                for (int g = 0; g < G2; ++g) {
+                    const Vec8 v = m[g] + vec(&b2[g * 8]);
+                    vec(&a2[qy][qx][g * 8]) = v > 0 ? v : 0;
+                }
+            }
+        }
+
+        // 全连接 + bias
+        const float* features = &a2[0][0][0];
+        Vec8 out[ClassesPadded / 8];
+        for (int j = 0; j < ClassesPadded / 8; ++j) out[j] = vec(&bf[j * 8]);
+        for (int k = 0; k < Features; ++k) {
+            for (int j = 0; j < ClassesPadded / 8; ++j) out[j] += vec(&wf[k][j * 8]) * features[k];
+        }
+        alignas(64) float padded[ClassesPadded];
+        for (int j = 0; j < ClassesPadded / 8; ++j) vec(&padded[j * 8]) = out[j];
+        std::memcpy(logits, padded, Classes * sizeof(float));
+    }
+
+    // 从 ONNX 图中取权重：依次匹配 Conv (+Add) → Relu → MaxPool → Conv (+Add) → Relu → MaxPool
+    // → Reshape/Flatten → MatMul → Add，并核对各层的形状、步长与补零方式与模板参数一致
+    void load(const OnnxGraph& graph) {
+        std::string cur;
+        for (const std::string& name : graph.inputs) {
+            if (!graph.initializer(name)) {
+                cur = name;
+                break;
+            }
+        }
+        const OnnxTensor* w;
+        const OnnxTensor* b;
+
+        w = conv(graph, cur, b, C1, 1);
+        repack(*w, *b, &w1[0][0][0], b1, 1, C1);
+        expect(graph, cur, "Relu");
+        pool(graph, cur, Pool1);
+
+        w = conv(graph, cur, b, C2, C1);
+        repack(*w, *b, &w2[0][0][0][0], b2, C1, C2);
+        expect(graph, cur, "Relu");
+        pool(graph, cur, Pool2);
+
+        const OnnxNode& flatten = next(graph, cur);
+        if (flatten.op_type != "Reshape" && flatten.op_type != "Flatten") mismatch("expected a Reshape before the MatMul");
+        cur = flatten.outputs[0];
+        const OnnxNode& matmul = expect(graph, cur, "MatMul");
+        w = constant(graph, matmul.inputs.at(1));
+        if (w->elementCount() != static_cast<size_t>(Features) * Classes) mismatch("fully connected weight shape");
+        const OnnxNode& add = expect(graph, cur, "Add");
+        b = constant(graph, add.inputs.at(1));
+        if (b->elementCount() != static_cast<size_t>(Classes)) mismatch("fully connected bias shape");
+        if (std::find(graph.outputs.begin(), graph.outputs.end(), cur) == graph.outputs.end()) {
+            mismatch("the final Add must be the graph output");
+        }
+
+        // ONNX 按 CHW 展平（c*S2*S2 + y*S2 + x），这里的特征按 HWC 排布
+        std::fill(&wf[0][0], &wf[0][0] + Features * ClassesPadded, 0.0f);
+        std::fill(bf, bf + ClassesPadded, 0.0f);
+        for (int c = 0; c < C2; ++c) {
+            for (int i = 0; i < S2 * S2; ++i) {
+                const float* row = w->floats.data() + static_cast<size_t>(c * S2 * S2 + i) * Classes;
+                std::copy(row, row + Classes, wf[i * C2 + c]);
+            }
+        }
+        std::copy(b->floats.begin(), b->floats.end(), bf);
+    }
+
+private:
+    [[noreturn]] static void mismatch(const std::string& what) {
+        throw std::runtime_error("model does not match the native CNN: " + what);
+    }
+
+    static const OnnxNode& next(const OnnxGraph& graph, const std::string& tensor) {
+        const OnnxNode* n = graph.consumer(tensor);
+        if (!n || n->outputs.empty()) mismatch("graph ends after '" + tensor + "'");
+        return *n;
+    }
+
+    // cur 的下一个节点须为 op，cur 前进到它的输出
+    static const OnnxNode& expect(const OnnxGraph& graph, std::string& cur, const char* op) {
+        const OnnxNode& n = next(graph, cur);
+        if (n.op_type != op) mismatch(std::string("expected ") + op + ", found " + n.op_type);
+        cur = n.outputs[0];
+        return n;
+    }
+
+    static int64_t intAttribute(const OnnxNode& n, const char* name, int64_t fallback) {
+        const OnnxAttribute* a = n.attribute(name);
+        return a ? a->i : fallback;
+    }
+
+    // 各维都等于 v（未设置视为 fallback）
+    static bool allInts(const OnnxNode& n, const char* name, int64_t v, int64_t fallback) {
+        const OnnxAttribute* a = n.attribute(name);
+        if (!a) return v == fallback;
+        for (int64_t x : a->ints) {
+            if (x != v) return false;
+        }
+        return true;
+    }
+
+    // float 常量：initializer，或对 initializer 做 Reshape 的结果（数据顺序不变）
+    static const OnnxTensor* constant(const OnnxGraph& graph, const std::string& name) {
+        const OnnxTensor* t = graph.initializer(name);
+        if (!t) {
+            const OnnxNode* p = graph.producer(name);
+            if (p && p->op_type == "Reshape") t = graph.initializer(p->inputs.at(0));
+        }
+        if (!t || t->data_type != 1 || t->floats.size() != t->elementCount()) {
+            mismatch("'" + name + "' is not a float constant");
+        }
+        return t;
+    }
+
+    // K×K、stride 1、same padding 的卷积，偏置可以是 Conv 的第三个输入或紧跟的 Add
+    static const OnnxTensor* conv(const OnnxGraph& graph, std::string& cur, const OnnxTensor*& bias, int out, int in) {
+        const OnnxNode& n = expect(graph, cur, "Conv");
+        const OnnxAttribute* pad = n.attribute("auto_pad");
+        const bool same = pad && (pad->s == "SAME_UPPER" || pad->s == "SAME_LOWER");
+        if (!allInts(n, "kernel_shape", K, K) || !allInts(n, "strides", 1, 1) || !allInts(n, "dilations", 1, 1) ||
+            intAttribute(n, "group", 1) != 1 || !(same || allInts(n, "pads", Pad, 0))) {
+            mismatch("unexpected Conv attributes");
+        }
+        const OnnxTensor* w = constant(graph, n.inputs.at(1));
+        if (w->dims != std::vector<int64_t>{out, in, K, K}) mismatch("Conv weight shape");
+        if (n.inputs.size() > 2 && !n.inputs[2].empty()) {
+            bias = constant(graph, n.inputs[2]);
+        } else {
+            bias = constant(graph, expect(graph, cur, "Add").inputs.at(1));
+        }
+        if (bias->elementCount() != static_cast<size_t>(out)) mismatch("Conv bias shape");
+        return w;
+    }
+
+    static void pool(const OnnxGraph& graph, std::string& cur, int size) {
+        const OnnxNode& n = expect(graph, cur, "MaxPool");
+        const OnnxAttribute* pad = n.attribute("auto_pad");
+        if (!allInts(n, "kernel_shape", size, -1) || !allInts(n, "strides", size, 1) || !allInts(n, "pads", 0, 0) ||
+            intAttribute(n, "ceil_mode", 0) != 0 || (pad && pad->s != "NOTSET" && pad->s != "VALID")) {
+            mismatch("unexpected MaxPool attributes");
+        }
+    }
+
+    // OIHW → [ky][kx][ic][oc]
+    static void repack(const OnnxTensor& w, const OnnxTensor& b, float* dst, float* bias, int in, int out) {
+        for (int oc = 0; oc < out; ++oc) {
+            for (int ic = 0; ic < in; ++ic) {
+                for (int k = 0; k < K * K; ++k) {
+                    dst[(k * in + ic) * out + oc] = w.floats[(static_cast<size_t>(oc) * in + ic) * K * K + k];
+                }
+            }
+        }
+        std::copy(b.floats.begin(), b.floats.end(), bias);
+    }
+};
+
+// mnist.onnx（及同结构的 mnist_batch.onnx）：28×28 → 8@5×5 → pool 2 → 16@5×5 → pool 3 → 10
+using MnistCnn = FusedCnn<28, 8, 16, 5, 2, 3, 10>;
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target_clones("arch=x86-64-v3", "default")))
+#endif
+static void mnistCnnForward(const MnistCnn& net, const float* images, size_t n, float* logits) {
+    for (size_t i = 0; i < n; ++i) {
+        net.forward(images + i * 28 * 28, logits + i * 10);
+    }
+}
+
+// 从模型文件或内存中的模型字节载入权重；模型结构不符时抛出异常
+static inline void loadMnistCnn(MnistCnn& net, const ModelSource& source) {
+    if (source.inMemory()) {
+        net.load(parseOnnxGraph(source.data, source.size));
+    } else {
+        MappedFile file(source.name);
+        net.load(parseOnnxGraph(file.data(), file.size()));
+    }
+}
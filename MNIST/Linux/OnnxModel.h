@@ -0,0 +1,374 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <mutex>
+
+// ONNX Runtime C++ API (需已安装)
+#include <onnxruntime_cxx_api.h>
+
+#include "SessionConfig.h"
+#include "ModelCache.h"
+#include "ModelSource.h"
+#include "Preprocess.h"
+#include "BufferPool.h"
+
+// 绑定给 ORT 的缓冲区要求的对齐字节数（缓存行 / AVX-512 宽度）
+static constexpr size_t ONNX_BUFFER_ALIGNMENT = 64;
+
+//--------------------------------------------------------------------
+// 64 字节对齐的缓冲区，供 Bind() / allocateBuffers() 使用；
+// 来自 BufferPool 时析构归还给它，否则还给系统
+//--------------------------------------------------------------------
+struct AlignedFree {
+    BufferPool* pool = nullptr;
+
+    template <typename T>
+    void operator()(T* p) const {
+        if (pool) {
+            pool->release(p);
+        } else {
+            std::free(p);
+        }
+    }
+};
+template <typename T>
+using AlignedBuffer = std::unique_ptr<T[], AlignedFree>;
+using AlignedFloats = AlignedBuffer<float>;
+
+// pool 非空时从中分配（超出其上限时抛 std::bad_alloc）
+template <typename T = float>
+inline AlignedBuffer<T> allocAligned(size_t count, BufferPool* pool = nullptr) {
+    static_assert(BufferPool::kAlignment % ONNX_BUFFER_ALIGNMENT == 0, "pool blocks must satisfy the binding alignment");
+    if (pool) {
+        return AlignedBuffer<T>(static_cast<T*>(pool->allocate(count * sizeof(T))), AlignedFree{pool});
+    }
+    // aligned_alloc 要求大小是对齐值的整数倍（0 个元素时也分配一个对齐块）
+    size_t bytes = (std::max<size_t>(count * sizeof(T), 1) + ONNX_BUFFER_ALIGNMENT - 1) / ONNX_BUFFER_ALIGNMENT * ONNX_BUFFER_ALIGNMENT;
+    void* p = std::aligned_alloc(ONNX_BUFFER_ALIGNMENT, bytes);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return AlignedBuffer<T>(static_cast<T*>(p));
+}
+
+//--------------------------------------------------------------------
+// 把 BufferPool 作为自定义 OrtAllocator 提供给 ORT：注册到 Env 上（attach）后，
+// 设置了 SessionConfig::arena 的会话的中间张量与输出也从这个池分配，
+// 与 allocAligned(count, &arena.pool()) 分配的绑定缓冲共用同一个上限。
+// 须比使用它的会话活得久
+//--------------------------------------------------------------------
+struct TensorArena : OrtAllocator {
+    // limit_bytes 为整个池（ORT 的中间张量 + 调用方缓冲）的上限，0 = 不限
+    explicit TensorArena(size_t limit_bytes = 0)
+        : OrtAllocator{}, pool_(limit_bytes),
+          memory_info_("Cpu", OrtDeviceAllocator, 0, OrtMemTypeDefault) {
+        // 只声明用到的回调；version 18 起 ORT 才会调用 Reserve
+#if ORT_API_VERSION >= 18
+        version = 18;
+        Reserve = [](OrtAllocator* self, size_t size) { return static_cast<TensorArena*>(self)->pool_.tryAllocate(size); };
+#else
+        version = ORT_API_VERSION;
+#endif
+        Alloc = [](OrtAllocator* self, size_t size) { return static_cast<TensorArena*>(self)->pool_.tryAllocate(size); };
+        Free = [](OrtAllocator* self, void* p) { static_cast<TensorArena*>(self)->pool_.release(p); };
+        Info = [](const OrtAllocator* self) -> const OrtMemoryInfo* {
+            return static_cast<const TensorArena*>(self)->memory_info_;
+        };
+    }
+
+    // 从注册过的 env 上摘下，免得（通常是静态的）env 比 arena 活得久时留下悬空的分配器；
+    // 用到它的会话须已析构
+    ~TensorArena() {
+        for (Ort::Env* env : envs_) {
+            try {
+                env->UnregisterAllocator(memory_info_);
+            } catch (const Ort::Exception&) {
+            }
+        }
+    }
+
+    TensorArena(const TensorArena&) = delete;
+    TensorArena& operator=(const TensorArena&) = delete;
+
+    // 注册为 env 的共享 CPU 分配器（每个 Env 只注册一次）
+    void attach(Ort::Env& env) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (std::find(envs_.begin(), envs_.end(), &env) != envs_.end()) {
+            return;
+        }
+        env.RegisterAllocator(this);
+        envs_.push_back(&env);
+    }
+
+    BufferPool& pool() { return pool_; }
+    const BufferPool& pool() const { return pool_; }
+
+private:
+    BufferPool pool_;
+    Ort::MemoryInfo memory_info_;
+    std::mutex mutex_;
+    std::vector<Ort::Env*> envs_;
+};
+
+//--------------------------------------------------------------------
+// C++ 元素类型与 ONNX 类型的对应
+//--------------------------------------------------------------------
+template <typename T> struct TensorElement;
+template <> struct TensorElement<float> { static constexpr ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT; };
+template <> struct TensorElement<Half> { static constexpr ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16; };
+template <> struct TensorElement<uint8_t> { static constexpr ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8; };
+template <> struct TensorElement<int8_t> { static constexpr ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8; };
+template <> struct TensorElement<int32_t> { static constexpr ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32; };
+template <> struct TensorElement<int64_t> { static constexpr ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64; };
+
+// 元素字节数；不支持的类型（string 等）返回 0
+static inline size_t elementSize(ONNXTensorElementDataType type) {
+    switch (type) {
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL: return 1;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16: return 2;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32: return 4;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64: return 8;
+    default: return 0;
+    }
+}
+
+//--------------------------------------------------------------------
+// 模型的一个输入/输出：名称、形状（-1 为动态维度）与元素类型，加载时读取一次
+//--------------------------------------------------------------------
+struct TensorSpec {
+    std::string name;
+    std::vector<int64_t> shape;
+    ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+
+    // 首维按 batch 代入后的形状；首维以外的动态维度无法确定，抛出异常
+    std::vector<int64_t> resolved(int64_t batch) const {
+        std::vector<int64_t> dims = shape;
+        for (size_t i = 0; i < dims.size(); ++i) {
+            if (dims[i] >= 0) {
+                continue;
+            }
+            if (i != 0) {
+                throw std::invalid_argument("tensor '" + name + "' has a dynamic dimension other than the batch");
+            }
+            dims[i] = batch;
+        }
+        return dims;
+    }
+
+    size_t elementCount(int64_t batch) const {
+        size_t count = 1;
+        for (int64_t d : resolved(batch)) {
+            count *= static_cast<size_t>(d);
+        }
+        return count;
+    }
+
+    size_t bytes(int64_t batch) const { return elementCount(batch) * elementSize(type); }
+};
+
+//--------------------------------------------------------------------
+// 编译期已知的固定形状（首维为 batch，运行时代入），
+// 供 MNISTModel 这类专用封装使用：缓冲大小与形状数组都是常量，推理路径没有额外开销
+//--------------------------------------------------------------------
+template <int64_t... Dims>
+struct StaticShape {
+    static constexpr size_t rank = sizeof...(Dims);
+    static constexpr std::array<int64_t, rank> dims{Dims...};
+    // 单个样本（首维以外）的元素个数
+    static constexpr size_t item_count = [] {
+        size_t n = 1;
+        for (size_t i = 1; i < rank; ++i) n *= static_cast<size_t>(dims[i]);
+        return n;
+    }();
+
+    static constexpr std::array<int64_t, rank> withBatch(int64_t batch) {
+        std::array<int64_t, rank> d = dims;
+        d[0] = batch;
+        return d;
+    }
+
+    // 模型声明的形状与之相符：秩相同，首维以外的维度相等（首维是 batch，单独检查）
+    static bool matches(const std::vector<int64_t>& shape) {
+        if (shape.size() != rank) {
+            return false;
+        }
+        for (size_t i = 1; i < rank; ++i) {
+            if (shape[i] != dims[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+//--------------------------------------------------------------------
+// 与具体模型无关的封装：加载时从会话读取所有输入/输出的名称、形状与类型并缓存，
+// 之后按名称数组与预分配缓冲推理，不再查询会话
+//--------------------------------------------------------------------
+struct OnnxModel {
+    // 自带一个 Env（及其线程池）
+    OnnxModel(const ModelSource& source, const SessionConfig& config = SessionConfig())
+        : own_env_(std::make_unique<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "onnx-env")) {
+        load(*own_env_, source, config, nullptr);
+    }
+
+    // 在调用方的 Env 上创建会话（多个模型共用 Env 与线程池，见 ModelRegistry.h）；
+    // env 与 prepacked 须比本对象活得久
+    OnnxModel(Ort::Env& env, const ModelSource& source, const SessionConfig& config,
+              OrtPrepackedWeightsContainer* prepacked = nullptr) {
+        load(env, source, config, prepacked);
+    }
+
+    // 名称指针指向自身成员，不可拷贝/移动
+    OnnxModel(const OnnxModel&) = delete;
+    OnnxModel& operator=(const OnnxModel&) = delete;
+
+    const std::vector<TensorSpec>& inputs() const { return inputs_; }
+    const std::vector<TensorSpec>& outputs() const { return outputs_; }
+    // 与 inputs() / outputs() 顺序一致的名称数组，可直接传给 Session::Run
+    const char* const* inputNames() const { return input_names_.data(); }
+    const char* const* outputNames() const { return output_names_.data(); }
+
+    Ort::Session& session() { return session_; }
+    const Ort::MemoryInfo& memoryInfo() const { return memory_info_; }
+
+    // 为每个输入/输出按 batch 预分配对齐缓冲并绑定到会话；之后 Run() 直接在这些缓冲上推理
+    void allocateBuffers(int64_t batch = 1) {
+        io_ = Ort::IoBinding(session_);
+        input_buffers_.clear();
+        output_buffers_.clear();
+        input_values_.clear();
+        output_values_.clear();
+        for (const TensorSpec& s : inputs_) {
+            bindBuffer(s, batch, input_buffers_, input_values_);
+            io_.BindInput(s.name.c_str(), input_values_.back());
+        }
+        for (const TensorSpec& s : outputs_) {
+            bindBuffer(s, batch, output_buffers_, output_values_);
+            io_.BindOutput(s.name.c_str(), output_values_.back());
+        }
+        batch_ = batch;
+    }
+
+    // allocateBuffers() 分配的第 i 个输入/输出缓冲；T 须与其元素类型一致
+    template <typename T>
+    T* input(size_t i) { return buffer<T>(inputs_, input_buffers_, i); }
+    template <typename T>
+    T* output(size_t i) { return buffer<T>(outputs_, output_buffers_, i); }
+    int64_t batch() const { return batch_; }
+
+    // 在 allocateBuffers() 的缓冲上推理
+    void Run() {
+        if (!batch_) {
+            throw std::logic_error("allocateBuffers() must be called before Run()");
+        }
+        session_.Run(run_options_, io_);
+    }
+
+    // 在调用方的张量上推理，个数与顺序同 inputs() / outputs()
+    void Run(const Ort::Value* inputs, Ort::Value* outputs) {
+        session_.Run(run_options_, input_names_.data(), inputs, inputs_.size(),
+                     output_names_.data(), outputs, outputs_.size());
+    }
+
+    // 结束 ORT 性能分析并返回写出的 JSON 文件名；未开启（SessionConfig::profile_prefix 为空）时返回空串。
+    // 开启后不调用时，会话销毁时同样会写出
+    std::string endProfiling() {
+        if (!profiling_) {
+            return std::string();
+        }
+        profiling_ = false;
+        Ort::AllocatorWithDefaultOptions allocator;
+        return session_.EndProfilingAllocated(allocator).get();
+    }
+
+    Ort::RunOptions run_options_;
+
+private:
+    void load(Ort::Env& env, const ModelSource& source, const SessionConfig& config,
+              OrtPrepackedWeightsContainer* prepacked) {
+        // 创建会话（可经由启动缓存）；使用 arena 时会话从 Env 上注册的分配器取内存
+        arena_ = config.arena;
+        if (arena_) {
+            arena_->attach(env);
+        }
+        session_ = createSession(env, source, config, prepacked, &mapping_);
+        profiling_ = !config.profile_prefix.empty();
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        for (size_t i = 0; i < session_.GetInputCount(); ++i) {
+            inputs_.push_back(readSpec(session_.GetInputNameAllocated(i, allocator).get(), session_.GetInputTypeInfo(i)));
+        }
+        for (size_t i = 0; i < session_.GetOutputCount(); ++i) {
+            outputs_.push_back(readSpec(session_.GetOutputNameAllocated(i, allocator).get(), session_.GetOutputTypeInfo(i)));
+        }
+        // 名称指针指向 spec 里的字符串，vector 之后不再增删
+        for (const TensorSpec& s : inputs_) input_names_.push_back(s.name.c_str());
+        for (const TensorSpec& s : outputs_) output_names_.push_back(s.name.c_str());
+    }
+
+    static TensorSpec readSpec(const char* name, const Ort::TypeInfo& info) {
+        auto tensor = info.GetTensorTypeAndShapeInfo();
+        TensorSpec spec;
+        spec.name = name;
+        spec.shape = tensor.GetShape();
+        spec.type = tensor.GetElementType();
+        return spec;
+    }
+
+    void bindBuffer(const TensorSpec& s, int64_t batch, std::vector<AlignedBuffer<uint8_t>>& buffers,
+                    std::vector<Ort::Value>& values) {
+        if (!elementSize(s.type)) {
+            throw std::runtime_error("tensor '" + s.name + "' has an unsupported element type");
+        }
+        const std::vector<int64_t> dims = s.resolved(batch);
+        buffers.push_back(allocAligned<uint8_t>(s.bytes(batch), arena_ ? &arena_->pool() : nullptr));
+        values.push_back(Ort::Value::CreateTensor(memory_info_, buffers.back().get(), s.bytes(batch),
+                                                  dims.data(), dims.size(), s.type));
+    }
+
+    template <typename T>
+    static T* buffer(const std::vector<TensorSpec>& specs, std::vector<AlignedBuffer<uint8_t>>& buffers, size_t i) {
+        if (i >= buffers.size()) {
+            throw std::out_of_range("no buffer allocated for this tensor");
+        }
+        if (TensorElement<T>::type != specs[i].type) {
+            throw std::invalid_argument("buffer type does not match tensor '" + specs[i].name + "'");
+        }
+        return reinterpret_cast<T*>(buffers[i].get());
+    }
+
+    // 未指定 Env 时自己持有的 Env，须先于 session_ 构造、晚于它析构
+    std::unique_ptr<Ort::Env> own_env_;
+    // 会话直接引用的映射模型（见 createSession），同样须晚于 session_ 析构
+    std::shared_ptr<const MappedFile> mapping_;
+    Ort::Session session_{nullptr};
+    Ort::MemoryInfo memory_info_ = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+
+    std::vector<TensorSpec> inputs_;
+    std::vector<TensorSpec> outputs_;
+    std::vector<const char*> input_names_;
+    std::vector<const char*> output_names_;
+
+    // allocateBuffers() 的缓冲与绑定
+    Ort::IoBinding io_{nullptr};
+    std::vector<AlignedBuffer<uint8_t>> input_buffers_;
+    std::vector<AlignedBuffer<uint8_t>> output_buffers_;
+    std::vector<Ort::Value> input_values_;
+    std::vector<Ort::Value> output_values_;
+    int64_t batch_ = 0;
+    bool profiling_ = false;
+    TensorArena* arena_ = nullptr;
+};
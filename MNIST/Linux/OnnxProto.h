@@ -0,0 +1,270 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <stdexcept>
+
+//--------------------------------------------------------------------
+// 最小的 ONNX（protobuf）读取器：只解出 ModelProto.graph 里的节点、initializer
+// 与输入/输出名称，足以在不依赖 protobuf 库的情况下取出小模型的权重（见 NativeCnn.h）。
+// 只支持内嵌在模型里的张量数据，不支持 external data
+//--------------------------------------------------------------------
+struct OnnxTensor {
+    std::string name;
+    std::vector<int64_t> dims;
+    int32_t data_type = 0;          // TensorProto.DataType：1 = float，7 = int64
+    std::vector<float> floats;
+    std::vector<int64_t> ints;
+
+    size_t elementCount() const {
+        size_t n = 1;
+        for (int64_t d : dims) n *= static_cast<size_t>(d);
+        return n;
+    }
+};
+
+struct OnnxAttribute {
+    std::string name;
+    int64_t i = 0;
+    float f = 0;
+    std::string s;
+    std::vector<int64_t> ints;
+};
+
+struct OnnxNode {
+    std::string op_type;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    std::vector<OnnxAttribute> attributes;
+
+    // 未设置时返回空指针
+    const OnnxAttribute* attribute(const char* name) const {
+        for (const OnnxAttribute& a : attributes) {
+            if (a.name == name) return &a;
+        }
+        return nullptr;
+    }
+};
+
+struct OnnxGraph {
+    std::vector<OnnxNode> nodes;
+    std::vector<OnnxTensor> initializers;
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+
+    // 不是 initializer 时返回空指针
+    const OnnxTensor* initializer(const std::string& name) const {
+        for (const OnnxTensor& t : initializers) {
+            if (t.name == name) return &t;
+        }
+        return nullptr;
+    }
+
+    // 以 tensor 为第一个输入的节点；没有时返回空指针
+    const OnnxNode* consumer(const std::string& tensor) const {
+        for (const OnnxNode& n : nodes) {
+            if (!n.inputs.empty() && n.inputs[0] == tensor) return &n;
+        }
+        return nullptr;
+    }
+
+    // 输出 tensor 的节点；没有时返回空指针
+    const OnnxNode* producer(const std::string& tensor) const {
+        for (const OnnxNode& n : nodes) {
+            for (const std::string& out : n.outputs) {
+                if (out == tensor) return &n;
+            }
+        }
+        return nullptr;
+    }
+};
+
+namespace onnx_proto {
+
+// protobuf 的线格式：tag = (字段号 << 3) | 类型
+enum Wire { kVarint = 0, kFixed64 = 1, kBytes = 2, kFixed32 = 5 };
+
+struct Reader {
+    const uint8_t* p;
+    const uint8_t* end;
+
+    bool done() const { return p >= end; }
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) fail();
+            const uint8_t b = *p++;
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        fail();
+    }
+
+    uint32_t fixed32() {
+        if (end - p < 4) fail();
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        p += 4;
+        return v;
+    }
+
+    // 长度前缀的子消息 / 字符串 / packed 数组
+    Reader bytes() {
+        const uint64_t n = varint();
+        if (n > static_cast<uint64_t>(end - p)) fail();
+        Reader sub{p, p + n};
+        p += n;
+        return sub;
+    }
+
+    std::string string() {
+        Reader r = bytes();
+        return std::string(reinterpret_cast<const char*>(r.p), r.end - r.p);
+    }
+
+    void skip(uint32_t wire) {
+        switch (wire) {
+        case kVarint: varint(); break;
+        case kFixed64: if (end - p < 8) fail(); p += 8; break;
+        case kBytes: bytes(); break;
+        case kFixed32: fixed32(); break;
+        default: fail();
+        }
+    }
+
+    [[noreturn]] static void fail() { throw std::runtime_error("malformed ONNX model"); }
+};
+
+// repeated int64：packed 或逐个出现
+static inline void readInts(Reader& r, uint32_t wire, std::vector<int64_t>& out) {
+    if (wire == kBytes) {
+        Reader packed = r.bytes();
+        while (!packed.done()) out.push_back(static_cast<int64_t>(packed.varint()));
+    } else {
+        out.push_back(static_cast<int64_t>(r.varint()));
+    }
+}
+
+// repeated float：packed 或逐个出现
+static inline void readFloats(Reader& r, uint32_t wire, std::vector<float>& out) {
+    auto one = [&out](uint32_t bits) {
+        float f;
+        std::memcpy(&f, &bits, 4);
+        out.push_back(f);
+    };
+    if (wire == kBytes) {
+        Reader packed = r.bytes();
+        while (!packed.done()) one(packed.fixed32());
+    } else {
+        one(r.fixed32());
+    }
+}
+
+static inline OnnxTensor readTensor(Reader r) {
+    OnnxTensor t;
+    std::string raw;
+    bool has_raw = false;
+    while (!r.done()) {
+        const uint64_t tag = r.varint();
+        const uint32_t field = static_cast<uint32_t>(tag >> 3), wire = static_cast<uint32_t>(tag & 7);
+        if (field == 1) readInts(r, wire, t.dims);
+        else if (field == 2) t.data_type = static_cast<int32_t>(r.varint());
+        else if (field == 4) readFloats(r, wire, t.floats);
+        else if (field == 7) readInts(r, wire, t.ints);
+        else if (field == 8) t.name = r.string();
+        else if (field == 9) { raw = r.string(); has_raw = true; }
+        else if (field == 14) {
+            if (r.varint() != 0) throw std::runtime_error("ONNX tensors with external data are not supported");
+        }
+        else r.skip(wire);
+    }
+    // raw_data 为小端序的连续元素
+    if (has_raw) {
+        if (t.data_type == 1) {
+            t.floats.resize(raw.size() / sizeof(float));
+            std::memcpy(t.floats.data(), raw.data(), t.floats.size() * sizeof(float));
+        } else if (t.data_type == 7) {
+            t.ints.resize(raw.size() / sizeof(int64_t));
+            std::memcpy(t.ints.data(), raw.data(), t.ints.size() * sizeof(int64_t));
+        }
+    }
+    return t;
+}
+
+static inline OnnxAttribute readAttribute(Reader r) {
+    OnnxAttribute a;
+    while (!r.done()) {
+        const uint64_t tag = r.varint();
+        const uint32_t field = static_cast<uint32_t>(tag >> 3), wire = static_cast<uint32_t>(tag & 7);
+        if (field == 1) a.name = r.string();
+        else if (field == 2 && wire == kFixed32) { const uint32_t bits = r.fixed32(); std::memcpy(&a.f, &bits, 4); }
+        else if (field == 3) a.i = static_cast<int64_t>(r.varint());
+        else if (field == 4) a.s = r.string();
+        else if (field == 8) readInts(r, wire, a.ints);
+        else r.skip(wire);
+    }
+    return a;
+}
+
+static inline OnnxNode readNode(Reader r) {
+    OnnxNode n;
+    while (!r.done()) {
+        const uint64_t tag = r.varint();
+        const uint32_t field = static_cast<uint32_t>(tag >> 3), wire = static_cast<uint32_t>(tag & 7);
+        if (field == 1) n.inputs.push_back(r.string());
+        else if (field == 2) n.outputs.push_back(r.string());
+        else if (field == 4) n.op_type = r.string();
+        else if (field == 5) n.attributes.push_back(readAttribute(r.bytes()));
+        else r.skip(wire);
+    }
+    return n;
+}
+
+// ValueInfoProto 只取名称
+static inline std::string readValueName(Reader r) {
+    std::string name;
+    while (!r.done()) {
+        const uint64_t tag = r.varint();
+        if ((tag >> 3) == 1) name = r.string();
+        else r.skip(static_cast<uint32_t>(tag & 7));
+    }
+    return name;
+}
+
+}  // namespace onnx_proto
+
+// 解析 size 字节的 .onnx 模型；不是 protobuf 格式（如 ORT 格式的模型）或没有 graph 时抛出异常
+static inline OnnxGraph parseOnnxGraph(const void* data, size_t size) {
+    using namespace onnx_proto;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    Reader model{bytes, bytes + size};
+    OnnxGraph g;
+    bool has_graph = false;
+    while (!model.done()) {
+        const uint64_t tag = model.varint();
+        const uint32_t wire = static_cast<uint32_t>(tag & 7);
+        if ((tag >> 3) != 7 || wire != kBytes) {
+            model.skip(wire);
+            continue;
+        }
+        has_graph = true;
+        Reader graph = model.bytes();
+        while (!graph.done()) {
+            const uint64_t gtag = graph.varint();
+            const uint32_t field = static_cast<uint32_t>(gtag >> 3), gwire = static_cast<uint32_t>(gtag & 7);
+            if (field == 1) g.nodes.push_back(readNode(graph.bytes()));
+            else if (field == 5) g.initializers.push_back(readTensor(graph.bytes()));
+            else if (field == 11) g.inputs.push_back(readValueName(graph.bytes()));
+            else if (field == 12) g.outputs.push_back(readValueName(graph.bytes()));
+            else graph.skip(gwire);
+        }
+    }
+    if (!has_graph) {
+        throw std::runtime_error("not an ONNX model (no graph)");
+    }
+    return g;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//--------------------------------------------------------------------
+// 推理结果后处理：softmax + argmax（不分配内存，支持 n×Classes 批量输出）
+//--------------------------------------------------------------------
+
+// exp 的快速近似（Cephes expf 的多项式，相对误差约 1e-7）：
+// x = n*ln2 + r，e^x = 2^n * (1 + r + r^2 * P(r))
+namespace fast_exp {
+    constexpr float kMin = -87.0f;
+    constexpr float kMax = 88.0f;
+    constexpr float kLog2e = 1.44269504088896341f;
+    constexpr float kLn2Hi = 0.693359375f;
+    constexpr float kLn2Lo = -2.12194440e-4f;
+    constexpr float kP0 = 1.9875691500e-4f;
+    constexpr float kP1 = 1.3981999507e-3f;
+    constexpr float kP2 = 8.3334519073e-3f;
+    constexpr float kP3 = 4.1665795894e-2f;
+    constexpr float kP4 = 1.6666665459e-1f;
+    constexpr float kP5 = 5.0000001201e-1f;
+}
+
+static inline float fastExp(float x) {
+    using namespace fast_exp;
+    x = x < kMin ? kMin : (x > kMax ? kMax : x);
+
+    // n 取整用“加减魔数”舍入到最近整数（1.5 * 2^23）
+    const float magic = 12582912.0f;
+    float n = (x * kLog2e + magic) - magic;
+    float r = x - n * kLn2Hi - n * kLn2Lo;
+
+    float p = kP0;
+    p = p * r + kP1;
+    p = p * r + kP2;
+    p = p * r + kP3;
+    p = p * r + kP4;
+    p = p * r + kP5;
+    float y = p * r * r + r + 1.0f;
+
+    // 乘以 2^n：直接构造指数位
+    int32_t bits = (static_cast<int32_t>(n) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return y * scale;
+}
+
+// 对 data[0..count) 原地求 e^x
+using ExpInPlaceFn = void (*)(float* data, size_t count);
+
+static inline void expInPlaceScalar(float* data, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        data[i] = fastExp(data[i]);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static inline void expInPlaceAvx2(float* data, size_t count) {
+    using namespace fast_exp;
+    size_t i = 0;
+    // 每次 8 个
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(data + i);
+        x = _mm256_max_ps(_mm256_min_ps(x, _mm256_set1_ps(kMax)), _mm256_set1_ps(kMin));
+
+        __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(kLog2e)),
+                                   _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(kLn2Hi)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(kLn2Lo)));
+
+        __m256 p = _mm256_set1_ps(kP0);
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(kP1));
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(kP2));
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(kP3));
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(kP4));
+        p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(kP5));
+        __m256 y = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, r), r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+
+        __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+        _mm256_storeu_ps(data + i, _mm256_mul_ps(y, _mm256_castsi256_ps(bits)));
+    }
+    expInPlaceScalar(data + i, count - i);
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+static inline void expInPlaceNeon(float* data, size_t count) {
+    using namespace fast_exp;
+    size_t i = 0;
+    // 每次 4 个
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(data + i);
+        x = vmaxq_f32(vminq_f32(x, vdupq_n_f32(kMax)), vdupq_n_f32(kMin));
+
+        float32x4_t n = vrndnq_f32(vmulq_f32(x, vdupq_n_f32(kLog2e)));
+        float32x4_t r = vsubq_f32(x, vmulq_f32(n, vdupq_n_f32(kLn2Hi)));
+        r = vsubq_f32(r, vmulq_f32(n, vdupq_n_f32(kLn2Lo)));
+
+        float32x4_t p = vdupq_n_f32(kP0);
+        p = vaddq_f32(vmulq_f32(p, r), vdupq_n_f32(kP1));
+        p = vaddq_f32(vmulq_f32(p, r), vdupq_n_f32(kP2));
+        p = vaddq_f32(vmulq_f32(p, r), vdupq_n_f32(kP3));
+        p = vaddq_f32(vmulq_f32(p, r), vdupq_n_f32(kP4));
+        p = vaddq_f32(vmulq_f32(p, r), vdupq_n_f32(kP5));
+        float32x4_t y = vaddq_f32(vmulq_f32(vmulq_f32(p, r), r), vaddq_f32(r, vdupq_n_f32(1.0f)));
+
+        int32x4_t bits = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23);
+        vst1q_f32(data + i, vmulq_f32(y, vreinterpretq_f32_s32(bits)));
+    }
+    expInPlaceScalar(data + i, count - i);
+}
+#endif
+
+// 运行时选择可用的最快实现
+static inline ExpInPlaceFn selectExpInPlace() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+        return expInPlaceAvx2;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return expInPlaceNeon;
+#endif
+    return expInPlaceScalar;
+}
+
+// 对 n 行 logits（每行 Classes 个）逐行求 argmax，并在 probabilities 为 true 时
+// 原地替换成 softmax 概率。argmax 直接在 logits 上求（softmax 单调），
+// 与求最大值合为一趟；probabilities 为 false 时 logits 保持不变。
+// predicted 可为空
+template <int Classes>
+static inline void softmaxArgmax(float* logits, size_t n, int* predicted, bool probabilities = true) {
+    // 1) 每行的最大值与其下标：既用于数值稳定，也是预测结果
+    for (size_t i = 0; i < n; ++i) {
+        float* row = logits + i * Classes;
+        int best = 0;
+        float rowmax = row[0];
+        for (int c = 1; c < Classes; ++c) {
+            if (row[c] > rowmax) {
+                rowmax = row[c];
+                best = c;
+            }
+        }
+        if (predicted) {
+            predicted[i] = best;
+        }
+        if (probabilities) {
+            for (int c = 0; c < Classes; ++c) {
+                row[c] -= rowmax;
+            }
+        }
+    }
+    if (!probabilities) {
+        return;
+    }
+
+    // 2) 整块 n×Classes 一起求 e^x，跨行填满向量寄存器
+    static const ExpInPlaceFn expInPlace = selectExpInPlace();
+    expInPlace(logits, n * Classes);
+
+    // 3) 每行乘以总和的倒数
+    for (size_t i = 0; i < n; ++i) {
+        float* row = logits + i * Classes;
+        float sum = 0.0f;
+        for (int c = 0; c < Classes; ++c) {
+            sum += row[c];
+        }
+        const float inv = 1.0f / sum;
+        for (int c = 0; c < Classes; ++c) {
+            row[c] *= inv;
+        }
+    }
+}
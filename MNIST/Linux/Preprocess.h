@@ -0,0 +1,561 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//--------------------------------------------------------------------
+// 画布预处理：RGBA8888 或 8 位灰度画布 → 28×28 浮点张量
+//--------------------------------------------------------------------
+
+// 画布的像素格式
+enum class PixelFormat {
+    Rgba8888,  // SDL 纹理读回的 RGBA，白底黑字
+    Gray8,     // 单通道墨迹浓度：0 = 背景，255 = 笔迹（与 MNIST 一致，无需反相）
+};
+
+// SDL_PIXELFORMAT_RGBA8888 是按 32 位整数打包的格式（R 在最高字节），
+// 按 uint32 读出后再取通道，与字节序无关
+static inline uint32_t rgbaSum(uint32_t p) {
+    return (p >> 24) + ((p >> 16) & 0xff) + ((p >> 8) & 0xff);
+}
+
+// 把从 base 开始、行距为 stride 的 rows 行像素按列求 R+G+B 之和，写入 colsum[0..width)
+using SumColumnsFn = void (*)(const uint8_t* base, size_t stride, int rows, int width, uint32_t* colsum);
+
+static inline void sumColumnsScalar(const uint8_t* base, size_t stride, int rows, int width, uint32_t* colsum) {
+    std::fill(colsum, colsum + width, 0u);
+    for (int y = 0; y < rows; ++y, base += stride) {
+        for (int x = 0; x < width; ++x) {
+            uint32_t p;
+            std::memcpy(&p, base + x * 4, 4);
+            colsum[x] += rgbaSum(p);
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static inline void sumColumnsAvx2(const uint8_t* base, size_t stride, int rows, int width, uint32_t* colsum) {
+    // x86 为小端，RGBA8888 像素在内存中依次为 A,B,G,R：
+    // maddubs 以 (0,1,1,1) 加权得到 16 位的 B 与 G+R，madd 再合成 32 位的 R+G+B
+    const __m256i weights = _mm256_set1_epi32(0x01010100);
+    const __m256i ones = _mm256_set1_epi16(1);
+    int x = 0;
+    // 每次处理 32 列（4 组独立累加器，提高指令并行度），整列的累加留在寄存器里
+    for (; x + 32 <= width; x += 32) {
+        const uint8_t* p = base + x * 4;
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        __m256i acc2 = _mm256_setzero_si256();
+        __m256i acc3 = _mm256_setzero_si256();
+        for (int y = 0; y < rows; ++y, p += stride) {
+            const __m256i* v = reinterpret_cast<const __m256i*>(p);
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(v + 0), weights), ones));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(v + 1), weights), ones));
+            acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(v + 2), weights), ones));
+            acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(v + 3), weights), ones));
+        }
+        __m256i* out = reinterpret_cast<__m256i*>(colsum + x);
+        _mm256_storeu_si256(out + 0, acc0);
+        _mm256_storeu_si256(out + 1, acc1);
+        _mm256_storeu_si256(out + 2, acc2);
+        _mm256_storeu_si256(out + 3, acc3);
+    }
+    for (; x + 8 <= width; x += 8) {
+        const uint8_t* p = base + x * 4;
+        __m256i acc = _mm256_setzero_si256();
+        for (int y = 0; y < rows; ++y, p += stride) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(v, weights), ones));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(colsum + x), acc);
+    }
+    sumColumnsScalar(base + x * 4, stride, rows, width - x, colsum + x);
+}
+#elif defined(__ARM_NEON)
+static inline void sumColumnsNeon(const uint8_t* base, size_t stride, int rows, int width, uint32_t* colsum) {
+    const uint32x4_t mask = vdupq_n_u32(0xff);
+    int x = 0;
+    // 每次处理 4 列
+    for (; x + 4 <= width; x += 4) {
+        const uint8_t* q = base + x * 4;
+        uint32x4_t acc = vdupq_n_u32(0);
+        for (int y = 0; y < rows; ++y, q += stride) {
+            uint32x4_t p = vreinterpretq_u32_u8(vld1q_u8(q));
+            uint32x4_t r = vshrq_n_u32(p, 24);
+            uint32x4_t g = vandq_u32(vshrq_n_u32(p, 16), mask);
+            uint32x4_t b = vandq_u32(vshrq_n_u32(p, 8), mask);
+            acc = vaddq_u32(acc, vaddq_u32(vaddq_u32(r, g), b));
+        }
+        vst1q_u32(colsum + x, acc);
+    }
+    sumColumnsScalar(base + x * 4, stride, rows, width - x, colsum + x);
+}
+#endif
+
+// 灰度画布的按列求和：逐字节累加，-O3 下编译器即可自动向量化
+static inline void sumColumnsGray(const uint8_t* base, size_t stride, int rows, int width, uint32_t* colsum) {
+    std::fill(colsum, colsum + width, 0u);
+    for (int y = 0; y < rows; ++y, base += stride) {
+        for (int x = 0; x < width; ++x) {
+            colsum[x] += base[x];
+        }
+    }
+}
+
+// 运行时选择可用的最快实现（NEON 在 AArch64 上总是可用）
+static inline SumColumnsFn selectSumColumns() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+        return sumColumnsAvx2;
+    }
+#elif defined(__ARM_NEON)
+    return sumColumnsNeon;
+#endif
+    return sumColumnsScalar;
+}
+
+//--------------------------------------------------------------------
+// 张量元素类型：float32、float16 与 uint8。
+// uint8 输入对应模型里 scale = 1/255、zero point = 0 的量化，
+// 即像素值本身（mnist_batch_int8.onnx）
+//--------------------------------------------------------------------
+
+// IEEE 754 binary16 的位模式（与 Ort::Float16_t 布局相同）
+struct Half {
+    uint16_t bits;
+};
+
+// float → half，舍入到最近偶数；溢出为 inf，NaN 保持为 NaN
+static inline Half floatToHalf(float value) {
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    const uint32_t sign = (f >> 16) & 0x8000;
+    const uint32_t abs = f & 0x7fffffff;
+
+    uint16_t h;
+    if (abs >= 0x7f800000) {
+        h = static_cast<uint16_t>(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0));
+    } else if (abs >= 0x477ff000) {
+        // 舍入后超过 65504
+        h = static_cast<uint16_t>(sign | 0x7c00);
+    } else if (abs < 0x38800000) {
+        // 次正规数（含 0）：借 float 加法完成移位与舍入
+        float magic;
+        uint32_t m = 0x3f000000;  // 0.5f
+        std::memcpy(&magic, &m, sizeof(magic));
+        float a;
+        std::memcpy(&a, &abs, sizeof(a));
+        a += magic;
+        uint32_t r;
+        std::memcpy(&r, &a, sizeof(r));
+        h = static_cast<uint16_t>(sign | (r - m));
+    } else {
+        const uint32_t odd = (abs >> 13) & 1;
+        h = static_cast<uint16_t>(sign | ((abs + 0xc8000fff + odd) >> 13));
+    }
+    return Half{h};
+}
+
+// 把 count 个 float 转为 half
+using FloatToHalfFn = void (*)(const float* src, size_t count, Half* dst);
+
+static inline void floatToHalfScalar(const float* src, size_t count, Half* dst) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = floatToHalf(src[i]);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx,f16c")))
+static inline void floatToHalfF16c(const float* src, size_t count, Half* dst) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+    floatToHalfScalar(src + i, count - i, dst + i);
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+static inline void floatToHalfNeon(const float* src, size_t count, Half* dst) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float16x4_t h = vcvt_f16_f32(vld1q_f32(src + i));
+        vst1_u16(reinterpret_cast<uint16_t*>(dst + i), vreinterpret_u16_f16(h));
+    }
+    floatToHalfScalar(src + i, count - i, dst + i);
+}
+#endif
+
+static inline FloatToHalfFn selectFloatToHalf() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("f16c")) {
+        return floatToHalfF16c;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return floatToHalfNeon;
+#endif
+    return floatToHalfScalar;
+}
+
+// [0,1] 的 float → 模型输入的元素类型
+static inline void toTensorElements(const float* src, size_t count, float* dst) {
+    std::memcpy(dst, src, count * sizeof(float));
+}
+
+static inline void toTensorElements(const float* src, size_t count, uint8_t* dst) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = static_cast<uint8_t>(std::min(std::max(src[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+}
+
+static inline void toTensorElements(const float* src, size_t count, Half* dst) {
+    static const FloatToHalfFn convert = selectFloatToHalf();
+    convert(src, count, dst);
+}
+
+// u8 灰度（0 = 背景，255 = 笔迹，与 MNIST 数据一致）→ 模型输入的元素类型；
+// uint8 模型直接拷贝，不经过 float
+static inline void grayToTensor(const uint8_t* src, size_t count, uint8_t* dst) {
+    std::memcpy(dst, src, count);
+}
+
+static inline void grayToTensor(const uint8_t* src, size_t count, float* dst) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = src[i] * (1.0f / 255.0f);
+    }
+}
+
+static inline void grayToTensor(const uint8_t* src, size_t count, Half* dst) {
+    // 分块经栈上的 float 缓冲转换，便于 F16C 一次转 8 个
+    float tmp[256];
+    for (size_t i = 0; i < count; i += 256) {
+        const size_t n = std::min<size_t>(256, count - i);
+        grayToTensor(src + i, n, tmp);
+        toTensorElements(tmp, n, dst + i);
+    }
+}
+
+//--------------------------------------------------------------------
+// 画布上变化过的矩形区域 [x0, x1) × [y0, y1)，空矩形表示没有变化
+//--------------------------------------------------------------------
+struct DirtyRect {
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    static DirtyRect full(int width, int height) { return {0, 0, width, height}; }
+
+    bool empty() const { return x0 >= x1 || y0 >= y1; }
+    void clear() { *this = DirtyRect(); }
+
+    // 并入 [x0, x1) × [y0, y1)，裁剪到 width × height 的画布内
+    void add(int ax0, int ay0, int ax1, int ay1, int width, int height) {
+        ax0 = std::max(ax0, 0);
+        ay0 = std::max(ay0, 0);
+        ax1 = std::min(ax1, width);
+        ay1 = std::min(ay1, height);
+        if (ax0 >= ax1 || ay0 >= ay1) {
+            return;
+        }
+        if (empty()) {
+            *this = {ax0, ay0, ax1, ay1};
+        } else {
+            x0 = std::min(x0, ax0);
+            y0 = std::min(y0, ay0);
+            x1 = std::max(x1, ax1);
+            y1 = std::max(y1, ay1);
+        }
+    }
+};
+
+//--------------------------------------------------------------------
+// 面积平均（box filter）缩放：每个输出像素取它覆盖的源矩形内所有像素的均值，
+// 不再像最近邻那样只采一个点。边界表与中间缓冲只在画布尺寸变化时重新计算；
+// region() 只更新画布上变化过的区域覆盖到的输出像素
+//--------------------------------------------------------------------
+template <int OutW, int OutH>
+struct AreaResampler {
+    // pixels：width×height 的画布，RGBA8888（行距 width*4，白底黑字）或 Gray8（行距 width）；
+    // dst：OutW×OutH 的 T（float / Half / uint8）。笔迹为 1.0、背景为 0.0（uint8 为 255 / 0）
+    template <typename T>
+    void operator()(const uint8_t* pixels, int width, int height, T* dst,
+                    PixelFormat format = PixelFormat::Rgba8888) {
+        region(pixels, width, height, dst, DirtyRect::full(width, height), true, format);
+    }
+
+    // 最近邻缩放：源像素偏移查表，不做除法
+    template <typename T>
+    void nearest(const uint8_t* pixels, int width, int height, T* dst,
+                 PixelFormat format = PixelFormat::Rgba8888) {
+        region(pixels, width, height, dst, DirtyRect::full(width, height), false, format);
+    }
+
+    // 只重算与画布上 dirty 矩形相交的输出像素，dst 的其余部分保持不变
+    // （须是同一画布上一次转换的结果）。area 为 false 时按最近邻
+    template <typename T>
+    void region(const uint8_t* pixels, int width, int height, T* dst, const DirtyRect& dirty, bool area,
+                PixelFormat format = PixelFormat::Rgba8888) {
+        if (width != width_ || height != height_) {
+            resize(width, height);
+        }
+        int r0, r1, c0, c1;
+        if (!overlap(ys_, dirty.y0, dirty.y1, r0, r1) || !overlap(xs_, dirty.x0, dirty.x1, c0, c1)) {
+            return;
+        }
+        const bool gray = format == PixelFormat::Gray8;
+        for (int row = r0; row < r1; ++row) {
+            if (area) {
+                areaRow(pixels, row, c0, c1, dst, gray);
+            } else {
+                nearestRow(pixels, row, c0, c1, dst, gray);
+            }
+        }
+    }
+
+private:
+    // 第 row 行的 [c0, c1) 列
+    template <typename T>
+    void areaRow(const uint8_t* pixels, int row, int c0, int c1, T* dst, bool gray) {
+        static const SumColumnsFn sumColumns = selectSumColumns();
+        const int bpp = gray ? 1 : 4;
+        const size_t stride = static_cast<size_t>(width_) * bpp;
+        const int x0 = xs_[c0].first;
+        const int x1 = xs_[c1 - 1].second;
+
+        // 1) 纵向：该输出行覆盖的源行按列求和（SIMD），只求这些输出列覆盖的源列
+        (gray ? sumColumnsGray : sumColumns)(pixels + ys_[row].first * stride + x0 * bpp, stride,
+                                             ys_[row].second - ys_[row].first, x1 - x0, colsum_.data() + x0);
+        // 2) 横向：每个输出像素把自己覆盖的列再求和，一次乘法完成归一化
+        const float scale = 1.0f / (ys_[row].second - ys_[row].first);
+        float* out = rowOut(dst, row);
+        for (int col = c0; col < c1; ++col) {
+            uint32_t sum = 0;
+            for (int x = xs_[col].first; x < xs_[col].second; ++x) {
+                sum += colsum_[x];
+            }
+            // 灰度已是墨迹浓度；RGBA 是白底上的亮度，需要反相
+            out[col] = gray ? sum * inv_gray_cols_[col] * scale : 1.0f - sum * inv_cols_[col] * scale;
+        }
+        storeRow(out, dst, row, c0, c1);
+    }
+
+    template <typename T>
+    void nearestRow(const uint8_t* pixels, int row, int c0, int c1, T* dst, bool gray) {
+        float* out = rowOut(dst, row);
+        if (gray) {
+            const uint8_t* src = pixels + static_cast<size_t>(nearest_y_[row]) * width_;
+            for (int col = c0; col < c1; ++col) {
+                out[col] = src[nearest_x_[col]] * (1.0f / 255.0f);
+            }
+        } else {
+            const uint8_t* src = pixels + static_cast<size_t>(nearest_y_[row]) * width_ * 4;
+            for (int col = c0; col < c1; ++col) {
+                uint32_t p;
+                std::memcpy(&p, src + nearest_x_[col] * 4, 4);
+                out[col] = 1.0f - rgbaSum(p) * (1.0f / (3.0f * 255.0f));
+            }
+        }
+        storeRow(out, dst, row, c0, c1);
+    }
+
+    // float 输出直接写进 dst；其他类型先写一行 float，再转换 [c0, c1) 列
+    template <typename T>
+    float* rowOut(T* dst, int row) {
+        if constexpr (std::is_same<T, float>::value) {
+            return dst + row * OutW;
+        } else {
+            (void)dst;
+            (void)row;
+            return row_.data();
+        }
+    }
+
+    template <typename T>
+    static void storeRow(const float* out, T* dst, int row, int c0, int c1) {
+        if constexpr (!std::is_same<T, float>::value) {
+            toTensorElements(out + c0, c1 - c0, dst + row * OutW + c0);
+        } else {
+            (void)out;
+            (void)dst;
+            (void)row;
+            (void)c0;
+            (void)c1;
+        }
+    }
+
+    // 覆盖源区间 [lo, hi) 的输出段 [first, last)；没有相交时返回 false
+    template <size_t N>
+    static bool overlap(const std::array<std::pair<int, int>, N>& b, int lo, int hi, int& first, int& last) {
+        first = 0;
+        while (first < static_cast<int>(N) && b[first].second <= lo) ++first;
+        last = first;
+        while (last < static_cast<int>(N) && b[last].first < hi) ++last;
+        return first < last;
+    }
+
+    void resize(int width, int height) {
+        width_ = width;
+        height_ = height;
+        colsum_.assign(width, 0u);
+        bounds(width, xs_, nearest_x_);
+        bounds(height, ys_, nearest_y_);
+        for (int col = 0; col < OutW; ++col) {
+            // 3 个通道 × 255 × 覆盖的列数
+            inv_cols_[col] = 1.0f / (3.0f * 255.0f * (xs_[col].second - xs_[col].first));
+            inv_gray_cols_[col] = 1.0f / (255.0f * (xs_[col].second - xs_[col].first));
+        }
+    }
+
+    // 第 i 段覆盖源 [i*src/N, (i+1)*src/N)；源图比输出还小时每段至少取一个像素
+    template <size_t N>
+    static void bounds(int src, std::array<std::pair<int, int>, N>& b, std::array<int, N>& nearest) {
+        for (int i = 0; i < static_cast<int>(N); ++i) {
+            int first = std::min(i * src / static_cast<int>(N), src - 1);
+            int second = std::max((i + 1) * src / static_cast<int>(N), first + 1);
+            b[i] = {first, second};
+            nearest[i] = first;
+        }
+    }
+
+    int width_ = 0;
+    int height_ = 0;
+    std::array<std::pair<int, int>, OutW> xs_{};
+    std::array<std::pair<int, int>, OutH> ys_{};
+    std::array<int, OutW> nearest_x_{};
+    std::array<int, OutH> nearest_y_{};
+    std::array<float, OutW> inv_cols_{};
+    std::array<float, OutW> inv_gray_cols_{};
+    std::vector<uint32_t> colsum_;
+    std::array<float, OutW> row_{};
+};
+
+//--------------------------------------------------------------------
+// MNIST 式归一化：裁剪到笔迹的外接框，保持宽高比缩放进 Fit×Fit，
+// 再按质心放到 OutW×OutH 画面的中央（与 MNIST 训练数据的制作方式一致）。
+// 外接框与质心在一次逐行扫描中求出；缓冲只在画布宽度变化时重新分配
+//--------------------------------------------------------------------
+template <int OutW, int OutH, int Fit>
+struct CenteringResampler {
+    static_assert(Fit <= OutW && Fit <= OutH, "the fitted digit must fit in the output frame");
+
+    // 参数与 AreaResampler 相同；画布上没有笔迹时输出全 0
+    template <typename T>
+    void operator()(const uint8_t* pixels, int width, int height, T* dst,
+                    PixelFormat format = PixelFormat::Rgba8888) {
+        if (static_cast<int>(colsum_.size()) < width) {
+            colsum_.assign(width, 0u);
+        }
+        float* frame;
+        if constexpr (std::is_same<T, float>::value) {
+            frame = dst;
+        } else {
+            frame = frame_.data();
+        }
+        std::fill(frame, frame + OutW * OutH, 0.0f);
+
+        if (format == PixelFormat::Gray8) {
+            normalize<true>(pixels, width, height, frame);
+        } else {
+            normalize<false>(pixels, width, height, frame);
+        }
+        if constexpr (!std::is_same<T, float>::value) {
+            toTensorElements(frame_.data(), OutW * OutH, dst);
+        }
+    }
+
+private:
+    // 墨迹浓度，统一按 0..765（= 3 × 255）计：RGBA 为白底上 R+G+B 的反相
+    template <bool Gray>
+    static uint32_t ink(const uint8_t* row, int x) {
+        if constexpr (Gray) {
+            return row[x] * 3u;
+        } else {
+            uint32_t p;
+            std::memcpy(&p, row + x * 4, 4);
+            return 3u * 255u - rgbaSum(p);
+        }
+    }
+
+    template <bool Gray>
+    void normalize(const uint8_t* pixels, int width, int height, float* frame) {
+        const size_t stride = static_cast<size_t>(width) * (Gray ? 1 : 4);
+
+        // 1) 一次扫描：外接框 + 以墨迹浓度为权的质心
+        int min_x = width, max_x = -1, min_y = height, max_y = -1;
+        uint64_t mass = 0, moment_x = 0, moment_y = 0;
+        for (int y = 0; y < height; ++y) {
+            const uint8_t* row = pixels + y * stride;
+            uint64_t row_mass = 0, row_moment = 0;
+            for (int x = 0; x < width; ++x) {
+                const uint32_t v = ink<Gray>(row, x);
+                if (v) {
+                    min_x = std::min(min_x, x);
+                    max_x = std::max(max_x, x);
+                    row_mass += v;
+                    row_moment += static_cast<uint64_t>(v) * x;
+                }
+            }
+            if (row_mass) {
+                min_y = std::min(min_y, y);
+                max_y = y;
+                mass += row_mass;
+                moment_x += row_moment;
+                moment_y += row_mass * y;
+            }
+        }
+        if (!mass) {
+            return;
+        }
+
+        // 2) 长边缩放到 Fit，质心（像素中心在 +0.5 处）对准画面中心
+        const int box_w = max_x - min_x + 1;
+        const int box_h = max_y - min_y + 1;
+        const float scale = static_cast<float>(Fit) / std::max(box_w, box_h);
+        const int fit_w = std::min(Fit, std::max(1, static_cast<int>(box_w * scale + 0.5f)));
+        const int fit_h = std::min(Fit, std::max(1, static_cast<int>(box_h * scale + 0.5f)));
+        const float cx = (static_cast<float>(moment_x) / mass - min_x + 0.5f) * fit_w / box_w;
+        const float cy = (static_cast<float>(moment_y) / mass - min_y + 0.5f) * fit_h / box_h;
+        // 偏移取整（与 MNIST 一致），并保证整个数字留在画面内
+        const int off_x = std::min(std::max(static_cast<int>(std::lround(OutW * 0.5f - cx)), 0), OutW - fit_w);
+        const int off_y = std::min(std::max(static_cast<int>(std::lround(OutH * 0.5f - cy)), 0), OutH - fit_h);
+
+        // 3) 外接框面积平均缩放到 fit_w × fit_h：先按列累加该输出行覆盖的源行，再横向求和
+        const float inv_full = 1.0f / (3.0f * 255.0f);
+        for (int j = 0; j < fit_h; ++j) {
+            const int y0 = min_y + j * box_h / fit_h;
+            const int y1 = std::max(min_y + (j + 1) * box_h / fit_h, y0 + 1);
+            uint32_t* colsum = colsum_.data();
+            std::fill(colsum, colsum + box_w, 0u);
+            for (int y = y0; y < y1; ++y) {
+                const uint8_t* row = pixels + y * stride;
+                for (int x = 0; x < box_w; ++x) {
+                    colsum[x] += ink<Gray>(row, min_x + x);
+                }
+            }
+            float* out = frame + (off_y + j) * OutW + off_x;
+            for (int i = 0; i < fit_w; ++i) {
+                const int x0 = i * box_w / fit_w;
+                const int x1 = std::max((i + 1) * box_w / fit_w, x0 + 1);
+                uint32_t sum = 0;
+                for (int x = x0; x < x1; ++x) {
+                    sum += colsum[x];
+                }
+                out[i] = sum * inv_full / ((x1 - x0) * (y1 - y0));
+            }
+        }
+    }
+
+    std::vector<uint32_t> colsum_;
+    std::array<float, OutW * OutH> frame_{};
+};
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+//--------------------------------------------------------------------
+// 64 位哈希：xxHash64 的轮函数逐 8 字节吸收，末尾做一次雪崩混合。
+// 28×28 的 u8 图像只有 98 个字，远快于逐字节的 FNV
+//--------------------------------------------------------------------
+static inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0) {
+    constexpr uint64_t k1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t k2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t k3 = 0x165667B19E3779F9ull;
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t h = seed + k3 + size;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, sizeof(w));
+        h ^= rotl(w * k2, 31) * k1;
+        h = rotl(h, 27) * k1 + k3;
+    }
+    for (; size > 0; ++p, --size) {
+        h ^= *p * k3;
+        h = rotl(h, 11) * k1;
+    }
+    h ^= h >> 33;
+    h *= k2;
+    h ^= h >> 29;
+    h *= k3;
+    h ^= h >> 32;
+    return h;
+}
+
+//--------------------------------------------------------------------
+// 有界的 LRU 结果缓存，键为调用方算好的 64 位哈希（如量化输入的 hashBytes）。
+// 分成 2 的幂个分片，每片一把锁，并发查找基本落在不同的锁上；
+// 每片是定长数组里的双向链表加线性探测索引，插入与淘汰都不分配内存
+//--------------------------------------------------------------------
+template <typename Value>
+struct ResultCache {
+    // capacity 为总条目数，平均分给各分片；shards 向上取到 2 的幂
+    explicit ResultCache(size_t capacity, size_t shards = 16) {
+        if (capacity == 0) {
+            throw std::invalid_argument("result cache capacity must be positive");
+        }
+        size_t count = 1;
+        while (count < shards) {
+            count <<= 1;
+        }
+        shard_mask_ = count - 1;
+        const size_t per_shard = std::max<size_t>(1, (capacity + count - 1) / count);
+        shards_.reset(new Shard[count]);
+        for (size_t i = 0; i < count; ++i) {
+            shards_[i].init(per_shard);
+        }
+    }
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // 命中时写入 out 并把条目移到最近使用端
+    bool lookup(uint64_t key, Value& out) {
+        Shard& s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        const size_t slot = s.find(key);
+        if (s.table[slot] == kNone) {
+            s.misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        const uint32_t index = s.table[slot];
+        s.touch(index);
+        out = s.entries[index].value;
+        s.hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 插入或更新；分片已满时淘汰最久未用的条目
+    void insert(uint64_t key, const Value& value) {
+        Shard& s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        size_t slot = s.find(key);
+        if (s.table[slot] != kNone) {
+            s.entries[s.table[slot]].value = value;
+            s.touch(s.table[slot]);
+            return;
+        }
+        uint32_t index;
+        if (s.used < s.entries.size()) {
+            index = s.used++;
+        } else {
+            index = s.tail;
+            s.unlink(index);
+            s.erase(s.find(s.entries[index].key));
+            s.evictions.fetch_add(1, std::memory_order_relaxed);
+            // 删除时后面的条目可能前移，重新探测插入位置
+            slot = s.find(key);
+        }
+        s.entries[index].key = key;
+        s.entries[index].value = value;
+        s.table[slot] = index;
+        s.pushFront(index);
+    }
+
+    // 清空所有条目（计数保留）
+    void clear() {
+        for (size_t i = 0; i <= shard_mask_; ++i) {
+            Shard& s = shards_[i];
+            std::lock_guard<std::mutex> lock(s.mutex);
+            std::fill(s.table.begin(), s.table.end(), kNone);
+            s.used = 0;
+            s.head = s.tail = kNone;
+        }
+    }
+
+    uint64_t hits() const { return sum(&Shard::hits); }
+    uint64_t misses() const { return sum(&Shard::misses); }
+    uint64_t evictions() const { return sum(&Shard::evictions); }
+
+    size_t size() const {
+        size_t n = 0;
+        for (size_t i = 0; i <= shard_mask_; ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            n += shards_[i].used;
+        }
+        return n;
+    }
+
+    size_t capacity() const { return (shard_mask_ + 1) * shards_[0].entries.size(); }
+
+    double hitRate() const {
+        const uint64_t h = hits();
+        const uint64_t total = h + misses();
+        return total ? static_cast<double>(h) / total : 0.0;
+    }
+
+    // Prometheus 文本格式的命中/未命中/淘汰计数与条目数
+    void writePrometheus(std::ostream& out, const char* prefix = "mnist") const {
+        out << "# HELP " << prefix << "_cache_requests_total Result cache lookups by outcome.\n"
+            << "# TYPE " << prefix << "_cache_requests_total counter\n"
+            << prefix << "_cache_requests_total{result=\"hit\"} " << hits() << '\n'
+            << prefix << "_cache_requests_total{result=\"miss\"} " << misses() << '\n'
+            << "# HELP " << prefix << "_cache_evictions_total Entries evicted from the result cache.\n"
+            << "# TYPE " << prefix << "_cache_evictions_total counter\n"
+            << prefix << "_cache_evictions_total " << evictions() << '\n'
+            << "# HELP " << prefix << "_cache_entries Entries in the result cache.\n"
+            << "# TYPE " << prefix << "_cache_entries gauge\n"
+            << prefix << "_cache_entries " << size() << '\n';
+    }
+
+    void writeSummary(std::ostream& out) const {
+        out << "cache: hits=" << hits() << " misses=" << misses() << " hit_rate=" << hitRate() * 100 << "%"
+            << " evictions=" << evictions() << " entries=" << size() << '/' << capacity() << '\n';
+        out.flush();
+    }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Entry {
+        uint64_t key = 0;
+        Value value{};
+        uint32_t prev = kNone;
+        uint32_t next = kNone;
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        // entries[0, used) 为有效条目，按 head（最近使用）→ tail 串成链表
+        std::vector<Entry> entries;
+        // 线性探测索引：存 entries 的下标，kNone 为空位；大小为 2 的幂且不小于 2 × 容量
+        std::vector<uint32_t> table;
+        size_t table_mask = 0;
+        uint32_t used = 0;
+        uint32_t head = kNone;
+        uint32_t tail = kNone;
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+
+        void init(size_t capacity) {
+            entries.resize(capacity);
+            size_t n = 2;
+            while (n < capacity * 2) {
+                n <<= 1;
+            }
+            table.assign(n, kNone);
+            table_mask = n - 1;
+        }
+
+        // key 所在的槽位，或它应插入的空槽位
+        size_t find(uint64_t key) const {
+            size_t slot = key & table_mask;
+            while (table[slot] != kNone && entries[table[slot]].key != key) {
+                slot = (slot + 1) & table_mask;
+            }
+            return slot;
+        }
+
+        // 线性探测的向后移位删除：把后面“本该更靠前”的条目挪进空位，不留墓碑
+        void erase(size_t slot) {
+            size_t hole = slot;
+            size_t next = slot;
+            for (;;) {
+                table[hole] = kNone;
+                for (;;) {
+                    next = (next + 1) & table_mask;
+                    if (table[next] == kNone) {
+                        return;
+                    }
+                    const size_t home = entries[table[next]].key & table_mask;
+                    // home 循环地落在 (hole, next] 之内时，该条目留在原处仍能被找到
+                    const bool stays = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+                    if (!stays) {
+                        break;
+                    }
+                }
+                table[hole] = table[next];
+                hole = next;
+            }
+        }
+
+        void unlink(uint32_t index) {
+            Entry& e = entries[index];
+            if (e.prev != kNone) entries[e.prev].next = e.next; else head = e.next;
+            if (e.next != kNone) entries[e.next].prev = e.prev; else tail = e.prev;
+            e.prev = e.next = kNone;
+        }
+
+        void pushFront(uint32_t index) {
+            Entry& e = entries[index];
+            e.prev = kNone;
+            e.next = head;
+            if (head != kNone) entries[head].prev = index;
+            head = index;
+            if (tail == kNone) tail = index;
+        }
+
+        void touch(uint32_t index) {
+            if (head != index) {
+                unlink(index);
+                pushFront(index);
+            }
+        }
+    };
+
+    // 低位用于分片内的索引，分片取高位
+    Shard& shard(uint64_t key) { return shards_[(key >> 40) & shard_mask_]; }
+
+    uint64_t sum(std::atomic<uint64_t> Shard::*counter) const {
+        uint64_t n = 0;
+        for (size_t i = 0; i <= shard_mask_; ++i) {
+            n += (shards_[i].*counter).load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+    size_t shard_mask_ = 0;
+    std::unique_ptr<Shard[]> shards_;
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#include "Preprocess.h"
+
+//--------------------------------------------------------------------
+// 多位数字切分：一次逐行扫描做 8 邻域连通域标记（并查集合并等价标号），
+// 同时累计每个标号的外接框与墨迹量；丢弃噪点，把横向大幅重叠的连通域
+// （如分两笔写成的 4、5）并成一个数字，再按从左到右排序。
+// 每个数字只取属于它的像素裁剪出来，按 MNIST 方式缩放、居中为 28×28
+//--------------------------------------------------------------------
+struct DigitSegment {
+    // 画布上的外接框
+    DirtyRect box;
+    // 墨迹总量（每像素 0..255 之和）
+    uint64_t mass = 0;
+};
+
+struct DigitSegmenter {
+    // 低于该浓度的像素视为背景，抗锯齿的淡边不会把相邻的数字连起来
+    uint8_t ink_threshold = 64;
+    // 墨迹量不足这么多个满浓度像素的数字视为噪点丢弃
+    uint32_t min_pixels = 16;
+    // 横向重叠超过较窄者宽度这一比例的连通域并为同一个数字
+    float merge_overlap = 0.5f;
+
+    // 切分 width×height 的画布（格式同 AreaResampler），返回找到的数字个数
+    size_t segment(const uint8_t* pixels, int width, int height, PixelFormat format = PixelFormat::Rgba8888) {
+        width_ = width;
+        height_ = height;
+        const size_t count = static_cast<size_t>(width) * height;
+        const uint8_t* gray = pixels;
+        if (format != PixelFormat::Gray8) {
+            // RGBA 白底黑字 → 墨迹浓度
+            gray_.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                uint32_t p;
+                std::memcpy(&p, pixels + i * 4, 4);
+                gray_[i] = static_cast<uint8_t>(255u - rgbaSum(p) / 3u);
+            }
+            gray = gray_.data();
+        }
+        gray_pixels_ = gray;
+
+        label(gray);
+        group();
+        return segments_.size();
+    }
+
+    // 从左到右的数字
+    const std::vector<DigitSegment>& segments() const { return segments_; }
+
+    // 把第 i 个数字写成 28×28 的模型输入（T 为 float / Half / uint8_t）；
+    // 外接框内属于其他数字的笔迹不会带进来。须在同一画布的 segment() 之后、画布不变时调用
+    template <typename T>
+    void normalize(size_t i, T* dst) {
+        const DirtyRect& box = segments_[i].box;
+        const int box_w = box.x1 - box.x0;
+        const int box_h = box.y1 - box.y0;
+        crop_.assign(static_cast<size_t>(box_w) * box_h, 0);
+        for (int y = box.y0; y < box.y1; ++y) {
+            const size_t row = static_cast<size_t>(y) * width_;
+            uint8_t* out = crop_.data() + static_cast<size_t>(y - box.y0) * box_w;
+            for (int x = box.x0; x < box.x1; ++x) {
+                const uint32_t l = labels_[row + x];
+                if (l && digit_of_[l] == static_cast<int32_t>(i)) {
+                    out[x - box.x0] = gray_pixels_[row + x];
+                }
+            }
+        }
+        centering_(crop_.data(), box_w, box_h, dst, PixelFormat::Gray8);
+    }
+
+private:
+    struct Component {
+        DirtyRect box;
+        uint64_t mass = 0;
+    };
+
+    uint32_t find(uint32_t l) {
+        while (parent_[l] != l) {
+            parent_[l] = parent_[parent_[l]];
+            l = parent_[l];
+        }
+        return l;
+    }
+
+    // 较小的标号作根，保证根总是最早出现（最靠上）的那个
+    uint32_t unite(uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a > b) std::swap(a, b);
+        parent_[b] = a;
+        return a;
+    }
+
+    // 逐行扫描：每个前景像素取左、左上、上、右上四个已标号邻居中的根，必要时合并等价标号
+    void label(const uint8_t* gray) {
+        labels_.assign(static_cast<size_t>(width_) * height_, 0u);
+        parent_.assign(1, 0u);
+        stats_.assign(1, Component());
+        for (int y = 0; y < height_; ++y) {
+            const uint8_t* row = gray + static_cast<size_t>(y) * width_;
+            uint32_t* cur = labels_.data() + static_cast<size_t>(y) * width_;
+            const uint32_t* prev = y ? cur - width_ : nullptr;
+            for (int x = 0; x < width_; ++x) {
+                if (row[x] < ink_threshold) {
+                    continue;
+                }
+                uint32_t l = 0;
+                auto join = [&](uint32_t n) {
+                    if (n) l = l ? unite(l, n) : find(n);
+                };
+                if (x) join(cur[x - 1]);
+                if (prev) {
+                    if (x) join(prev[x - 1]);
+                    join(prev[x]);
+                    if (x + 1 < width_) join(prev[x + 1]);
+                }
+                if (!l) {
+                    l = static_cast<uint32_t>(parent_.size());
+                    parent_.push_back(l);
+                    stats_.emplace_back();
+                }
+                cur[x] = l;
+                // 统计先记在像素自己的标号上，合并完成后再汇总到根
+                Component& c = stats_[l];
+                c.box.add(x, y, x + 1, y + 1, width_, height_);
+                c.mass += row[x];
+            }
+        }
+    }
+
+    // 汇总到根、去噪、按横向重叠合并，得到从左到右的数字，并为每个标号记下所属的数字
+    void group() {
+        const size_t labels = parent_.size();
+        for (uint32_t l = 1; l < labels; ++l) {
+            const uint32_t r = find(l);
+            if (r != l) {
+                Component& root = stats_[r];
+                const Component& c = stats_[l];
+                root.box.add(c.box.x0, c.box.y0, c.box.x1, c.box.y1, width_, height_);
+                root.mass += c.mass;
+            }
+        }
+
+        std::vector<uint32_t> roots;
+        for (uint32_t l = 1; l < labels; ++l) {
+            if (parent_[l] == l) {
+                roots.push_back(l);
+            }
+        }
+        std::sort(roots.begin(), roots.end(), [this](uint32_t a, uint32_t b) {
+            return stats_[a].box.x0 < stats_[b].box.x0;
+        });
+
+        // 根标号 → 数字序号，-1 = 噪点
+        segments_.clear();
+        digit_of_.assign(labels, -1);
+        root_digit_.assign(labels, -1);
+        for (uint32_t r : roots) {
+            const DirtyRect& box = stats_[r].box;
+            int32_t target = -1;
+            for (size_t d = 0; d < segments_.size(); ++d) {
+                const DirtyRect& other = segments_[d].box;
+                const int overlap = std::min(box.x1, other.x1) - std::max(box.x0, other.x0);
+                const int narrower = std::min(box.x1 - box.x0, other.x1 - other.x0);
+                if (overlap > 0 && overlap >= merge_overlap * narrower) {
+                    target = static_cast<int32_t>(d);
+                    break;
+                }
+            }
+            if (target < 0) {
+                target = static_cast<int32_t>(segments_.size());
+                segments_.emplace_back();
+            }
+            DigitSegment& s = segments_[target];
+            s.box.add(box.x0, box.y0, box.x1, box.y1, width_, height_);
+            s.mass += stats_[r].mass;
+            digit_of_[r] = target;
+        }
+
+        // 丢弃噪点并重新编号。数字按左边界递增的顺序建立，合并进来的连通域左边界不会更小，
+        // 所以 segments_ 已是从左到右的顺序
+        std::vector<int32_t> renumber(segments_.size(), -1);
+        size_t kept = 0;
+        for (size_t d = 0; d < segments_.size(); ++d) {
+            if (segments_[d].mass >= static_cast<uint64_t>(min_pixels) * 255u) {
+                renumber[d] = static_cast<int32_t>(kept);
+                segments_[kept++] = segments_[d];
+            }
+        }
+        segments_.resize(kept);
+
+        // 根的数字序号先取出来，再写回每个标号
+        for (uint32_t l = 1; l < labels; ++l) {
+            const int32_t d = digit_of_[find(l)];
+            root_digit_[l] = d < 0 ? -1 : renumber[d];
+        }
+        digit_of_.swap(root_digit_);
+    }
+
+    int width_ = 0;
+    int height_ = 0;
+    // 像素的临时标号（0 = 背景）与并查集
+    std::vector<uint32_t> labels_;
+    std::vector<uint32_t> parent_;
+    // 每个标号的外接框与墨迹量
+    std::vector<Component> stats_;
+    // 标号 → 数字序号（-1 = 噪点）
+    std::vector<int32_t> digit_of_;
+    std::vector<int32_t> root_digit_;
+    std::vector<DigitSegment> segments_;
+    // RGBA 画布换算出的灰度，以及当前画布的灰度视图
+    std::vector<uint8_t> gray_;
+    const uint8_t* gray_pixels_ = nullptr;
+    std::vector<uint8_t> crop_;
+    CenteringResampler<28, 28, 20> centering_;
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cstdlib>
+
+#include <onnxruntime_cxx_api.h>
+
+struct TensorArena;
+
+//--------------------------------------------------------------------
+// 会话配置：图优化级别、线程、执行模式、内存选项与执行提供者（EP）
+//--------------------------------------------------------------------
+struct SessionConfig {
+    GraphOptimizationLevel optimization_level = ORT_ENABLE_ALL;
+    // 非空时把优化后的模型保存到该路径
+    std::string optimized_model_path;
+
+    // 0 = ORT 默认
+    int intra_op_threads = 0;
+    int inter_op_threads = 0;
+    // 使用 Env 的全局线程池（DisablePerSessionThreads），此时忽略上面两项；
+    // 须配合以 ThreadingOptions 创建的 Env（见 ModelRegistry.h 的 sharedEnv）
+    bool global_threads = false;
+    // ORT_PARALLEL 时各算子可借助 inter-op 线程池并行执行
+    ExecutionMode execution_mode = ORT_SEQUENTIAL;
+
+    bool mem_pattern = true;
+    bool cpu_arena = true;
+
+    // 按优先顺序尝试的执行提供者："cuda" / "tensorrt" / "openvino" / "xnnpack"。
+    // 未编入当前 ORT 或注册失败的会跳过；未被接手的算子总是回落到 CPU
+    std::vector<std::string> providers;
+    int device_id = 0;
+    // 非空时 CUDA / TensorRT 在这个 cudaStream_t 上执行，调用方可在同一条流上排布拷贝与事件（见 GpuPipeline.h）
+    void* cuda_stream = nullptr;
+
+    // 映射模型文件后从内存创建会话（ORT 格式的模型/缓存由会话直接引用映射的页，见 ModelCache.h）
+    bool mmap_model = false;
+
+    // 非空时开启 ORT 自带的性能分析，会话结束时写出 chrome-trace JSON（<profile_prefix>_<时间>.json，
+    // 可用 chrome://tracing 或 Perfetto 打开），见 OnnxModel::endProfiling
+    std::string profile_prefix;
+
+    // 非空时会话的张量内存取自这个预分配、有上限的缓冲池（见 OnnxModel.h 的 TensorArena），
+    // 不再使用 ORT 自己的 CPU arena。arena 须比会话活得久
+    TensorArena* arena = nullptr;
+
+    // 由 MNISTModel 用内置的融合 CNN 内核（NativeCnn.h）代替会话推理；
+    // 只支持与 mnist.onnx 结构相同的 float32 模型，加载时与 ORT 的输出核对
+    bool native = false;
+
+    // 非空时启用启动缓存目录：CPU 下缓存优化后的 ORT 格式模型（见 ModelCache.h），
+    // TensorRT / OpenVINO 下存放各自编译好的引擎
+    std::string cache_dir;
+};
+
+// 执行提供者的简称 → ORT 内部名称（GetAvailableProviders 的返回值）
+static inline const char* providerName(const std::string& ep) {
+    if (ep == "cuda") return "CUDAExecutionProvider";
+    if (ep == "tensorrt") return "TensorrtExecutionProvider";
+    if (ep == "openvino") return "OpenVINOExecutionProvider";
+    if (ep == "xnnpack") return "XnnpackExecutionProvider";
+    return nullptr;
+}
+
+static inline void appendProvider(Ort::SessionOptions& options, const std::string& ep, const SessionConfig& config) {
+    const OrtApi& api = Ort::GetApi();
+    const std::string device = std::to_string(config.device_id);
+
+    if (ep == "cuda") {
+        OrtCUDAProviderOptionsV2* cuda = nullptr;
+        Ort::ThrowOnError(api.CreateCUDAProviderOptions(&cuda));
+        std::unique_ptr<OrtCUDAProviderOptionsV2, void (*)(OrtCUDAProviderOptionsV2*)> guard(cuda, api.ReleaseCUDAProviderOptions);
+        const char* keys[] = {"device_id"};
+        const char* values[] = {device.c_str()};
+        Ort::ThrowOnError(api.UpdateCUDAProviderOptions(cuda, keys, values, 1));
+        if (config.cuda_stream) {
+            Ort::ThrowOnError(api.UpdateCUDAProviderOptionsWithValue(cuda, "user_compute_stream", config.cuda_stream));
+        }
+        options.AppendExecutionProvider_CUDA_V2(*cuda);
+    } else if (ep == "tensorrt") {
+        OrtTensorRTProviderOptionsV2* trt = nullptr;
+        Ort::ThrowOnError(api.CreateTensorRTProviderOptions(&trt));
+        std::unique_ptr<OrtTensorRTProviderOptionsV2, void (*)(OrtTensorRTProviderOptionsV2*)> guard(trt, api.ReleaseTensorRTProviderOptions);
+        // 开启引擎缓存后，再次启动直接反序列化已构建的 TensorRT 引擎
+        const char* keys[] = {"device_id", "trt_engine_cache_enable", "trt_engine_cache_path"};
+        const char* values[] = {device.c_str(), config.cache_dir.empty() ? "0" : "1", config.cache_dir.c_str()};
+        Ort::ThrowOnError(api.UpdateTensorRTProviderOptions(trt, keys, values, config.cache_dir.empty() ? 1 : 3));
+        if (config.cuda_stream) {
+            Ort::ThrowOnError(api.UpdateTensorRTProviderOptionsWithValue(trt, "user_compute_stream", config.cuda_stream));
+        }
+        options.AppendExecutionProvider_TensorRT_V2(*trt);
+    } else if (ep == "openvino") {
+        OrtOpenVINOProviderOptions openvino;
+        if (!config.cache_dir.empty()) {
+            openvino.cache_dir = config.cache_dir.c_str();
+        }
+        options.AppendExecutionProvider_OpenVINO(openvino);
+    } else if (ep == "xnnpack") {
+        std::unordered_map<std::string, std::string> xnnpack;
+        if (config.intra_op_threads > 0) {
+            xnnpack["intra_op_num_threads"] = std::to_string(config.intra_op_threads);
+        }
+        options.AppendExecutionProvider("XNNPACK", xnnpack);
+    }
+}
+
+// 按 config 填写 SessionOptions
+static inline void applySessionConfig(Ort::SessionOptions& options, const SessionConfig& config) {
+    options.SetGraphOptimizationLevel(config.optimization_level);
+    if (!config.optimized_model_path.empty()) {
+        options.SetOptimizedModelFilePath(config.optimized_model_path.c_str());
+    }
+    if (config.global_threads) {
+        options.DisablePerSessionThreads();
+    } else {
+        if (config.intra_op_threads > 0) {
+            options.SetIntraOpNumThreads(config.intra_op_threads);
+        }
+        if (config.inter_op_threads > 0) {
+            options.SetInterOpNumThreads(config.inter_op_threads);
+        }
+    }
+    options.SetExecutionMode(config.execution_mode);
+    if (!config.mem_pattern) {
+        options.DisableMemPattern();
+    }
+    if (!config.cpu_arena) {
+        options.DisableCpuMemArena();
+    }
+    if (!config.profile_prefix.empty()) {
+        options.EnableProfiling(config.profile_prefix.c_str());
+    }
+    if (config.arena) {
+        options.AddConfigEntry("session.use_env_allocators", "1");
+    }
+
+    const std::vector<std::string> available = Ort::GetAvailableProviders();
+    for (const std::string& ep : config.providers) {
+        const char* name = providerName(ep);
+        if (!name) {
+            std::cerr << "Unknown execution provider '" << ep << "', ignored" << std::endl;
+            continue;
+        }
+        if (std::find(available.begin(), available.end(), name) == available.end()) {
+            std::cerr << name << " is not available in this ONNX Runtime build, skipped" << std::endl;
+            continue;
+        }
+        try {
+            appendProvider(options, ep, config);
+        } catch (const Ort::Exception& e) {
+            std::cerr << "Failed to register " << name << " (" << e.what() << "), skipped" << std::endl;
+        }
+    }
+}
+
+//--------------------------------------------------------------------
+// 各程序共用的会话命令行参数
+//--------------------------------------------------------------------
+static inline const char* sessionFlagsUsage() {
+    return "  --opt-level <disable|basic|extended|all>  graph optimization level (default: all)\n"
+           "  --save-optimized <path>  write the optimized model to <path>\n"
+           "  --intra-op <n>   intra-op threads (default: ORT)\n"
+           "  --inter-op <n>   inter-op threads (default: ORT)\n"
+           "  --parallel       parallel execution mode instead of sequential\n"
+           "  --no-mem-pattern disable memory pattern planning\n"
+           "  --no-arena       disable the CPU memory arena\n"
+           "  --ep <list>      comma-separated providers to try in order: cuda,tensorrt,openvino,xnnpack\n"
+           "  --device <id>    GPU device id for cuda/tensorrt (default: 0)\n"
+           "  --cache-dir <dir> cache optimized models / compiled engines here for faster startup\n"
+           "  --mmap           memory-map the model (ORT-format models and caches share pages across processes)\n"
+           "  --profile <prefix> write an ORT chrome-trace profile to <prefix>_<time>.json\n"
+           "  --native         run the fp32 CNN on built-in fused kernels instead of ORT (checked against ORT at load)\n";
+}
+
+// 识别 argv[i] 处的会话参数：识别成功时返回 true，并把 i 移到最后一个被消费的参数
+static inline bool parseSessionFlag(int argc, char* argv[], int& i, SessionConfig& config) {
+    const char* arg = argv[i];
+    const bool has_value = i + 1 < argc;
+
+    if (!std::strcmp(arg, "--opt-level") && has_value) {
+        const char* level = argv[++i];
+        if (!std::strcmp(level, "disable")) config.optimization_level = ORT_DISABLE_ALL;
+        else if (!std::strcmp(level, "basic")) config.optimization_level = ORT_ENABLE_BASIC;
+        else if (!std::strcmp(level, "extended")) config.optimization_level = ORT_ENABLE_EXTENDED;
+        else if (!std::strcmp(level, "all")) config.optimization_level = ORT_ENABLE_ALL;
+        else return false;
+    } else if (!std::strcmp(arg, "--save-optimized") && has_value) {
+        config.optimized_model_path = argv[++i];
+    } else if (!std::strcmp(arg, "--intra-op") && has_value) {
+        config.intra_op_threads = std::atoi(argv[++i]);
+    } else if (!std::strcmp(arg, "--inter-op") && has_value) {
+        config.inter_op_threads = std::atoi(argv[++i]);
+    } else if (!std::strcmp(arg, "--parallel")) {
+        config.execution_mode = ORT_PARALLEL;
+    } else if (!std::strcmp(arg, "--no-mem-pattern")) {
+        config.mem_pattern = false;
+    } else if (!std::strcmp(arg, "--no-arena")) {
+        config.cpu_arena = false;
+    } else if (!std::strcmp(arg, "--ep") && has_value) {
+        config.providers.clear();
+        std::string list = argv[++i];
+        size_t start = 0;
+        while (start <= list.size()) {
+            size_t comma = list.find(',', start);
+            if (comma == std::string::npos) comma = list.size();
+            if (comma > start) config.providers.push_back(list.substr(start, comma - start));
+            start = comma + 1;
+        }
+    } else if (!std::strcmp(arg, "--device") && has_value) {
+        config.device_id = std::atoi(argv[++i]);
+    } else if (!std::strcmp(arg, "--cache-dir") && has_value) {
+        config.cache_dir = argv[++i];
+    } else if (!std::strcmp(arg, "--mmap")) {
+        config.mmap_model = true;
+    } else if (!std::strcmp(arg, "--profile") && has_value) {
+        config.profile_prefix = argv[++i];
+    } else if (!std::strcmp(arg, "--native")) {
+        config.native = true;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,327 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/file.h>
+
+#include "ShmTransport.h"
+
+struct ShmServerOptions {
+    // shm_open 的名称（以 / 开头）
+    std::string name = "/mnist";
+    // 最多同时连接的客户端数
+    uint32_t lanes = 64;
+    // 每个客户端最多在途的请求数，必须是 2 的幂
+    uint32_t depth = 32;
+};
+
+//--------------------------------------------------------------------
+// 共享内存通道的服务端（协议见 ShmTransport.h）：一个分派线程把各通道中新提交的槽位
+// 原地交给 InferencePool（TrySubmitInPlace，图像不经拷贝即由工作线程取入批缓冲区），
+// 工作线程在 complete() / fail() 里把结果写回槽位。
+// Pool 只需提供 Completion 回调接口（其 Result 带 digit 与 probabilities）与 TrySubmitInPlace，
+// 测试里换成桩实现即可脱离 ORT 运行；服务程序用的是 ShmServer = BasicShmServer<InferencePool>。
+// 线程池满时槽位留在通道里，等下一轮再交；所有通道都空闲时分派线程在门铃上睡眠。
+// 区域上持有 flock，同一名称同时只能有一个服务端；析构时不删除区域，供重启后的服务端接着用。
+// 须先于 pool 析构
+//--------------------------------------------------------------------
+template <typename Pool>
+struct BasicShmServer : Pool::Completion {
+    using Options = ShmServerOptions;
+    using Result = typename Pool::Completion::Result;
+
+    static_assert(std::tuple_size<decltype(Result::probabilities)>::value == kShmClasses,
+                  "shared-memory slots hold one score per MNIST class");
+
+    BasicShmServer(Pool& pool, Options options = {}) : pool_(pool), options_(std::move(options)) {
+        if (options_.lanes == 0 || options_.depth < 2 || (options_.depth & (options_.depth - 1)) != 0) {
+            throw std::invalid_argument("shared-memory lanes must be positive and depth a power of two");
+        }
+        open();
+        inflight_.reset(new std::atomic<uint32_t>[options_.lanes]());
+        recover();
+        region_.header().server_pid.store(static_cast<int32_t>(::getpid()), std::memory_order_release);
+        dispatcher_ = std::thread([this] { dispatchLoop(); });
+    }
+
+    // 停止接收新请求，等已交给线程池的请求写回后解除映射
+    ~BasicShmServer() {
+        shm::Header& h = region_.header();
+        stop_.store(true, std::memory_order_seq_cst);
+        h.doorbell.fetch_add(1, std::memory_order_seq_cst);
+        shm::futexWake(h.doorbell);
+        dispatcher_.join();
+        while (inflight_total_.load(std::memory_order_acquire) > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        h.server_pid.store(0, std::memory_order_release);
+        region_.unmap();
+        ::close(fd_);
+    }
+
+    BasicShmServer(const BasicShmServer&) = delete;
+    BasicShmServer& operator=(const BasicShmServer&) = delete;
+
+    const Options& options() const { return options_; }
+
+    // 已认领通道的客户端数
+    size_t clients() const {
+        size_t n = 0;
+        for (uint32_t i = 0; i < options_.lanes; ++i) {
+            n += region_.lane(i).owner.load(std::memory_order_relaxed) != 0;
+        }
+        return n;
+    }
+
+    // 经共享内存作答的图像数
+    uint64_t served() const { return served_.load(std::memory_order_relaxed); }
+
+    void complete(uint64_t tag, const Result& p) override {
+        shm::Slot& slot = slotOf(tag);
+        slot.digit = p.digit;
+        std::memcpy(slot.probabilities, p.probabilities.data(), sizeof(slot.probabilities));
+        publish(tag, slot, shm::kDone);
+    }
+
+    void fail(uint64_t tag, std::exception_ptr error) override {
+        shm::Slot& slot = slotOf(tag);
+        std::string message = "unknown error";
+        try {
+            std::rethrow_exception(error);
+        } catch (const std::exception& e) {
+            message = e.what();
+        } catch (...) {
+        }
+        const size_t n = std::min(message.size(), sizeof(slot.error) - 1);
+        std::memcpy(slot.error, message.data(), n);
+        slot.error[n] = '\0';
+        publish(tag, slot, shm::kFailed);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Dispatch { kIdle, kProgress, kBlocked };
+
+    // 创建区域，或复用上一个服务端留下的同布局区域；布局不同时弃用旧区域并重建
+    void open() {
+        const size_t size = shm::regionBytes(options_.lanes, options_.depth);
+        for (int attempt = 0;; ++attempt) {
+            fd_ = ::shm_open(options_.name.c_str(), O_RDWR | O_CREAT, 0600);
+            if (fd_ < 0) {
+                throw std::runtime_error("cannot open shared memory " + options_.name + ": " + std::strerror(errno));
+            }
+            if (::flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+                ::close(fd_);
+                throw std::runtime_error("another server is already serving " + options_.name);
+            }
+            struct stat st{};
+            if (::fstat(fd_, &st) != 0) {
+                failOpen("cannot stat shared memory ");
+            }
+            const size_t existing = static_cast<size_t>(st.st_size);
+            if (existing == 0 && ::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+                failOpen("cannot size shared memory ");
+            }
+            region_.map(fd_, existing ? existing : size, options_.name);
+
+            shm::Header& h = region_.header();
+            const bool initialised = existing != 0 && existing >= shm::headerBytes() &&
+                                     h.magic.load(std::memory_order_acquire) == kShmMagic;
+            if (!initialised) {
+                // 新区域，或上一个服务端在初始化完成前退出（此时不可能有客户端连上）
+                if (existing != size) {
+                    region_.unmap();
+                    if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+                        failOpen("cannot size shared memory ");
+                    }
+                    region_.map(fd_, size, options_.name);
+                }
+                std::memset(region_.base, 0, size);
+                shm::Header& fresh = region_.header();
+                fresh.version = kShmVersion;
+                fresh.lanes = options_.lanes;
+                fresh.depth = options_.depth;
+                fresh.size = size;
+                fresh.magic.store(kShmMagic, std::memory_order_release);
+                return;
+            }
+            if (h.version == kShmVersion && h.lanes == options_.lanes && h.depth == options_.depth &&
+                h.size == size && existing == size) {
+                return;
+            }
+            if (attempt > 0) {
+                failOpen("cannot recreate shared memory ");
+            }
+            // 旧客户端看到 retired 后抛出异常；删除名称后按新布局重建
+            h.retired.store(1, std::memory_order_release);
+            region_.unmap();
+            ::shm_unlink(options_.name.c_str());
+            ::close(fd_);
+        }
+    }
+
+    [[noreturn]] void failOpen(const char* what) {
+        const std::string message = what + options_.name + ": " + std::strerror(errno);
+        region_.unmap();
+        ::close(fd_);
+        throw std::runtime_error(message);
+    }
+
+    // 上一个服务端退出时交给它的线程池、尚未作答的槽位需要重新推理：从各通道的 reaped 处重新分派，
+    // dispatchLane() 会跳过已经作答的槽位。持有者已退出的通道直接回收
+    void recover() {
+        for (uint32_t i = 0; i < options_.lanes; ++i) {
+            shm::Lane& lane = region_.lane(i);
+            const int32_t owner = lane.owner.load(std::memory_order_acquire);
+            if (owner != 0 && !shm::processAlive(owner)) {
+                resetLane(i, owner);
+            } else {
+                lane.head.store(lane.reaped.load(std::memory_order_acquire), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 只在持有者已退出、且它的请求都已写回后调用
+    void resetLane(uint32_t i, int32_t owner) {
+        shm::Lane& lane = region_.lane(i);
+        for (uint32_t s = 0; s < options_.depth; ++s) {
+            region_.slot(i, s).state.store(shm::kFree, std::memory_order_relaxed);
+        }
+        lane.tail.store(0, std::memory_order_relaxed);
+        lane.reaped.store(0, std::memory_order_relaxed);
+        lane.head.store(0, std::memory_order_relaxed);
+        lane.owner.compare_exchange_strong(owner, 0, std::memory_order_release);
+    }
+
+    void reclaimDeadLanes() {
+        for (uint32_t i = 0; i < options_.lanes; ++i) {
+            const int32_t owner = region_.lane(i).owner.load(std::memory_order_acquire);
+            if (owner != 0 && inflight_[i].load(std::memory_order_acquire) == 0 && !shm::processAlive(owner)) {
+                resetLane(i, owner);
+            }
+        }
+    }
+
+    // 把通道 i 的 head..tail 交给线程池
+    Dispatch dispatchLane(uint32_t i) {
+        shm::Lane& lane = region_.lane(i);
+        if (lane.owner.load(std::memory_order_relaxed) == 0) {
+            return Dispatch::kIdle;
+        }
+        const uint32_t tail = lane.tail.load(std::memory_order_seq_cst);
+        uint32_t head = lane.head.load(std::memory_order_relaxed);
+        if (head == tail) {
+            return Dispatch::kIdle;
+        }
+        // 恢复后 head 可能落后超过一圈：更早的位置已被槽位复用，不能再分派
+        if (tail - head > options_.depth) {
+            head = tail - options_.depth;
+        }
+        Dispatch result = Dispatch::kProgress;
+        for (; head != tail; ++head) {
+            shm::Slot& slot = region_.slot(i, head);
+            const uint32_t state = slot.state.load(std::memory_order_acquire);
+            if (state != shm::kQueued && state != shm::kWaiting) {
+                continue;
+            }
+            inflight_[i].fetch_add(1, std::memory_order_relaxed);
+            inflight_total_.fetch_add(1, std::memory_order_relaxed);
+            if (!pool_.TrySubmitInPlace(slot.image, *this, (static_cast<uint64_t>(i) << 32) | head)) {
+                inflight_[i].fetch_sub(1, std::memory_order_relaxed);
+                inflight_total_.fetch_sub(1, std::memory_order_relaxed);
+                result = Dispatch::kBlocked;
+                break;
+            }
+        }
+        lane.head.store(head, std::memory_order_relaxed);
+        return result;
+    }
+
+    void dispatchLoop() {
+        shm::Header& h = region_.header();
+        Clock::time_point last_reclaim = Clock::now();
+        int idle = 0;
+        while (!stop_.load(std::memory_order_relaxed)) {
+            bool progress = false, blocked = false;
+            for (uint32_t i = 0; i < options_.lanes; ++i) {
+                const Dispatch d = dispatchLane(i);
+                progress |= d == Dispatch::kProgress;
+                blocked |= d == Dispatch::kBlocked;
+            }
+            const Clock::time_point now = Clock::now();
+            if (now - last_reclaim >= kReclaimPeriod) {
+                reclaimDeadLanes();
+                last_reclaim = now;
+            }
+            if (progress) {
+                idle = 0;
+                continue;
+            }
+            // 线程池满时等工作线程腾出队列，不睡眠
+            if (blocked || ++idle < kSpins) {
+                std::this_thread::yield();
+                continue;
+            }
+            // 先记下门铃、声明要睡，再查一遍：之后提交的客户端一定会看到 server_sleeping 并敲门铃
+            const uint32_t bell = h.doorbell.load(std::memory_order_seq_cst);
+            h.server_sleeping.store(1, std::memory_order_seq_cst);
+            if (!hasPending() && !stop_.load(std::memory_order_seq_cst)) {
+                shm::futexWait(h.doorbell, bell, kReclaimPeriod);
+            }
+            h.server_sleeping.store(0, std::memory_order_relaxed);
+            idle = 0;
+        }
+    }
+
+    bool hasPending() const {
+        for (uint32_t i = 0; i < options_.lanes; ++i) {
+            const shm::Lane& lane = region_.lane(i);
+            if (lane.owner.load(std::memory_order_relaxed) != 0 &&
+                lane.tail.load(std::memory_order_seq_cst) != lane.head.load(std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    shm::Slot& slotOf(uint64_t tag) const {
+        return region_.slot(static_cast<uint32_t>(tag >> 32), static_cast<uint32_t>(tag));
+    }
+
+    // 结果已写入槽位：置为最终状态，客户端已在等待时唤醒它
+    void publish(uint64_t tag, shm::Slot& slot, shm::SlotState state) {
+        if (slot.state.exchange(state, std::memory_order_acq_rel) == shm::kWaiting) {
+            shm::futexWake(slot.state);
+        }
+        served_.fetch_add(1, std::memory_order_relaxed);
+        inflight_[tag >> 32].fetch_sub(1, std::memory_order_release);
+        inflight_total_.fetch_sub(1, std::memory_order_release);
+    }
+
+    static constexpr int kSpins = 64;
+    static constexpr std::chrono::microseconds kReclaimPeriod{100000};
+
+    Pool& pool_;
+    Options options_;
+    int fd_ = -1;
+    shm::Region region_;
+    // 每条通道已交给线程池、尚未写回的请求数；为 0 时才可回收通道
+    std::unique_ptr<std::atomic<uint32_t>[]> inflight_;
+    std::atomic<uint64_t> inflight_total_{0};
+    std::atomic<uint64_t> served_{0};
+    std::atomic<bool> stop_{false};
+    std::thread dispatcher_;
+};
+
+struct InferencePool;
+using ShmServer = BasicShmServer<InferencePool>;
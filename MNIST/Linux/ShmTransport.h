@@ -0,0 +1,363 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+//--------------------------------------------------------------------
+// 同机进程间的共享内存推理通道（服务端见 ShmServer.h）。
+// shm_open 出的一块区域里有 lanes 条通道，每个客户端独占一条（按 pid 用 CAS 认领），
+// 通道是 depth 个固定大小槽位组成的单生产者环：槽位里放 28×28 的 float 图像与结果。
+//
+//   客户端：把图像直接写进槽位 → state = Queued → 发布 tail；
+//           服务端睡着时才敲一下门铃（doorbell 上的 futex），平时提交不进内核
+//   服务端：分派线程轮询各通道的 head..tail，把槽位里的图像原地交给 InferencePool，
+//           工作线程把结果写回槽位并置 Done，只有客户端已在 futex 上等待时才唤醒它
+//
+// 区域在服务端退出后保留：服务端重启时复用同一区域，把每条通道中尚未作答的槽位重新推理，
+// 客户端无需重连。持有通道的客户端死亡后，服务端在它的请求都算完后回收该通道。
+// 服务端以不同的布局重启时旧区域被标为 retired，客户端随后的调用抛出异常，需重新连接。
+// 这个头文件不依赖 ORT，客户端程序只需链接 librt
+//--------------------------------------------------------------------
+static constexpr int kShmImageSize = 28 * 28;
+static constexpr int kShmClasses = 10;
+static constexpr uint32_t kShmMagic = 0x4d4e5348;  // "MNSH"
+static constexpr uint32_t kShmVersion = 1;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<int32_t>::is_always_lock_free,
+              "shared-memory atomics must be lock-free to work across processes");
+
+namespace shm {
+
+static constexpr size_t kCacheLine = 64;
+
+// 槽位状态，同时是客户端等待结果时的 futex 字
+enum SlotState : uint32_t { kFree = 0, kQueued = 1, kWaiting = 2, kDone = 3, kFailed = 4 };
+
+struct Header {
+    std::atomic<uint32_t> magic;      // 最后写入：非 kShmMagic 时区域尚未初始化完
+    uint32_t version;
+    uint32_t lanes;
+    uint32_t depth;
+    uint64_t size;
+    std::atomic<int32_t> server_pid;  // 0 = 没有服务端在运行
+    std::atomic<uint32_t> epoch;      // 每次服务端启动加一
+    std::atomic<uint32_t> retired;    // 服务端已换用新区域
+    // 分派线程睡眠时等在 doorbell 上，客户端看到 server_sleeping 时递增并唤醒
+    alignas(kCacheLine) std::atomic<uint32_t> doorbell;
+    std::atomic<uint32_t> server_sleeping;
+};
+
+struct Lane {
+    alignas(kCacheLine) std::atomic<int32_t> owner;  // 客户端 pid，0 = 空闲
+    // 客户端侧：已提交数与已取回数
+    alignas(kCacheLine) std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> reaped;
+    // 服务端侧：已交给线程池的数目
+    alignas(kCacheLine) std::atomic<uint32_t> head;
+};
+
+struct Slot {
+    std::atomic<uint32_t> state;
+    int32_t digit;
+    float probabilities[kShmClasses];
+    char error[112];                  // kFailed 时的错误信息
+    alignas(kCacheLine) float image[kShmImageSize];
+};
+
+static constexpr size_t headerBytes() { return (sizeof(Header) + kCacheLine - 1) / kCacheLine * kCacheLine; }
+
+static inline size_t regionBytes(uint32_t lanes, uint32_t depth) {
+    return headerBytes() + lanes * sizeof(Lane) + static_cast<size_t>(lanes) * depth * sizeof(Slot);
+}
+
+// 跨进程的 futex（不能用 FUTEX_PRIVATE_FLAG）；word 不等于 expected 时立即返回
+static inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::microseconds timeout) {
+    timespec ts{};
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000) * 1000;
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+static inline void futexWake(std::atomic<uint32_t>& word) {
+    ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static inline bool processAlive(int32_t pid) {
+    return pid > 0 && (::kill(pid, 0) == 0 || errno == EPERM);
+}
+
+// 映射好的共享内存区域
+struct Region {
+    Region() = default;
+    Region(const Region&) = delete;
+    Region& operator=(const Region&) = delete;
+
+    ~Region() { unmap(); }
+
+    void map(int fd, size_t size, const std::string& name) {
+        void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("cannot map shared memory " + name + ": " + std::strerror(errno));
+        }
+        base = static_cast<uint8_t*>(p);
+        size_ = size;
+    }
+
+    void unmap() {
+        if (base) {
+            ::munmap(base, size_);
+            base = nullptr;
+        }
+    }
+
+    Header& header() const { return *reinterpret_cast<Header*>(base); }
+
+    Lane& lane(uint32_t i) const {
+        return reinterpret_cast<Lane*>(base + headerBytes())[i];
+    }
+
+    Slot& slot(uint32_t lane, uint32_t i) const {
+        const Header& h = header();
+        Slot* slots = reinterpret_cast<Slot*>(base + headerBytes() + h.lanes * sizeof(Lane));
+        return slots[static_cast<size_t>(lane) * h.depth + (i & (h.depth - 1))];
+    }
+
+    uint8_t* base = nullptr;
+
+private:
+    size_t size_ = 0;
+};
+
+}  // namespace shm
+
+// 一张图像的结果
+struct ShmResult {
+    int digit = -1;
+    std::array<float, kShmClasses> probabilities{};
+};
+
+//--------------------------------------------------------------------
+// 客户端：认领一条通道，最多同时有 depth 个请求在途，结果按提交顺序取回。
+//   float* image = client.acquire();  // 通道满时为 nullptr
+//   ...把 [0,1] 的 28×28 图像直接写进 image...
+//   client.submit();
+//   ShmResult r = client.wait();
+// 一个 ShmClient 只能由一个线程使用
+//--------------------------------------------------------------------
+struct ShmClient {
+    explicit ShmClient(const std::string& name = "/mnist") : name_(name) {
+        const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            throw std::runtime_error("no MNIST shared-memory server at " + name + ": " + std::strerror(errno));
+        }
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < shm::headerBytes()) {
+            ::close(fd);
+            throw std::runtime_error("shared memory " + name + " is not initialised yet");
+        }
+        try {
+            region_.map(fd, static_cast<size_t>(st.st_size), name);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+
+        shm::Header& h = region_.header();
+        if (h.magic.load(std::memory_order_acquire) != kShmMagic || h.version != kShmVersion ||
+            h.size != static_cast<uint64_t>(st.st_size)) {
+            throw std::runtime_error("shared memory " + name + " is not an MNIST server region (or is still starting)");
+        }
+        if (h.retired.load(std::memory_order_acquire)) {
+            throw std::runtime_error("shared memory " + name + " was retired by a restarted server");
+        }
+        depth_ = h.depth;
+
+        const int32_t pid = static_cast<int32_t>(::getpid());
+        for (uint32_t i = 0; i < h.lanes; ++i) {
+            int32_t expected = 0;
+            if (region_.lane(i).owner.compare_exchange_strong(expected, pid, std::memory_order_acq_rel)) {
+                lane_ = i;
+                break;
+            }
+        }
+        if (lane_ == kNoLane) {
+            throw std::runtime_error("all " + std::to_string(h.lanes) + " shared-memory lanes are in use");
+        }
+        shm::Lane& lane = region_.lane(lane_);
+        tail_ = lane.tail.load(std::memory_order_relaxed);
+        reaped_ = lane.reaped.load(std::memory_order_relaxed);
+    }
+
+    // 等在途的请求算完后交还通道；服务端不在时保留通道，由下一个服务端在确认本进程退出后回收
+    ~ShmClient() {
+        while (reaped_ != tail_ && serverRunning()) {
+            try {
+                ShmResult ignored;
+                if (!wait(ignored, std::chrono::milliseconds(100))) {
+                    continue;
+                }
+            } catch (...) {
+                break;
+            }
+        }
+        if (reaped_ == tail_) {
+            region_.lane(lane_).owner.store(0, std::memory_order_release);
+        }
+    }
+
+    ShmClient(const ShmClient&) = delete;
+    ShmClient& operator=(const ShmClient&) = delete;
+
+    // 下一个空闲槽位的图像缓冲（kShmImageSize 个 float）；depth 个请求都在途时返回 nullptr
+    float* acquire() {
+        if (tail_ - reaped_ >= depth_) {
+            return nullptr;
+        }
+        return region_.slot(lane_, tail_).image;
+    }
+
+    // 提交 acquire() 返回的槽位
+    void submit() {
+        shm::Slot& slot = region_.slot(lane_, tail_);
+        slot.state.store(shm::kQueued, std::memory_order_relaxed);
+        // seq_cst 的 tail 发布与 server_sleeping 的读取，和分派线程睡前的写-读构成 Dekker 式配对
+        region_.lane(lane_).tail.store(++tail_, std::memory_order_seq_cst);
+        shm::Header& h = region_.header();
+        if (h.server_sleeping.load(std::memory_order_seq_cst)) {
+            h.doorbell.fetch_add(1, std::memory_order_seq_cst);
+            shm::futexWake(h.doorbell);
+        }
+    }
+
+    // 拷贝一张图像并提交；通道满时返回 false
+    bool trySubmit(const float* image) {
+        float* slot = acquire();
+        if (!slot) {
+            return false;
+        }
+        std::memcpy(slot, image, kShmImageSize * sizeof(float));
+        submit();
+        return true;
+    }
+
+    // 在途（已提交未取回）的请求数
+    uint32_t pending() const { return tail_ - reaped_; }
+    uint32_t depth() const { return depth_; }
+
+    // 取回最早提交的请求的结果；最早的请求还没算完时返回 false
+    bool poll(ShmResult& result) {
+        if (reaped_ == tail_) {
+            throw std::logic_error("no request in flight");
+        }
+        const uint32_t state = region_.slot(lane_, reaped_).state.load(std::memory_order_acquire);
+        if (state != shm::kDone && state != shm::kFailed) {
+            return false;
+        }
+        reap(result);
+        return true;
+    }
+
+    // 等最早提交的请求的结果，超时返回 false。服务端不在时请求留在共享内存中，
+    // 由重启后的服务端继续处理
+    bool wait(ShmResult& result, std::chrono::microseconds timeout) {
+        if (reaped_ == tail_) {
+            throw std::logic_error("no request in flight");
+        }
+        shm::Slot& slot = region_.slot(lane_, reaped_);
+        // 结果通常在几十微秒内就绪：先自旋，再在槽位的 state 上睡眠
+        for (int spin = 0; spin < kSpins; ++spin) {
+            if (poll(result)) {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (;;) {
+            uint32_t expected = shm::kQueued;
+            slot.state.compare_exchange_strong(expected, shm::kWaiting, std::memory_order_acq_rel);
+            if (expected == shm::kDone || expected == shm::kFailed) {
+                reap(result);
+                return true;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                return false;
+            }
+            if (region_.header().retired.load(std::memory_order_relaxed)) {
+                throw std::runtime_error("shared memory " + name_ + " was retired by a restarted server");
+            }
+            // 限制单次睡眠，以便及时发现区域被弃用
+            const auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now);
+            shm::futexWait(slot.state, shm::kWaiting, std::min(left, std::chrono::microseconds(100000)));
+        }
+    }
+
+    ShmResult wait() {
+        ShmResult result;
+        while (!wait(result, std::chrono::seconds(1))) {
+        }
+        return result;
+    }
+
+    // 提交一张图像并等它的结果；只能在没有请求在途时调用
+    ShmResult classify(const float* image) {
+        if (pending() != 0 || !trySubmit(image)) {
+            throw std::logic_error("classify() needs a lane with no request in flight");
+        }
+        return wait();
+    }
+
+    // 区域里记录的服务端进程是否还活着
+    bool serverRunning() const {
+        return shm::processAlive(region_.header().server_pid.load(std::memory_order_relaxed));
+    }
+
+private:
+    void reap(ShmResult& result) {
+        shm::Slot& slot = region_.slot(lane_, reaped_);
+        const bool failed = slot.state.load(std::memory_order_acquire) == shm::kFailed;
+        std::string error;
+        if (failed) {
+            error.assign(slot.error, strnlen(slot.error, sizeof(slot.error)));
+        } else {
+            result.digit = slot.digit;
+            std::memcpy(result.probabilities.data(), slot.probabilities, sizeof(slot.probabilities));
+        }
+        slot.state.store(shm::kFree, std::memory_order_relaxed);
+        region_.lane(lane_).reaped.store(++reaped_, std::memory_order_release);
+        if (failed) {
+            throw std::runtime_error("inference failed: " + error);
+        }
+    }
+
+    static constexpr int kSpins = 64;
+    static constexpr uint32_t kNoLane = UINT32_MAX;
+
+    std::string name_;
+    shm::Region region_;
+    uint32_t lane_ = kNoLane;
+    uint32_t depth_ = 0;
+    // 本地的 tail / reaped 副本（只有本客户端写它们）
+    uint32_t tail_ = 0;
+    uint32_t reaped_ = 0;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstddef>
+#include <stdexcept>
+
+//--------------------------------------------------------------------
+// 有界的单生产者/单消费者环形队列，用来串起流水线上相邻的两个阶段。
+// 快路径只有两侧各自的一个下标（对方下标在本地缓存，只在看似满/空时才重新读）；满/空时先自旋一小会儿，
+// 仍不满足才在条件变量上睡眠，另一侧只在对方确实睡着时才加锁唤醒，
+// 空闲的阶段不会占着核心与 ORT 的计算线程争抢
+//--------------------------------------------------------------------
+template <typename T>
+struct SpscRing {
+    // capacity 必须是 2 的幂
+    explicit SpscRing(size_t capacity) : mask_(capacity - 1), slots_(new T[capacity]) {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("SpscRing capacity must be a power of two");
+        }
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // 只能由生产者线程调用；满时返回 false
+    bool tryPush(const T& value) {
+        if (!put(value)) {
+            return false;
+        }
+        wake(consumer_waiting_);
+        return true;
+    }
+
+    // 只能由消费者线程调用；空时返回 false
+    bool tryPop(T& value) {
+        if (!take(value)) {
+            return false;
+        }
+        wake(producer_waiting_);
+        return true;
+    }
+
+    // 阻塞版本：满时等消费者取走
+    void push(const T& value) {
+        block(producer_waiting_, [&] { return put(value); });
+        wake(consumer_waiting_);
+    }
+
+    // 阻塞版本：空时等生产者放入
+    T pop() {
+        T value;
+        block(consumer_waiting_, [&] { return take(value); });
+        wake(producer_waiting_);
+        return value;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    // 下标的发布与刷新都用 seq_cst，与 block() 里等待标志的写入构成 Dekker 式的配对
+    bool put(const T& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_seq_cst);
+            if (tail - head_cache_ > mask_) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    bool take(T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_seq_cst);
+            if (head == tail_cache_) {
+                return false;
+            }
+        }
+        value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    template <typename Try>
+    void block(std::atomic<bool>& waiting, Try&& attempt) {
+        for (int spin = 0; spin < kSpins; ++spin) {
+            if (attempt()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            // 先声明要睡，再重试一次：对方在此之后的更新一定会看到这个标志并唤醒
+            waiting.store(true, std::memory_order_seq_cst);
+            if (attempt()) {
+                break;
+            }
+            wakeup_.wait(lock);
+        }
+        waiting.store(false, std::memory_order_relaxed);
+    }
+
+    void wake(std::atomic<bool>& waiting) {
+        if (waiting.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_.notify_all();
+        }
+    }
+
+    static constexpr int kSpins = 64;
+    static constexpr size_t kCacheLine = 64;
+
+    const size_t mask_;
+    std::unique_ptr<T[]> slots_;
+    // 生产者侧：写下标与对读下标的缓存
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};
+    size_t head_cache_ = 0;
+    // 消费者侧：读下标与对写下标的缓存
+    alignas(kCacheLine) std::atomic<size_t> head_{0};
+    size_t tail_cache_ = 0;
+    alignas(kCacheLine) std::atomic<bool> producer_waiting_{false};
+    std::atomic<bool> consumer_waiting_{false};
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+};
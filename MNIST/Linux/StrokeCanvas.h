@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "Preprocess.h"
+
+//--------------------------------------------------------------------
+// CPU 侧的 8 位灰度画布：笔画直接软件光栅化到这里（0 = 背景，255 = 笔迹），
+// 预处理按 PixelFormat::Gray8 读取，不需要从 GPU 读回，也不需要 RGBA → 灰度换算。
+// 显示时只把变化的矩形上传到流式纹理
+//--------------------------------------------------------------------
+struct StrokeCanvas {
+    StrokeCanvas(int width, int height)
+        : width_(width), height_(height), pixels_(static_cast<size_t>(width) * height, 0) {}
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    const uint8_t* data() const { return pixels_.data(); }
+    const std::vector<uint8_t>& pixels() const { return pixels_; }
+
+    void clear() {
+        std::fill(pixels_.begin(), pixels_.end(), 0);
+    }
+
+    // 画一段半径为 radius 的抗锯齿粗线（两端为半圆，即胶囊形），
+    // 返回被修改的像素矩形。覆盖率按像素中心到线段的距离在 1 像素内线性过渡，
+    // 与已有笔迹取最大值，相邻线段在端点处重叠也不会变深
+    DirtyRect line(float ax, float ay, float bx, float by, float radius, uint8_t ink = 255) {
+        DirtyRect dirty;
+        const float reach = radius + 0.5f;
+        dirty.add(static_cast<int>(std::floor(std::min(ax, bx) - reach)),
+                  static_cast<int>(std::floor(std::min(ay, by) - reach)),
+                  static_cast<int>(std::ceil(std::max(ax, bx) + reach)) + 1,
+                  static_cast<int>(std::ceil(std::max(ay, by) + reach)) + 1,
+                  width_, height_);
+        if (dirty.empty()) {
+            return dirty;
+        }
+
+        const float dx = bx - ax;
+        const float dy = by - ay;
+        const float len2 = dx * dx + dy * dy;
+        const float inv_len2 = len2 > 0.0f ? 1.0f / len2 : 0.0f;
+        // 距离平方落在 [inner2, outer2) 之间时才需要开方计算部分覆盖
+        const float inner = std::max(radius - 0.5f, 0.0f);
+        const float inner2 = inner * inner;
+        const float outer2 = reach * reach;
+
+        for (int y = dirty.y0; y < dirty.y1; ++y) {
+            uint8_t* row = pixels_.data() + static_cast<size_t>(y) * width_;
+            const float py = y + 0.5f - ay;
+            for (int x = dirty.x0; x < dirty.x1; ++x) {
+                const float px = x + 0.5f - ax;
+                // 像素中心在线段上的投影参数，夹到 [0, 1] 即为到线段（而非直线）的最近点
+                const float t = std::min(std::max((px * dx + py * dy) * inv_len2, 0.0f), 1.0f);
+                const float ex = px - t * dx;
+                const float ey = py - t * dy;
+                const float d2 = ex * ex + ey * ey;
+                if (d2 >= outer2) {
+                    continue;
+                }
+                const float coverage = d2 <= inner2 ? 1.0f : reach - std::sqrt(d2);
+                const uint8_t value = static_cast<uint8_t>(std::min(coverage, 1.0f) * ink + 0.5f);
+                row[x] = std::max(row[x], value);
+            }
+        }
+        return dirty;
+    }
+
+    // 把 rect 内的像素展开成白底黑字的 RGBA8888（行距 pitch 字节），供显示上传用
+    void toRgba(const DirtyRect& rect, uint8_t* dst, int pitch) const {
+        for (int y = rect.y0; y < rect.y1; ++y) {
+            const uint8_t* src = pixels_.data() + static_cast<size_t>(y) * width_;
+            uint32_t* out = reinterpret_cast<uint32_t*>(dst + static_cast<size_t>(y - rect.y0) * pitch);
+            for (int x = rect.x0; x < rect.x1; ++x) {
+                const uint32_t v = 255u - src[x];
+                out[x - rect.x0] = (v << 24) | (v << 16) | (v << 8) | 0xffu;
+            }
+        }
+    }
+
+private:
+    int width_;
+    int height_;
+    std::vector<uint8_t> pixels_;
+};
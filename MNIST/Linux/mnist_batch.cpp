@@ -0,0 +1,511 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <exception>
+
+#include "MNISTModel.h"
+#include "InferencePool.h"
+#include "IdxFile.h"
+#include "Metrics.h"
+#include "GpuPipeline.h"
+#include "SpscRing.h"
+
+//--------------------------------------------------------------------
+// 无界面批量推理：读取 MNIST IDX（或原始 u8 28×28 流），按固定 batch 推理，
+// 输出每张图的预测结果与概率，并统计吞吐
+//--------------------------------------------------------------------
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] <images>\n"
+              << "  --model <path>   ONNX model (default: mnist_batch.onnx, built in when embedded)\n"
+              << "  --precision <p>  use the bundled fp32, fp16 or int8 model instead of --model\n"
+              << "  --batch <n>      images per Run (default: 64)\n"
+              << "  --raw            input is a raw u8 28x28 stream instead of IDX\n"
+              << "  --output <path>  write predictions here instead of stdout\n"
+              << "  --predict-only   skip softmax and write only the predicted digit\n"
+              << "  --workers <n>    score images one at a time on an n-thread InferencePool\n"
+              << "  --max-batch <n>  with --workers: micro-batch up to n queued images per Run\n"
+              << "  --max-wait-us <t> with --workers: flush a micro-batch after t us (default 500)\n"
+              << "  --pipeline <n>   run load / preprocess / infer / postprocess / write on their own threads\n"
+              << "                   with n batches in flight (>= 2), so batch k+1 is prepared while batch k runs\n"
+              << "  --gpu-pipeline <n> with --ep cuda/tensorrt: bind I/O on the device, stage through pinned memory\n"
+              << "                   and keep n batches in flight so copies overlap compute\n"
+              << "  --gpu-preprocess with --gpu-pipeline: upload u8 pixels and normalize them on the GPU\n"
+              << "  --arena <MiB>    serve tensors and batch buffers from a pool primed before the first batch,\n"
+              << "                   capped at MiB (0 = no cap)\n"
+              << "  --stats <path>   write per-stage latency histograms in Prometheus text format ('-' = stderr)\n"
+              << "  --stats-interval <s> print a per-stage latency summary to stderr every s seconds\n"
+              << sessionFlagsUsage();
+}
+
+//--------------------------------------------------------------------
+// 分阶段流水线（--pipeline）：读取 → 前处理 → 推理 → 后处理 → 写出各占一个线程，
+// 相邻阶段之间用有界的 SpscRing 传递批次。共 depth 个批次缓冲轮转使用，
+// 写出后经 free 环回到读取阶段，于是推理第 k 批时第 k+1 批已在前处理。
+// 某一阶段出错后各阶段不再做事、只把批次往下传，让流水线正常排空后再抛出
+//--------------------------------------------------------------------
+enum PipelineStage { kLoad, kPreprocess, kInfer, kPostprocess, kWrite, kPipelineStages };
+
+struct PipelineBatch {
+    size_t begin = 0;
+    size_t n = 0;
+    // 从 IDX 拷出的 u8 像素（缺页与读盘都落在读取阶段）、按模型输入类型转换后的输入、结果
+    AlignedBuffer<uint8_t> pixels;
+    AlignedBuffer<uint8_t> input;
+    AlignedFloats results;
+    std::vector<int> predicted;
+    std::optional<MNISTModel::Binding> bound;
+    // 走了 RunBatch（已在推理阶段做完 softmax）
+    bool postprocessed = false;
+};
+
+// 各阶段累计的忙碌时间
+using PipelineTimes = std::array<std::chrono::steady_clock::duration, kPipelineStages>;
+
+template <typename Write>
+static PipelineTimes runPipelined(MNISTModel& model, const IdxFile& images, size_t batch, size_t depth,
+                                  BufferPool* buffers, Metrics* metrics, Write&& write) {
+    size_t ring_capacity = 2;
+    while (ring_capacity < depth) ring_capacity <<= 1;
+
+    std::vector<PipelineBatch> batches(depth);
+    for (PipelineBatch& b : batches) {
+        b.pixels = allocAligned<uint8_t>(batch * MNIST_IMAGE_SIZE, buffers);
+        b.input = allocAligned<uint8_t>(batch * MNIST_IMAGE_SIZE * sizeof(float), buffers);
+        b.results = allocAligned(batch * MNIST_CLASSES, buffers);
+        b.predicted.resize(batch);
+        if (model.acceptsBatch(batch)) {
+            model.visitInputType([&](auto* tag) {
+                using T = std::remove_pointer_t<decltype(tag)>;
+                b.bound = model.Bind(reinterpret_cast<T*>(b.input.get()), b.results.get(), batch);
+            });
+        }
+    }
+
+    // rings[s] 为阶段 s 的输入；rings[kLoad] 即写出后归还的空闲批次。nullptr 表示数据流结束
+    std::vector<std::unique_ptr<SpscRing<PipelineBatch*>>> rings;
+    for (int s = 0; s < kPipelineStages; ++s) {
+        rings.push_back(std::make_unique<SpscRing<PipelineBatch*>>(ring_capacity));
+    }
+    for (PipelineBatch& b : batches) {
+        rings[kLoad]->push(&b);
+    }
+
+    PipelineTimes busy{};
+    std::array<std::exception_ptr, kPipelineStages> errors{};
+    std::atomic<bool> failed{false};
+    auto timed = [&](int stage, auto&& work) {
+        if (failed.load(std::memory_order_relaxed)) {
+            return;
+        }
+        try {
+            const auto t0 = std::chrono::steady_clock::now();
+            work();
+            busy[stage] += std::chrono::steady_clock::now() - t0;
+        } catch (...) {
+            errors[stage] = std::current_exception();
+            failed.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    const size_t total = images.count();
+    threads.emplace_back([&] {
+        for (size_t begin = 0; begin < total && !failed.load(std::memory_order_relaxed); begin += batch) {
+            PipelineBatch* b = rings[kLoad]->pop();
+            timed(kLoad, [&] {
+                b->begin = begin;
+                b->n = std::min(batch, total - begin);
+                b->postprocessed = false;
+                std::memcpy(b->pixels.get(), images.sample(begin), b->n * MNIST_IMAGE_SIZE);
+            });
+            rings[kPreprocess]->push(b);
+        }
+        rings[kPreprocess]->push(nullptr);
+    });
+
+    // 中间的三个阶段：取一批、处理、交给下一阶段
+    auto stage = [&](int s, auto work) {
+        threads.emplace_back([&, s, work] {
+            for (;;) {
+                PipelineBatch* b = rings[s]->pop();
+                if (b) {
+                    timed(s, [&] { work(*b); });
+                }
+                rings[s + 1]->push(b);
+                if (!b) {
+                    return;
+                }
+            }
+        });
+    };
+    stage(kPreprocess, [&](PipelineBatch& b) {
+        StageTimer timer(metrics, Stage::Convert);
+        model.visitInputType([&](auto* tag) {
+            using T = std::remove_pointer_t<decltype(tag)>;
+            grayToTensor(b.pixels.get(), b.n * MNIST_IMAGE_SIZE, reinterpret_cast<T*>(b.input.get()));
+        });
+    });
+    stage(kInfer, [&](PipelineBatch& b) {
+        if (b.bound && b.n == batch) {
+            model.RunLogits(*b.bound);
+            return;
+        }
+        // 最后不足一批（或模型 N 固定且与 batch 不符）
+        model.visitInputType([&](auto* tag) {
+            using T = std::remove_pointer_t<decltype(tag)>;
+            model.RunBatch(reinterpret_cast<const T*>(b.input.get()), b.n, b.results.get(), b.predicted.data());
+        });
+        b.postprocessed = true;
+    });
+    stage(kPostprocess, [&](PipelineBatch& b) {
+        if (!b.postprocessed) {
+            model.Postprocess(b.results.get(), b.n, b.predicted.data());
+        }
+    });
+
+    // 写出在调用线程上进行，写完的批次归还给读取阶段
+    for (;;) {
+        PipelineBatch* b = rings[kWrite]->pop();
+        if (!b) {
+            break;
+        }
+        timed(kWrite, [&] { write(b->begin, b->n, b->predicted.data(), b->results.get()); });
+        rings[kLoad]->push(b);
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    for (const std::exception_ptr& e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+    return busy;
+}
+
+int main(int argc, char* argv[])
+{
+    // 未指定时优先用编译进程序的模型
+    const char* model_path = nullptr;
+    const char* input_path = nullptr;
+    const char* output_path = nullptr;
+    size_t batch = 64;
+    InferencePool::Options pool_options;
+    pool_options.max_wait = std::chrono::microseconds(500);
+    bool raw = false;
+    bool predict_only = false;
+    const char* stats_path = nullptr;
+    int stats_interval = 0;
+    long arena_mib = -1;
+    size_t gpu_slots = 0;
+    bool gpu_preprocess = false;
+    size_t pipeline_depth = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--model") && i + 1 < argc) {
+            model_path = argv[++i];
+        } else if (!std::strcmp(argv[i], "--precision") && i + 1 < argc) {
+            model_path = mnistModelForPrecision(argv[++i]);
+            if (!model_path) {
+                usage(argv[0]);
+                return -1;
+            }
+        } else if (!std::strcmp(argv[i], "--batch") && i + 1 < argc) {
+            batch = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--workers") && i + 1 < argc) {
+            pool_options.workers = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--max-batch") && i + 1 < argc) {
+            pool_options.max_batch = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--max-wait-us") && i + 1 < argc) {
+            pool_options.max_wait = std::chrono::microseconds(std::strtoul(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--raw")) {
+            raw = true;
+        } else if (!std::strcmp(argv[i], "--predict-only")) {
+            predict_only = true;
+        } else if (!std::strcmp(argv[i], "--output") && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (!std::strcmp(argv[i], "--pipeline") && i + 1 < argc) {
+            pipeline_depth = std::strtoul(argv[++i], nullptr, 10);
+            if (pipeline_depth < 2) {
+                usage(argv[0]);
+                return -1;
+            }
+        } else if (!std::strcmp(argv[i], "--gpu-pipeline") && i + 1 < argc) {
+            gpu_slots = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--gpu-preprocess")) {
+            gpu_preprocess = true;
+        } else if (!std::strcmp(argv[i], "--arena") && i + 1 < argc) {
+            arena_mib = std::strtol(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--stats") && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (!std::strcmp(argv[i], "--stats-interval") && i + 1 < argc) {
+            stats_interval = std::atoi(argv[++i]);
+        } else if (parseSessionFlag(argc, argv, i, pool_options.session)) {
+            continue;
+        } else if (argv[i][0] != '-' && !input_path) {
+            input_path = argv[i];
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (!input_path || batch == 0 || (gpu_preprocess && !gpu_slots)) {
+        usage(argv[0]);
+        return -1;
+    }
+    if (gpu_slots && pool_options.workers > 0) {
+        std::cerr << "--gpu-pipeline and --workers cannot be combined" << std::endl;
+        return -1;
+    }
+    if (pipeline_depth && (gpu_slots || pool_options.workers > 0)) {
+        std::cerr << "--pipeline cannot be combined with --gpu-pipeline or --workers" << std::endl;
+        return -1;
+    }
+#ifndef MNIST_WITH_CUDA
+    if (gpu_slots) {
+        std::cerr << "--gpu-pipeline needs a build with CUDA (configure with -DMNIST_WITH_CUDA=ON)" << std::endl;
+        return -1;
+    }
+#endif
+
+    try {
+        // --workers 时由线程池（共享同一会话）逐张推理，否则在本线程按批推理
+#ifdef MNIST_EMBEDDED_MODEL
+        const ModelSource source = model_path ? ModelSource(model_path) : embeddedModel();
+#else
+        const ModelSource source = model_path ? model_path : "mnist_batch.onnx";
+#endif
+        // arena 须先于使用它的会话构造、晚于它们析构
+        std::unique_ptr<TensorArena> arena;
+        if (arena_mib >= 0) {
+            arena = std::make_unique<TensorArena>(static_cast<size_t>(arena_mib) << 20);
+            pool_options.session.arena = arena.get();
+        }
+        BufferPool* buffers = arena ? &arena->pool() : nullptr;
+        // 只在需要时计时，否则热路径上不读时钟
+        std::unique_ptr<Metrics> metrics;
+        if (stats_path || stats_interval > 0) {
+            metrics = std::make_unique<Metrics>();
+            pool_options.metrics = metrics.get();
+        }
+#ifdef MNIST_WITH_CUDA
+        // 会话的计算流须先于会话创建、晚于它销毁
+        std::unique_ptr<CudaStream> compute_stream;
+        if (gpu_slots) {
+            compute_stream = std::make_unique<CudaStream>();
+            pool_options.session.cuda_stream = compute_stream->get();
+        }
+#endif
+        std::unique_ptr<InferencePool> pool;
+        std::unique_ptr<MNISTModel> single;
+        if (pool_options.workers > 0) {
+            pool = std::make_unique<InferencePool>(source, pool_options);
+        } else {
+            single = std::make_unique<MNISTModel>(source, pool_options.session);
+        }
+        MNISTModel& model = pool ? pool->model() : *single;
+        model.compute_probabilities_ = !predict_only;
+        std::unique_ptr<StatsReporter> reporter;
+        if (stats_interval > 0) {
+            reporter = std::make_unique<StatsReporter>(std::chrono::seconds(stats_interval),
+                                                       [&metrics] { metrics->writeSummary(std::cerr); });
+        }
+        IdxFile images(input_path, raw);
+        if (images.sampleSize() != MNIST_IMAGE_SIZE) {
+            std::cerr << "Expected 28x28 images in " << input_path << std::endl;
+            return -1;
+        }
+
+        std::ofstream file;
+        if (output_path) {
+            file.open(output_path);
+            if (!file) {
+                std::cerr << "Cannot open " << output_path << std::endl;
+                return -1;
+            }
+        }
+        std::ostream& out = output_path ? file : std::cout;
+
+        // 每批复用同一组对齐缓冲区；整批时走预先绑定的 IoBinding，
+        // 最后不足一批（或模型 N 固定且与 batch 不符）时走 RunBatch。
+        // 输入缓冲按模型的输入类型使用（线程池的请求总是 float）：
+        // uint8 模型直接拷贝 IDX 像素，不经过 float
+        AlignedBuffer<uint8_t> input = allocAligned<uint8_t>(batch * MNIST_IMAGE_SIZE * sizeof(float), buffers);
+        AlignedFloats results = allocAligned(batch * MNIST_CLASSES, buffers);
+        std::vector<int> predicted(batch);
+        std::vector<std::future<Prediction>> pending(pool ? batch : 0);
+        std::optional<MNISTModel::Binding> bound;
+#ifdef MNIST_WITH_CUDA
+        std::unique_ptr<GpuPipeline> gpu;
+        if (gpu_slots) {
+            GpuPipeline::Options gpu_options;
+            gpu_options.batch = batch;
+            gpu_options.slots = gpu_slots;
+            gpu_options.gpu_preprocess = gpu_preprocess;
+            gpu_options.device_id = pool_options.session.device_id;
+            gpu = std::make_unique<GpuPipeline>(model, *compute_stream, gpu_options);
+        }
+#endif
+        if (!pool && !gpu_slots && !pipeline_depth && model.acceptsBatch(batch)) {
+            model.visitInputType([&](auto* tag) {
+                using T = std::remove_pointer_t<decltype(tag)>;
+                bound = model.Bind(reinterpret_cast<T*>(input.get()), results.get(), batch);
+            });
+        }
+        float* pool_input = reinterpret_cast<float*>(input.get());
+
+        const size_t total = images.count();
+        if (single) {
+            // 用到 arena 时先按整批与最后不足一批的大小各推理一次，ORT 的中间张量在计时前就备进池里
+            // （线程池在构造时已自行预热）
+            if (arena && !gpu_slots) {
+                single->WarmUp(batch);
+                if (total % batch) {
+                    single->WarmUp(total % batch);
+                }
+            }
+            single->metrics_ = metrics.get();
+        }
+        if (arena) {
+            std::cerr << "primed ";
+            arena->pool().writeSummary(std::cerr);
+        }
+        std::chrono::steady_clock::duration infer_time{};
+        auto start = std::chrono::steady_clock::now();
+
+        out << "index,predicted";
+        if (!predict_only) {
+            for (int c = 0; c < MNIST_CLASSES; ++c) out << ",p" << c;
+        }
+        out << '\n';
+
+        auto writeRows = [&](size_t begin, size_t n, const int* digits, const float* probabilities) {
+            for (size_t i = 0; i < n; ++i) {
+                out << (begin + i) << ',' << digits[i];
+                if (!predict_only) {
+                    for (int c = 0; c < MNIST_CLASSES; ++c) out << ',' << probabilities[i * MNIST_CLASSES + c];
+                }
+                out << '\n';
+            }
+        };
+
+#ifdef MNIST_WITH_CUDA
+        // GPU 流水线：依次轮用各槽位，槽位再次轮到时先取回它上一批的结果，
+        // 于是总有 gpu_slots 批在上传 / 推理 / 回传中
+        for (size_t begin = 0, k = 0; gpu && begin < total; begin += batch, ++k) {
+            const size_t slot = k % gpu->slots();
+            if (k >= gpu->slots()) {
+                const size_t done = begin - gpu->slots() * batch;
+                const float* probabilities = gpu->wait(slot, predicted.data());
+                writeRows(done, batch, predicted.data(), probabilities);
+            }
+            gpu->submit(slot, images.sample(begin), std::min(batch, total - begin));
+        }
+        if (gpu) {
+            // 按提交顺序取回仍在途的批
+            const size_t batches = (total + batch - 1) / batch;
+            for (size_t k = batches > gpu->slots() ? batches - gpu->slots() : 0; k < batches; ++k) {
+                const size_t begin = k * batch;
+                const size_t n = std::min(batch, total - begin);
+                const float* probabilities = gpu->wait(k % gpu->slots(), predicted.data());
+                writeRows(begin, n, predicted.data(), probabilities);
+            }
+            infer_time = std::chrono::steady_clock::now() - start;
+        }
+#endif
+
+        std::optional<PipelineTimes> stage_times;
+        if (pipeline_depth) {
+            stage_times = runPipelined(model, images, batch, pipeline_depth, buffers, metrics.get(), writeRows);
+            infer_time = (*stage_times)[kInfer];
+        }
+
+        for (size_t begin = 0; !gpu_slots && !pipeline_depth && begin < total; begin += batch) {
+            size_t n = std::min(batch, total - begin);
+
+            auto t0 = std::chrono::steady_clock::now();
+            if (pool) {
+                grayToTensor(images.sample(begin), n * MNIST_IMAGE_SIZE, pool_input);
+                for (size_t i = 0; i < n; ++i) {
+                    pending[i] = pool->Submit(pool_input + i * MNIST_IMAGE_SIZE);
+                }
+                for (size_t i = 0; i < n; ++i) {
+                    Prediction p = pending[i].get();
+                    predicted[i] = p.digit;
+                    std::copy(p.probabilities.begin(), p.probabilities.end(), results.get() + i * MNIST_CLASSES);
+                }
+            } else {
+                model.visitInputType([&](auto* tag) {
+                    using T = std::remove_pointer_t<decltype(tag)>;
+                    T* typed = reinterpret_cast<T*>(input.get());
+                    grayToTensor(images.sample(begin), n * MNIST_IMAGE_SIZE, typed);
+                    if (bound && n == batch) {
+                        model.Run(*bound, predicted.data());
+                    } else {
+                        model.RunBatch(typed, n, results.get(), predicted.data());
+                    }
+                });
+            }
+            infer_time += std::chrono::steady_clock::now() - t0;
+            writeRows(begin, n, predicted.data(), results.get());
+        }
+        out.flush();
+
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double infer = std::chrono::duration<double>(infer_time).count();
+        std::cerr << "Scored " << total << " images in " << wall << " s\n"
+                  << "  inference: " << (infer > 0 ? total / infer : 0.0) << " images/sec\n"
+                  << "  end-to-end: " << (wall > 0 ? total / wall : 0.0) << " images/sec" << std::endl;
+        if (stage_times) {
+            // 各阶段忙碌时间占墙钟时间的比例：瓶颈阶段接近 100%，其余阶段与它重叠
+            static const char* const names[kPipelineStages] = {"load", "preprocess", "infer", "postprocess", "write"};
+            std::cerr << "  pipeline busy:";
+            for (int s = 0; s < kPipelineStages; ++s) {
+                const double busy = std::chrono::duration<double>((*stage_times)[s]).count();
+                std::cerr << ' ' << names[s] << ' ' << (wall > 0 ? 100.0 * busy / wall : 0.0) << '%';
+            }
+            std::cerr << std::endl;
+        }
+
+        reporter.reset();
+        if (metrics) {
+            metrics->writeSummary(std::cerr);
+        }
+        if (arena) {
+            arena->pool().writeSummary(std::cerr);
+        }
+        if (stats_path) {
+            if (!std::strcmp(stats_path, "-")) {
+                metrics->writePrometheus(std::cerr);
+            } else {
+                std::ofstream stats(stats_path);
+                metrics->writePrometheus(stats);
+                if (!stats) {
+                    std::cerr << "Cannot write " << stats_path << std::endl;
+                }
+            }
+        }
+        const std::string profile = model.onnx().endProfiling();
+        if (!profile.empty()) {
+            std::cerr << "ORT profile written to " << profile << std::endl;
+        }
+    } catch(const Ort::Exception& e) {
+        std::cerr << "ONNX Runtime error: " << e.what() << std::endl;
+        return -1;
+    } catch(const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
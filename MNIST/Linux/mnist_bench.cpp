@@ -0,0 +1,787 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <optional>
+#include <memory>
+#include <type_traits>
+#include <array>
+#include <thread>
+#include <exception>
+
+#include <sys/resource.h>
+
+#include "MNISTModel.h"
+#include "ModelRegistry.h"
+#include "IdxFile.h"
+
+//--------------------------------------------------------------------
+// 基准测试：分别测量 convertImage、Run()、softmax 与端到端流水线，
+// 扫描 batch 大小与线程数，输出延迟分位数、吞吐与峰值 RSS（表格 + JSON）；
+// 也可在带标签的数据集上对比 fp32 / fp16 / int8 模型与各前处理方式的准确率与吞吐
+//--------------------------------------------------------------------
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --model <path>   ONNX model (default: mnist_batch.onnx)\n"
+              << "  --batches <list> comma-separated batch sizes (default: 1,8,32,128)\n"
+              << "  --threads <list> comma-separated intra-op thread counts (default: 1,2,4)\n"
+              << "  --warmup <n>     untimed iterations before each case (default: 50)\n"
+              << "  --iters <n>      timed iterations per case (default: 1000)\n"
+              << "  --json <path>    also write the results as JSON ('-' for stdout)\n"
+              << "  --precision <p>  benchmark the bundled fp32, fp16 or int8 model instead of --model\n"
+              << "  --eval-images <idx> --eval-labels <idx>\n"
+              << "                   compare accuracy and throughput of each --precisions model\n"
+              << "                   on a labelled MNIST set (batch = first of --batches)\n"
+              << "  --eval <dir>     same, with t10k-images-idx3-ubyte and t10k-labels-idx1-ubyte from dir\n"
+              << "  --precisions <list> precisions to compare (default: fp32,fp16,int8)\n"
+              << "  --preprocess <list> with --eval-*, also draw each image on a canvas and score the first precision\n"
+              << "                   after these resampling modes (default: nearest,area,centered; 'none' to skip)\n"
+              << "  --shards <n>     with --eval-*, evaluate on n threads sharing the session (default: all cores)\n"
+              << "  --cascade <p|path> with --eval-*, also run a cascade of this first-stage model\n"
+              << "                   in front of the first --precisions model and report the fallback rate\n"
+              << "  --thresholds <list> first-stage confidence thresholds to try (default: 0.9)\n"
+              << sessionFlagsUsage();
+}
+
+static std::vector<size_t> parseList(const char* list) {
+    std::vector<size_t> values;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t v = std::strtoul(item.c_str(), nullptr, 10);
+        if (v > 0) values.push_back(v);
+    }
+    return values;
+}
+
+// 进程迄今的峰值 RSS（KB，Linux 上 ru_maxrss 即以 KB 计）
+static long peakRssKb() {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct BenchResult {
+    std::string stage;
+    size_t batch = 1;
+    int threads = 0;           // 0 = 与线程数无关（单线程的前/后处理）
+    size_t iterations = 0;
+    double p50 = 0, p90 = 0, p99 = 0, p999 = 0;  // 每次调用的延迟（微秒）
+    double images_per_sec = 0;
+    long peak_rss_kb = 0;
+};
+
+// 先 warmup 次不计时，再计时 iters 次；每个样本连续调用 reps 次取平均，
+// 让极短的核函数（softmax 每行约几十纳秒）不被计时开销淹没
+template <typename Fn>
+static BenchResult measure(const std::string& stage, size_t batch, int threads,
+                           size_t warmup, size_t iters, size_t reps, Fn&& fn) {
+    using Clock = std::chrono::steady_clock;
+    for (size_t i = 0; i < warmup; ++i) {
+        fn();
+    }
+
+    std::vector<double> samples(iters);
+    double total = 0;
+    for (size_t i = 0; i < iters; ++i) {
+        auto t0 = Clock::now();
+        for (size_t r = 0; r < reps; ++r) {
+            fn();
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+        total += us;
+        samples[i] = us / reps;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    // 最近秩法求分位数
+    auto percentile = [&](double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p * samples.size()));
+        return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+    };
+
+    BenchResult r;
+    r.stage = stage;
+    r.batch = batch;
+    r.threads = threads;
+    r.iterations = iters;
+    r.p50 = percentile(0.50);
+    r.p90 = percentile(0.90);
+    r.p99 = percentile(0.99);
+    r.p999 = percentile(0.999);
+    r.images_per_sec = total > 0 ? batch * iters * reps / (total * 1e-6) : 0.0;
+    r.peak_rss_kb = peakRssKb();
+    return r;
+}
+
+// 合成一张与画板同尺寸的 RGBA8888 画布：白底上一个粗黑圆环（数字 0）
+static std::vector<uint8_t> makeCanvas(int width, int height) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4, 0xff);
+    const float cx = width * 0.5f, cy = height * 0.5f;
+    const float radius = std::min(width, height) * 0.3f, thickness = 12.0f;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float d = std::hypot(x - cx, y - cy);
+            if (std::fabs(d - radius) < thickness) {
+                uint8_t* p = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+                // 只把 R/G/B 置零，A 保持 255（RGBA8888 的打包方式与字节序无关）
+                uint32_t v = 0x000000ff;
+                std::memcpy(p, &v, 4);
+            }
+        }
+    }
+    return pixels;
+}
+
+static void printTable(const std::vector<BenchResult>& results) {
+    std::cout << std::left << std::setw(14) << "stage" << std::right
+              << std::setw(7) << "batch" << std::setw(9) << "threads"
+              << std::setw(11) << "p50(us)" << std::setw(11) << "p90(us)"
+              << std::setw(11) << "p99(us)" << std::setw(11) << "p999(us)"
+              << std::setw(14) << "images/sec" << std::setw(12) << "peakRSS(KB)" << '\n';
+    const std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed;
+    for (const BenchResult& r : results) {
+        std::cout << std::left << std::setw(14) << r.stage << std::right
+                  << std::setw(7) << r.batch << std::setw(9)
+                  << (r.threads > 0 ? std::to_string(r.threads) : std::string("-"))
+                  << std::setprecision(2)
+                  << std::setw(11) << r.p50 << std::setw(11) << r.p90
+                  << std::setw(11) << r.p99 << std::setw(11) << r.p999
+                  << std::setprecision(0)
+                  << std::setw(14) << r.images_per_sec << std::setw(12) << r.peak_rss_kb << '\n';
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+}
+
+static void writeJson(std::ostream& out, const std::vector<BenchResult>& results) {
+    out << std::setprecision(6) << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << "  {\"stage\": \"" << r.stage << "\", \"batch\": " << r.batch
+            << ", \"threads\": " << r.threads << ", \"iterations\": " << r.iterations
+            << ", \"p50_us\": " << r.p50 << ", \"p90_us\": " << r.p90
+            << ", \"p99_us\": " << r.p99 << ", \"p999_us\": " << r.p999
+            << ", \"images_per_sec\": " << r.images_per_sec
+            << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]" << std::endl;
+}
+
+// JSON 写到 path（"-" 为 stdout，nullptr 为不写）；返回 main 的退出码
+template <typename Fn>
+static int writeOutput(const char* path, Fn&& write) {
+    if (!path) {
+        return 0;
+    }
+    if (!std::strcmp(path, "-")) {
+        write(std::cout);
+        return 0;
+    }
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return -1;
+    }
+    write(file);
+    return 0;
+}
+
+//--------------------------------------------------------------------
+// 精度对比：在带标签的 IDX 数据集上逐个精度跑完整推理，
+// 报告准确率、混淆矩阵、与 fp32 的一致率和吞吐；级联另报回落到完整模型的比例。
+// 数据集按连续区间分片到多个线程，各线程在同一个会话上并发 RunBatch。
+// 前处理对比把每张测试图放大画到画板尺寸的画布上，再按各缩放方式缩回 28×28
+//--------------------------------------------------------------------
+struct CompareResult {
+    std::string precision;
+    std::string model;
+    std::string input = "idx";  // idx = 直接用 28×28 像素，否则为 <前处理方式>@<画布尺寸>
+    bool available = false;
+    size_t images = 0;
+    double accuracy = 0;
+    double agreement = -1;     // 与第一个精度（通常是 fp32）预测一致的比例，-1 = 无参照
+    double images_per_sec = 0; // 全部分片一起的吞吐：图像数 / 最忙分片的计时部分之和
+    double p50 = 0, p99 = 0;   // 每批的延迟（微秒，含转换为模型输入，不含画布的绘制）
+    double fallback_rate = -1; // 级联中回落到完整模型的比例，-1 = 非级联
+    // confusion[真实标签][预测]
+    std::array<std::array<uint32_t, MNIST_CLASSES>, MNIST_CLASSES> confusion{};
+};
+
+struct EvalOptions {
+    size_t batch = 32;
+    size_t warmup = 0;
+    // 并发评估的线程数
+    size_t shards = 1;
+    // 前处理对比所用的画布尺寸
+    int canvas_width = 0;
+    int canvas_height = 0;
+};
+
+// 精度名或模型路径 → 模型路径
+static std::string precisionModel(const std::string& precision) {
+    const char* path = mnistModelForPrecision(precision);
+    return path ? path : precision;
+}
+
+static const char* preprocessName(MNISTModel::PreprocessMode mode) {
+    switch (mode) {
+    case MNISTModel::PreprocessMode::Nearest: return "nearest";
+    case MNISTModel::PreprocessMode::Area: return "area";
+    case MNISTModel::PreprocessMode::Centered: return "centered";
+    }
+    return "?";
+}
+
+static bool parsePreprocessMode(const std::string& name, MNISTModel::PreprocessMode& mode) {
+    for (auto m : {MNISTModel::PreprocessMode::Nearest, MNISTModel::PreprocessMode::Area,
+                   MNISTModel::PreprocessMode::Centered}) {
+        if (name == preprocessName(m)) {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 加载失败（如 fp16 模型在没有 fp16 CPU 内核的 x86 上无法创建会话）时返回空指针
+static std::shared_ptr<MNISTModel> tryLoad(ModelRegistry<>& registry, const std::string& name, const std::string& path,
+                                           const SessionConfig& session) {
+    try {
+        return registry.load(name, path.c_str(), session);
+    } catch (const std::exception& e) {
+        std::cerr << name << ": " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+// 把 28×28 的数字双线性放大到画布的高度（保持宽高比、水平居中），写成 Gray8 画布（0 = 背景），
+// 模拟在画板上写出的数字
+static void renderCanvas(const uint8_t* digit, int width, int height, uint8_t* canvas) {
+    std::memset(canvas, 0, static_cast<size_t>(width) * height);
+    const int side = std::min(width, height);
+    const int left = (width - side) / 2, top = (height - side) / 2;
+    const float scale = static_cast<float>(MNIST_WIDTH) / side;
+    auto tap = [](float f, int& i0, int& i1, float& t) {
+        f = std::min(std::max(f, 0.0f), MNIST_WIDTH - 1.0f);
+        i0 = static_cast<int>(f);
+        i1 = std::min(i0 + 1, MNIST_WIDTH - 1);
+        t = f - i0;
+    };
+    for (int y = 0; y < side; ++y) {
+        int y0, y1;
+        float ty;
+        tap((y + 0.5f) * scale - 0.5f, y0, y1, ty);
+        uint8_t* row = canvas + static_cast<size_t>(top + y) * width + left;
+        for (int x = 0; x < side; ++x) {
+            int x0, x1;
+            float tx;
+            tap((x + 0.5f) * scale - 0.5f, x0, x1, tx);
+            const float upper = digit[y0 * MNIST_WIDTH + x0] + tx * (digit[y0 * MNIST_WIDTH + x1] - digit[y0 * MNIST_WIDTH + x0]);
+            const float lower = digit[y1 * MNIST_WIDTH + x0] + tx * (digit[y1 * MNIST_WIDTH + x1] - digit[y1 * MNIST_WIDTH + x0]);
+            row[x] = static_cast<uint8_t>(upper + ty * (lower - upper) + 0.5f);
+        }
+    }
+}
+
+// 在整个数据集上按 batch 跑 model，填写 r 的准确率、混淆矩阵、一致率、吞吐与延迟。
+// canvas_mode 非空时每张图先画到画布上，再以该方式缩放为模型输入
+static void evaluate(MNISTModel& model, CompareResult& r, const IdxFile& images, const IdxFile& labels,
+                     const EvalOptions& options, std::vector<int>& reference,
+                     std::optional<MNISTModel::PreprocessMode> canvas_mode = std::nullopt) {
+    r.available = true;
+    const size_t total = images.count();
+    const size_t batch = options.batch;
+    const size_t shards = std::max<size_t>(1, std::min(options.shards, (total + batch - 1) / batch));
+    std::vector<int> predicted(total);
+    std::vector<std::vector<double>> samples(shards);
+    std::vector<std::exception_ptr> errors(shards);
+    // 预热也经过级联，只统计计时部分的回落
+    uint64_t cascade_images = 0, cascade_fallbacks = 0;
+
+    model.visitInputType([&](auto* tag) {
+        using T = std::remove_pointer_t<decltype(tag)>;
+        // 每个分片有自己的缓冲与缩放器（缩放器带有中间状态），会话是共用的
+        auto runRange = [&](size_t begin, size_t end, std::vector<double>* latencies) {
+            AlignedBuffer<T> input = allocAligned<T>(batch * MNIST_IMAGE_SIZE);
+            AlignedFloats output = allocAligned(batch * MNIST_CLASSES);
+            AreaResampler<MNIST_WIDTH, MNIST_HEIGHT> area;
+            CenteringResampler<MNIST_WIDTH, MNIST_HEIGHT, 20> centering;
+            std::vector<uint8_t> canvas(canvas_mode ? static_cast<size_t>(options.canvas_width) * options.canvas_height : 0);
+            for (size_t first = begin; first < end; first += batch) {
+                const size_t n = std::min(batch, end - first);
+                std::chrono::steady_clock::duration elapsed{};
+                if (!canvas_mode) {
+                    const auto t0 = std::chrono::steady_clock::now();
+                    grayToTensor(images.sample(first), n * MNIST_IMAGE_SIZE, input.get());
+                    elapsed += std::chrono::steady_clock::now() - t0;
+                } else {
+                    for (size_t i = 0; i < n; ++i) {
+                        renderCanvas(images.sample(first + i), options.canvas_width, options.canvas_height, canvas.data());
+                        const auto t0 = std::chrono::steady_clock::now();
+                        T* dst = input.get() + i * MNIST_IMAGE_SIZE;
+                        const int w = options.canvas_width, h = options.canvas_height;
+                        if (*canvas_mode == MNISTModel::PreprocessMode::Area) {
+                            area(canvas.data(), w, h, dst, PixelFormat::Gray8);
+                        } else if (*canvas_mode == MNISTModel::PreprocessMode::Centered) {
+                            centering(canvas.data(), w, h, dst, PixelFormat::Gray8);
+                        } else {
+                            area.nearest(canvas.data(), w, h, dst, PixelFormat::Gray8);
+                        }
+                        elapsed += std::chrono::steady_clock::now() - t0;
+                    }
+                }
+                const auto t0 = std::chrono::steady_clock::now();
+                model.RunBatch(input.get(), n, output.get(), predicted.data() + first);
+                elapsed += std::chrono::steady_clock::now() - t0;
+                if (latencies) {
+                    latencies->push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+                }
+            }
+        };
+
+        runRange(0, std::min(total, options.warmup * batch), nullptr);
+        cascade_images = model.cascadeImages();
+        cascade_fallbacks = model.cascadeFallbacks();
+
+        // 按整批切分区间，分片边界不会切碎一个 batch
+        const size_t batches = (total + batch - 1) / batch;
+        std::vector<std::thread> threads;
+        for (size_t s = 0; s < shards; ++s) {
+            const size_t begin = std::min(total, batches * s / shards * batch);
+            const size_t end = std::min(total, batches * (s + 1) / shards * batch);
+            threads.emplace_back([&, s, begin, end] {
+                try {
+                    runRange(begin, end, &samples[s]);
+                } catch (...) {
+                    errors[s] = std::current_exception();
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+    });
+    for (const std::exception_ptr& e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+
+    size_t correct = 0, agreed = 0;
+    for (size_t i = 0; i < total; ++i) {
+        const int label = labels.sample(i)[0];
+        correct += predicted[i] == label;
+        if (label < MNIST_CLASSES && predicted[i] >= 0 && predicted[i] < MNIST_CLASSES) {
+            ++r.confusion[label][predicted[i]];
+        }
+        if (!reference.empty()) agreed += predicted[i] == reference[i];
+    }
+    if (reference.empty()) {
+        reference = predicted;
+    } else {
+        r.agreement = static_cast<double>(agreed) / total;
+    }
+
+    // 分片并行运行，吞吐由最忙的分片决定；画布的绘制不计入
+    std::vector<double> merged;
+    double busiest = 0;
+    for (const std::vector<double>& shard : samples) {
+        merged.insert(merged.end(), shard.begin(), shard.end());
+        double busy = 0;
+        for (double us : shard) busy += us;
+        busiest = std::max(busiest, busy);
+    }
+    std::sort(merged.begin(), merged.end());
+    r.images = total;
+    r.accuracy = static_cast<double>(correct) / total;
+    r.images_per_sec = busiest > 0 ? total / (busiest * 1e-6) : 0.0;
+    r.p50 = merged[merged.size() / 2];
+    r.p99 = merged[std::min(merged.size() - 1, merged.size() * 99 / 100)];
+    if (model.first_stage_) {
+        const uint64_t screened = model.cascadeImages() - cascade_images;
+        r.fallback_rate = screened ? static_cast<double>(model.cascadeFallbacks() - cascade_fallbacks) / screened : 0.0;
+    }
+}
+
+static CompareResult comparePrecision(ModelRegistry<>& registry, const std::string& precision, const SessionConfig& session,
+                                      const IdxFile& images, const IdxFile& labels, const EvalOptions& options,
+                                      std::vector<int>& reference) {
+    CompareResult r;
+    r.precision = precision;
+    r.model = precisionModel(precision);
+    std::shared_ptr<MNISTModel> model = tryLoad(registry, precision, r.model, session);
+    if (model) {
+        model->compute_probabilities_ = false;
+        evaluate(*model, r, images, labels, options, reference);
+    }
+    return r;
+}
+
+// 同一精度的模型，输入改为画布经 mode 缩放的结果；一致率以第一个精度在 28×28 原图上的预测为参照
+static CompareResult comparePreprocess(ModelRegistry<>& registry, const std::string& precision,
+                                       MNISTModel::PreprocessMode mode, const SessionConfig& session,
+                                       const IdxFile& images, const IdxFile& labels, const EvalOptions& options,
+                                       std::vector<int>& reference) {
+    CompareResult r;
+    r.precision = precision;
+    r.model = precisionModel(precision);
+    std::ostringstream input;
+    input << preprocessName(mode) << '@' << options.canvas_width << 'x' << options.canvas_height;
+    r.input = input.str();
+    std::shared_ptr<MNISTModel> model = registry.get(precision);
+    if (!model) {
+        model = tryLoad(registry, precision, r.model, session);
+    }
+    if (model) {
+        model->compute_probabilities_ = false;
+        evaluate(*model, r, images, labels, options, reference, mode);
+    }
+    return r;
+}
+
+// 级联：first 先预测，最大概率低于 threshold 的图像再交给 full；一致率仍以第一个精度为参照
+static CompareResult compareCascade(ModelRegistry<>& registry, const std::string& first, const std::string& full,
+                                    float threshold, const SessionConfig& session, const IdxFile& images,
+                                    const IdxFile& labels, const EvalOptions& options, std::vector<int>& reference) {
+    CompareResult r;
+    r.precision = "cascade";
+    std::ostringstream name;
+    name << first << " > " << full << " @" << threshold;
+    r.model = name.str();
+
+    std::shared_ptr<MNISTModel> first_stage = tryLoad(registry, "cascade:" + first, precisionModel(first), session);
+    std::shared_ptr<MNISTModel> model = tryLoad(registry, "cascade:" + full, precisionModel(full), session);
+    if (first_stage && model) {
+        model->compute_probabilities_ = false;
+        model->first_stage_ = first_stage.get();
+        model->confidence_threshold_ = threshold;
+        try {
+            evaluate(*model, r, images, labels, options, reference);
+        } catch (const std::exception& e) {
+            // 如 fp16 模型不能以其他类型的模型为第一级
+            std::cerr << r.model << ": " << e.what() << std::endl;
+            r.available = false;
+        }
+    }
+    return r;
+}
+
+static void printCompare(const std::vector<CompareResult>& results) {
+    std::cout << std::left << std::setw(11) << "precision" << std::setw(26) << "model" << std::setw(22) << "input"
+              << std::right
+              << std::setw(10) << "accuracy" << std::setw(11) << "agreement"
+              << std::setw(14) << "images/sec" << std::setw(11) << "p50(us)" << std::setw(11) << "p99(us)"
+              << std::setw(10) << "fallback" << '\n';
+    const std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed;
+    for (const CompareResult& r : results) {
+        std::cout << std::left << std::setw(11) << r.precision << std::setw(26) << r.model << std::setw(22) << r.input
+                  << std::right;
+        if (!r.available) {
+            std::cout << std::setw(10) << "n/a" << '\n';
+            continue;
+        }
+        std::cout << std::setprecision(4) << std::setw(10) << r.accuracy;
+        if (r.agreement >= 0) {
+            std::cout << std::setw(11) << r.agreement;
+        } else {
+            std::cout << std::setw(11) << "-";
+        }
+        std::cout << std::setprecision(0) << std::setw(14) << r.images_per_sec
+                  << std::setprecision(2) << std::setw(11) << r.p50 << std::setw(11) << r.p99;
+        if (r.fallback_rate >= 0) {
+            std::cout << std::setprecision(4) << std::setw(10) << r.fallback_rate;
+        } else {
+            std::cout << std::setw(10) << "-";
+        }
+        std::cout << '\n';
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+}
+
+static void printConfusion(const CompareResult& r) {
+    std::cout << "\nconfusion matrix of " << r.precision << " on " << r.input << " (rows: label, columns: predicted)\n"
+              << std::setw(6) << "";
+    for (int c = 0; c < MNIST_CLASSES; ++c) std::cout << std::setw(6) << c;
+    std::cout << '\n';
+    for (int label = 0; label < MNIST_CLASSES; ++label) {
+        std::cout << std::setw(6) << label;
+        for (int c = 0; c < MNIST_CLASSES; ++c) std::cout << std::setw(6) << r.confusion[label][c];
+        std::cout << '\n';
+    }
+}
+
+static void writeCompareJson(std::ostream& out, const std::vector<CompareResult>& results) {
+    out << std::setprecision(6) << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const CompareResult& r = results[i];
+        out << "  {\"precision\": \"" << r.precision << "\", \"model\": \"" << r.model
+            << "\", \"input\": \"" << r.input << "\", \"available\": " << (r.available ? "true" : "false");
+        if (r.available) {
+            out << ", \"images\": " << r.images << ", \"accuracy\": " << r.accuracy;
+            if (r.agreement >= 0) out << ", \"agreement\": " << r.agreement;
+            out << ", \"images_per_sec\": " << r.images_per_sec
+                << ", \"p50_us\": " << r.p50 << ", \"p99_us\": " << r.p99;
+            if (r.fallback_rate >= 0) out << ", \"fallback_rate\": " << r.fallback_rate;
+            out << ", \"confusion\": [";
+            for (int label = 0; label < MNIST_CLASSES; ++label) {
+                out << (label ? ", [" : "[");
+                for (int c = 0; c < MNIST_CLASSES; ++c) out << (c ? ", " : "") << r.confusion[label][c];
+                out << "]";
+            }
+            out << "]";
+        }
+        out << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* model_path = "mnist_batch.onnx";
+    const char* json_path = nullptr;
+    const char* eval_images = nullptr;
+    const char* eval_labels = nullptr;
+    std::string eval_dir;
+    std::vector<std::string> precisions = {"fp32", "fp16", "int8"};
+    std::vector<MNISTModel::PreprocessMode> preprocess = {
+        MNISTModel::PreprocessMode::Nearest, MNISTModel::PreprocessMode::Area, MNISTModel::PreprocessMode::Centered};
+    size_t shards = std::max(1u, std::thread::hardware_concurrency());
+    const char* cascade = nullptr;
+    std::vector<float> thresholds = {0.9f};
+    std::vector<size_t> batches = {1, 8, 32, 128};
+    std::vector<size_t> threads = {1, 2, 4};
+    size_t warmup = 50;
+    size_t iters = 1000;
+    SessionConfig session;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--model") && i + 1 < argc) {
+            model_path = argv[++i];
+        } else if (!std::strcmp(argv[i], "--batches") && i + 1 < argc) {
+            batches = parseList(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = parseList(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--warmup") && i + 1 < argc) {
+            warmup = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--iters") && i + 1 < argc) {
+            iters = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--json") && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (!std::strcmp(argv[i], "--precision") && i + 1 < argc) {
+            model_path = mnistModelForPrecision(argv[++i]);
+            if (!model_path) {
+                usage(argv[0]);
+                return -1;
+            }
+        } else if (!std::strcmp(argv[i], "--eval-images") && i + 1 < argc) {
+            eval_images = argv[++i];
+        } else if (!std::strcmp(argv[i], "--eval-labels") && i + 1 < argc) {
+            eval_labels = argv[++i];
+        } else if (!std::strcmp(argv[i], "--eval") && i + 1 < argc) {
+            eval_dir = argv[++i];
+        } else if (!std::strcmp(argv[i], "--preprocess") && i + 1 < argc) {
+            preprocess.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                MNISTModel::PreprocessMode mode;
+                if (item == "none" || item.empty()) {
+                    continue;
+                } else if (!parsePreprocessMode(item, mode)) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                preprocess.push_back(mode);
+            }
+        } else if (!std::strcmp(argv[i], "--shards") && i + 1 < argc) {
+            shards = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--precisions") && i + 1 < argc) {
+            precisions.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (!item.empty()) precisions.push_back(item);
+            }
+        } else if (!std::strcmp(argv[i], "--cascade") && i + 1 < argc) {
+            cascade = argv[++i];
+        } else if (!std::strcmp(argv[i], "--thresholds") && i + 1 < argc) {
+            thresholds.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                if (!item.empty()) thresholds.push_back(std::strtof(item.c_str(), nullptr));
+            }
+        } else if (parseSessionFlag(argc, argv, i, session)) {
+            continue;
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    // 官方测试集的文件名
+    const std::string eval_dir_images = eval_dir + "/t10k-images-idx3-ubyte";
+    const std::string eval_dir_labels = eval_dir + "/t10k-labels-idx1-ubyte";
+    if (!eval_dir.empty() && !eval_images && !eval_labels) {
+        eval_images = eval_dir_images.c_str();
+        eval_labels = eval_dir_labels.c_str();
+    }
+    if (batches.empty() || threads.empty() || iters == 0 || precisions.empty() || !eval_images != !eval_labels ||
+        (cascade && (!eval_images || thresholds.empty())) || shards == 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    // 与画板演示相同的画布尺寸
+    const int canvas_width = 280;
+    const int canvas_height = 224;
+    const std::vector<uint8_t> canvas = makeCanvas(canvas_width, canvas_height);
+    const size_t max_batch = *std::max_element(batches.begin(), batches.end());
+
+    std::vector<BenchResult> results;
+    try {
+        // 按 float 的大小分配，足以容纳任一种输入类型
+        AlignedBuffer<uint8_t> input = allocAligned<uint8_t>(max_batch * MNIST_IMAGE_SIZE * sizeof(float));
+        AlignedFloats output = allocAligned(max_batch * MNIST_CLASSES);
+        AlignedFloats logits = allocAligned(max_batch * MNIST_CLASSES);
+        std::vector<int> predicted(max_batch);
+
+        if (eval_images) {
+            IdxFile images(eval_images);
+            IdxFile labels(eval_labels);
+            if (images.sampleSize() != MNIST_IMAGE_SIZE || labels.sampleSize() != 1 || labels.count() < images.count()) {
+                std::cerr << "Expected 28x28 images and one label per image" << std::endl;
+                return -1;
+            }
+            EvalOptions options;
+            options.batch = batches.front();
+            options.warmup = warmup;
+            options.shards = shards;
+            options.canvas_width = canvas_width;
+            options.canvas_height = canvas_height;
+            // 分片各自调用 Run，未指定时把核心平分给它们，避免超额订阅
+            if (session.intra_op_threads <= 0) {
+                const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+                session.intra_op_threads = static_cast<int>(std::max<size_t>(1, cores / shards));
+            }
+            // 各精度的模型同时驻留在一个注册表里，共用全局线程池
+            ModelRegistry<> registry(session.intra_op_threads, session.inter_op_threads);
+            std::vector<CompareResult> compared;
+            std::vector<int> reference;
+            for (const std::string& precision : precisions) {
+                compared.push_back(comparePrecision(registry, precision, session, images, labels, options, reference));
+            }
+            for (MNISTModel::PreprocessMode mode : preprocess) {
+                compared.push_back(comparePreprocess(registry, precisions.front(), mode, session, images, labels, options,
+                                                     reference));
+            }
+            if (cascade) {
+                for (float threshold : thresholds) {
+                    compared.push_back(compareCascade(registry, cascade, precisions.front(), threshold, session, images,
+                                                      labels, options, reference));
+                }
+            }
+            printCompare(compared);
+            for (const CompareResult& r : compared) {
+                if (r.available) {
+                    printConfusion(r);
+                    break;
+                }
+            }
+            return writeOutput(json_path, [&](std::ostream& out) { writeCompareJson(out, compared); });
+        }
+
+        for (size_t t : threads) {
+            session.intra_op_threads = static_cast<int>(t);
+            MNISTModel model(model_path, session);
+            const bool first = t == threads.front();
+
+            // 前处理直接写出模型的输入类型
+            model.visitInputType([&](auto* tag) {
+                using T = std::remove_pointer_t<decltype(tag)>;
+                T* typed = reinterpret_cast<T*>(input.get());
+
+                // 前处理与 softmax 都是单线程的，与 intra-op 线程数无关，只测一次
+                if (first) {
+                    model.preprocess_mode_ = MNISTModel::PreprocessMode::Area;
+                    results.push_back(measure("convert_area", 1, 0, warmup, iters, 16, [&] {
+                        model.convertImage(canvas.data(), canvas_width, canvas_height, typed);
+                    }));
+                    model.preprocess_mode_ = MNISTModel::PreprocessMode::Nearest;
+                    results.push_back(measure("convert_near", 1, 0, warmup, iters, 16, [&] {
+                        model.convertImage(canvas.data(), canvas_width, canvas_height, typed);
+                    }));
+                    model.preprocess_mode_ = MNISTModel::PreprocessMode::Centered;
+                    results.push_back(measure("convert_center", 1, 0, warmup, iters, 16, [&] {
+                        model.convertImage(canvas.data(), canvas_width, canvas_height, typed);
+                    }));
+                    model.preprocess_mode_ = MNISTModel::PreprocessMode::Area;
+
+                    std::mt19937 rng(42);
+                    std::normal_distribution<float> dist(0.0f, 4.0f);
+                    std::vector<float> source(max_batch * MNIST_CLASSES);
+                    for (float& v : source) v = dist(rng);
+                    for (size_t b : batches) {
+                        // 每次先恢复 logits（10×b 个 float 的拷贝，相对 exp 可忽略）
+                        results.push_back(measure("softmax", b, 0, warmup, iters, 16, [&] {
+                            std::memcpy(logits.get(), source.data(), b * MNIST_CLASSES * sizeof(float));
+                            softmaxArgmax<MNIST_CLASSES>(logits.get(), b, predicted.data());
+                        }));
+                    }
+                }
+
+                for (size_t b : batches) {
+                    for (size_t i = 0; i < b; ++i) {
+                        model.convertImage(canvas.data(), canvas_width, canvas_height, typed + i * MNIST_IMAGE_SIZE);
+                    }
+                    std::optional<MNISTModel::Binding> bound;
+                    if (model.acceptsBatch(b)) {
+                        bound = model.Bind(typed, output.get(), b);
+                    }
+                    auto infer = [&] {
+                        if (bound) {
+                            model.Run(*bound, predicted.data());
+                        } else {
+                            model.RunBatch(typed, b, output.get(), predicted.data());
+                        }
+                    };
+
+                    // Run：只含 ORT 推理与 argmax（关闭 softmax）
+                    model.compute_probabilities_ = false;
+                    results.push_back(measure("run", b, static_cast<int>(t), warmup, iters, 1, infer));
+
+                    // 端到端：b 张画布逐张预处理 → 推理 → softmax
+                    model.compute_probabilities_ = true;
+                    results.push_back(measure("end_to_end", b, static_cast<int>(t), warmup, iters, 1, [&] {
+                        for (size_t i = 0; i < b; ++i) {
+                            model.convertImage(canvas.data(), canvas_width, canvas_height, typed + i * MNIST_IMAGE_SIZE);
+                        }
+                        infer();
+                    }));
+                }
+            });
+        }
+    } catch(const Ort::Exception& e) {
+        std::cerr << "ONNX Runtime error: " << e.what() << std::endl;
+        return -1;
+    } catch(const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+
+    printTable(results);
+    return writeOutput(json_path, [&](std::ostream& out) { writeJson(out, results); });
+}
@@ -0,0 +1,443 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+
+#include <pthread.h>
+#include <signal.h>
+
+#include "MNISTModel.h"
+#include "InferencePool.h"
+#include "HttpServer.h"
+#include "ShmServer.h"
+#include "Metrics.h"
+
+//--------------------------------------------------------------------
+// HTTP 推理服务。请求体为原始的 28×28 图像：默认是 u8 像素（0 = 背景），
+// Content-Type 为 application/x-mnist-f32 时为小端 float32（[0,1]）。
+//   POST /predict         一张图像
+//   POST /predict/batch   连续的多张图像
+//   POST /predict/digits?width=W&height=H  一张 W×H 的 u8 灰度画布，切分出其中的多个数字
+//   GET  /healthz         存活检查
+//   GET  /metrics         Prometheus 格式的各阶段耗时、队列长度与拒绝次数
+// float 图像从连接的请求体缓冲原地提交给 InferencePool（可开微批），不经拷贝即由工作线程
+// 取入批缓冲区；u8 图像在提交时转换。结果以 JSON 返回。
+// 推理队列满时返回 503 + Retry-After，由客户端退避重试。
+// 指定 --shm 时同机进程还可经共享内存通道（见 ShmTransport.h）提交图像，不走套接字
+//--------------------------------------------------------------------
+static_assert(kShmImageSize == MNIST_IMAGE_SIZE, "shared-memory slots must hold one MNIST image");
+
+static const char* const kFloatContentType = "application/x-mnist-f32";
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --bind <addr>    listen address (default: 0.0.0.0)\n"
+              << "  --port <n>       listen port (default: 8080)\n"
+              << "  --max-connections <n> concurrent connections before new ones get 503 (default: 64)\n"
+              << "  --max-images <n> largest /predict/batch request in images (default: 256)\n"
+              << "  --model <path>   ONNX model (default: mnist_batch.onnx, built in when embedded)\n"
+              << "  --precision <p>  use the bundled fp32, fp16 or int8 model instead of --model\n"
+              << "  --workers <n>    inference threads (default: all cores)\n"
+              << "  --queue <n>      queued images before requests get 503, a power of two (default: 1024)\n"
+              << "  --max-batch <n>  micro-batch up to n queued images per Run (default: 16)\n"
+              << "  --max-wait-us <t> flush a micro-batch after t us (default: 500)\n"
+              << "  --cache <n>      answer repeated images from an LRU of the last n results\n"
+              << "  --arena <MiB>    serve tensors, batch buffers and request state from a pool primed at startup,\n"
+              << "                   capped at MiB (0 = no cap)\n"
+              << "  --shm <name>     also serve co-located clients over shared memory (e.g. /mnist)\n"
+              << "  --shm-lanes <n>  shared-memory clients at once (default: 64)\n"
+              << "  --shm-depth <n>  requests in flight per shared-memory client, a power of two (default: 32)\n"
+              << sessionFlagsUsage();
+}
+
+// query 中 name=<非负整数> 的值，没有或不合法时返回 -1
+static long queryValue(const std::string& query, const char* name) {
+    const size_t len = std::strlen(name);
+    for (size_t start = 0; start < query.size();) {
+        size_t end = query.find('&', start);
+        if (end == std::string::npos) end = query.size();
+        if (end - start > len && !query.compare(start, len, name) && query[start + len] == '=') {
+            char* stop = nullptr;
+            const long value = std::strtol(query.c_str() + start + len + 1, &stop, 10);
+            return stop == query.c_str() + end && value >= 0 ? value : -1;
+        }
+        start = end + 1;
+    }
+    return -1;
+}
+
+static void appendPrediction(std::string& out, const Prediction& p, const DirtyRect* box = nullptr) {
+    char number[32];
+    out += "{\"digit\":";
+    out += std::to_string(p.digit);
+    out += ",\"probabilities\":[";
+    for (int c = 0; c < MNIST_CLASSES; ++c) {
+        std::snprintf(number, sizeof(number), c ? ",%.6g" : "%.6g", p.probabilities[c]);
+        out += number;
+    }
+    out += ']';
+    if (box) {
+        out += ",\"box\":[" + std::to_string(box->x0) + ',' + std::to_string(box->y0) + ',' +
+               std::to_string(box->x1) + ',' + std::to_string(box->y1) + ']';
+    }
+    out += '}';
+}
+
+// 一个请求中原地提交的各图像的结果（tag 为图像序号）；连接线程每次只处理一个请求，各线程复用一个
+struct RequestResults : PoolCompletion {
+    void reset(size_t n) {
+        std::lock_guard<std::mutex> lock(mutex);
+        predictions.resize(n);
+        errors.assign(n, nullptr);
+        finished = 0;
+    }
+
+    void complete(uint64_t tag, const Prediction& p) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        predictions[tag] = p;
+        ++finished;
+        done.notify_one();
+    }
+
+    void fail(uint64_t tag, std::exception_ptr error) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        errors[tag] = error;
+        ++finished;
+        done.notify_one();
+    }
+
+    // 等前 count 张已提交的图像都有结果
+    void wait(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return finished >= count; });
+    }
+
+    // 第 i 张图像的结果，推理失败时重新抛出其异常；须先 wait()
+    const Prediction& get(size_t i) const {
+        if (errors[i]) {
+            std::rethrow_exception(errors[i]);
+        }
+        return predictions[i];
+    }
+
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<Prediction> predictions;
+    std::vector<std::exception_ptr> errors;
+    size_t finished = 0;
+};
+
+int main(int argc, char* argv[])
+{
+    // 未指定时优先用编译进程序的模型
+    const char* model_path = nullptr;
+    HttpServer::Options http;
+    size_t max_images = 256;
+    InferencePool::Options pool_options;
+    pool_options.max_batch = 16;
+    pool_options.max_wait = std::chrono::microseconds(500);
+    long arena_mib = -1;
+    size_t cache_entries = 0;
+    ShmServer::Options shm_options;
+    bool shm = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--bind") && i + 1 < argc) {
+            http.address = argv[++i];
+        } else if (!std::strcmp(argv[i], "--port") && i + 1 < argc) {
+            http.port = std::atoi(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--max-connections") && i + 1 < argc) {
+            http.max_connections = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--max-images") && i + 1 < argc) {
+            max_images = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--model") && i + 1 < argc) {
+            model_path = argv[++i];
+        } else if (!std::strcmp(argv[i], "--precision") && i + 1 < argc) {
+            model_path = mnistModelForPrecision(argv[++i]);
+            if (!model_path) {
+                usage(argv[0]);
+                return -1;
+            }
+        } else if (!std::strcmp(argv[i], "--workers") && i + 1 < argc) {
+            pool_options.workers = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--queue") && i + 1 < argc) {
+            pool_options.queue_capacity = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--max-batch") && i + 1 < argc) {
+            pool_options.max_batch = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--max-wait-us") && i + 1 < argc) {
+            pool_options.max_wait = std::chrono::microseconds(std::strtoul(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--cache") && i + 1 < argc) {
+            cache_entries = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--arena") && i + 1 < argc) {
+            arena_mib = std::strtol(argv[++i], nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--shm") && i + 1 < argc) {
+            shm_options.name = argv[++i];
+            shm = true;
+        } else if (!std::strcmp(argv[i], "--shm-lanes") && i + 1 < argc) {
+            shm_options.lanes = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--shm-depth") && i + 1 < argc) {
+            shm_options.depth = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (parseSessionFlag(argc, argv, i, pool_options.session)) {
+            continue;
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    // 一个批量请求的所有图像须能同时放进队列，否则它永远得到 503
+    if (max_images == 0 || max_images > pool_options.queue_capacity) {
+        std::cerr << "--max-images must be between 1 and the queue capacity (" << pool_options.queue_capacity << ")"
+                  << std::endl;
+        return -1;
+    }
+    http.max_body = max_images * MNIST_IMAGE_SIZE * sizeof(float);
+
+    // 之后创建的线程（推理线程、连接线程）都继承这个信号掩码，SIGINT / SIGTERM 只由下面的线程接收
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    try {
+#ifdef MNIST_EMBEDDED_MODEL
+        const ModelSource source = model_path ? ModelSource(model_path) : embeddedModel();
+#else
+        const ModelSource source = model_path ? model_path : "mnist_batch.onnx";
+#endif
+        // arena 须先于线程池构造、晚于它析构
+        std::unique_ptr<TensorArena> arena;
+        if (arena_mib >= 0) {
+            arena = std::make_unique<TensorArena>(static_cast<size_t>(arena_mib) << 20);
+            pool_options.session.arena = arena.get();
+            http.buffers = &arena->pool();
+        }
+        std::unique_ptr<PredictionCache> cache;
+        if (cache_entries > 0) {
+            cache = std::make_unique<PredictionCache>(cache_entries);
+            pool_options.cache = cache.get();
+        }
+        Metrics metrics;
+        pool_options.metrics = &metrics;
+        InferencePool pool(source, pool_options);
+        if (arena) {
+            std::cerr << "primed ";
+            arena->pool().writeSummary(std::cerr);
+        }
+        std::atomic<uint64_t> rejected{0};
+        // 须先于线程池析构：等它交给线程池的请求写回后才解除映射
+        std::unique_ptr<ShmServer> shm_server;
+        if (shm) {
+            shm_server = std::make_unique<ShmServer>(pool, shm_options);
+        }
+
+        auto predict = [&](const HttpRequest& req, HttpResponse& resp, bool batch) {
+            const bool f32 = req.content_type == kFloatContentType;
+            const size_t image_bytes = MNIST_IMAGE_SIZE * (f32 ? sizeof(float) : 1);
+            if (req.body_size == 0 || req.body_size % image_bytes != 0) {
+                resp.status = 400;
+                resp.body = "body must hold whole 28x28 images (" + std::to_string(image_bytes) + " bytes each)\n";
+                return;
+            }
+            const size_t n = req.body_size / image_bytes;
+            if (!batch && n != 1) {
+                resp.status = 400;
+                resp.body = "/predict takes exactly one image; use /predict/batch\n";
+                return;
+            }
+
+            // float 图像原地提交，请求体缓冲在本函数返回（所有结果写回）之前保持有效；
+            // u8 图像在拷进图像槽位时转换
+            thread_local RequestResults in_place;
+            std::vector<std::future<Prediction>> results;
+            if (f32) {
+                in_place.reset(n);
+            } else {
+                results.resize(n);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                const bool queued = f32
+                    ? pool.TrySubmitInPlace(reinterpret_cast<const float*>(req.body) + i * MNIST_IMAGE_SIZE, in_place, i)
+                    : pool.TrySubmit(req.body + i * MNIST_IMAGE_SIZE, results[i]);
+                if (!queued) {
+                    // 队列已满：已提交的图像照常算完，整个请求以 503 拒绝
+                    if (f32) {
+                        in_place.wait(i);
+                    }
+                    for (size_t j = 0; j < results.size() && j < i; ++j) {
+                        results[j].wait();
+                    }
+                    rejected.fetch_add(1, std::memory_order_relaxed);
+                    resp.status = 503;
+                    resp.headers.emplace_back("Retry-After", "1");
+                    resp.body = "inference queue full\n";
+                    return;
+                }
+            }
+
+            if (f32) {
+                in_place.wait(n);
+            }
+            resp.content_type = "application/json";
+            resp.body.reserve(n * 160 + 32);
+            if (batch) {
+                resp.body = "{\"predictions\":[";
+            }
+            for (size_t i = 0; i < n; ++i) {
+                if (i) {
+                    resp.body += ',';
+                }
+                appendPrediction(resp.body, f32 ? in_place.get(i) : results[i].get());
+            }
+            resp.body += batch ? "]}\n" : "\n";
+        };
+
+        // 在连接线程上切分画布，各个数字作为 u8 图像提交，通常落进同一个微批
+        auto predictDigits = [&](const HttpRequest& req, HttpResponse& resp) {
+            const long w = queryValue(req.query, "width");
+            const long h = queryValue(req.query, "height");
+            if (w <= 0 || h <= 0 || static_cast<size_t>(w) * h != req.body_size) {
+                resp.status = 400;
+                resp.body = "need ?width=W&height=H matching a W*H byte gray canvas\n";
+                return;
+            }
+            thread_local DigitSegmenter segmenter;
+            const size_t n = segmenter.segment(req.body, static_cast<int>(w), static_cast<int>(h), PixelFormat::Gray8);
+            if (n > max_images) {
+                resp.status = 413;
+                resp.body = "too many digits on the canvas\n";
+                return;
+            }
+            std::vector<std::future<Prediction>> results(n);
+            uint8_t image[MNIST_IMAGE_SIZE];
+            for (size_t i = 0; i < n; ++i) {
+                segmenter.normalize(i, image);
+                if (!pool.TrySubmit(image, results[i])) {
+                    for (size_t j = 0; j < i; ++j) {
+                        results[j].wait();
+                    }
+                    rejected.fetch_add(1, std::memory_order_relaxed);
+                    resp.status = 503;
+                    resp.headers.emplace_back("Retry-After", "1");
+                    resp.body = "inference queue full\n";
+                    return;
+                }
+            }
+
+            std::string text(n, '0');
+            std::string predictions;
+            for (size_t i = 0; i < n; ++i) {
+                const Prediction p = results[i].get();
+                text[i] = static_cast<char>('0' + p.digit);
+                if (i) {
+                    predictions += ',';
+                }
+                appendPrediction(predictions, p, &segmenter.segments()[i].box);
+            }
+            resp.content_type = "application/json";
+            resp.body = "{\"digits\":\"" + text + "\",\"predictions\":[" + predictions + "]}\n";
+        };
+
+        HttpServer* server_ptr = nullptr;
+        HttpServer server(http, [&](const HttpRequest& req, HttpResponse& resp) {
+            const bool post = req.method == "POST";
+            if (req.path == "/predict" || req.path == "/predict/batch") {
+                if (!post) {
+                    resp.status = 405;
+                    resp.headers.emplace_back("Allow", "POST");
+                    resp.body = "use POST\n";
+                    return;
+                }
+                predict(req, resp, req.path == "/predict/batch");
+            } else if (req.path == "/predict/digits") {
+                if (!post) {
+                    resp.status = 405;
+                    resp.headers.emplace_back("Allow", "POST");
+                    resp.body = "use POST\n";
+                    return;
+                }
+                predictDigits(req, resp);
+            } else if (req.path == "/healthz") {
+                resp.body = "ok\n";
+            } else if (req.path == "/metrics") {
+                std::ostringstream out;
+                metrics.writePrometheus(out);
+                if (arena) {
+                    arena->pool().writePrometheus(out);
+                }
+                if (cache) {
+                    cache->writePrometheus(out);
+                }
+                out << "# HELP mnist_queue_depth Images waiting in the inference queue.\n"
+                    << "# TYPE mnist_queue_depth gauge\n"
+                    << "mnist_queue_depth " << pool.queued() << '\n'
+                    << "# HELP mnist_rejected_total Requests refused with 503 because the queue was full.\n"
+                    << "# TYPE mnist_rejected_total counter\n"
+                    << "mnist_rejected_total " << rejected.load(std::memory_order_relaxed) << '\n'
+                    << "# HELP mnist_connections Open HTTP connections.\n"
+                    << "# TYPE mnist_connections gauge\n"
+                    << "mnist_connections " << server_ptr->connections() << '\n';
+                if (shm_server) {
+                    out << "# HELP mnist_shm_clients Clients holding a shared-memory lane.\n"
+                        << "# TYPE mnist_shm_clients gauge\n"
+                        << "mnist_shm_clients " << shm_server->clients() << '\n'
+                        << "# HELP mnist_shm_served_total Images answered over shared memory.\n"
+                        << "# TYPE mnist_shm_served_total counter\n"
+                        << "mnist_shm_served_total " << shm_server->served() << '\n';
+                }
+                resp.content_type = "text/plain; version=0.0.4";
+                resp.body = out.str();
+            } else {
+                resp.status = 404;
+                resp.body = "not found\n";
+            }
+        });
+        server_ptr = &server;
+
+        // 收到 SIGINT / SIGTERM 时停止接受连接；serve() 等处理中的请求写回后返回
+        std::thread signal_waiter([&] {
+            int signal = 0;
+            sigwait(&signals, &signal);
+            server.stop();
+        });
+
+        std::cerr << "Listening on " << http.address << ':' << server.port() << " (" << pool.workerCount()
+                  << " workers, micro-batch " << pool.options().max_batch << ")" << std::endl;
+        if (shm_server) {
+            std::cerr << "Serving shared memory at " << shm_options.name << " (" << shm_options.lanes << " lanes x "
+                      << shm_options.depth << " slots)" << std::endl;
+        }
+        server.serve();
+
+        // serve() 因其他原因返回时，叫醒等待信号的线程
+        pthread_kill(signal_waiter.native_handle(), SIGTERM);
+        signal_waiter.join();
+        std::cerr << "Shutting down" << std::endl;
+        metrics.writeSummary(std::cerr);
+        if (arena) {
+            arena->pool().writeSummary(std::cerr);
+        }
+        if (cache) {
+            cache->writeSummary(std::cerr);
+        }
+    } catch(const Ort::Exception& e) {
+        std::cerr << "ONNX Runtime error: " << e.what() << std::endl;
+        return -1;
+    } catch(const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
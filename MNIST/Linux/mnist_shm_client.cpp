@@ -0,0 +1,120 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+#include "ShmTransport.h"
+#include "IdxFile.h"
+#include "Preprocess.h"
+
+//--------------------------------------------------------------------
+// 共享内存通道的客户端示例：把 MNIST IDX（或原始 u8 28×28 流）中的图像
+// 直接转换进 mnist_server --shm 的槽位，保持最多 depth 个请求在途，
+// 输出每张图的预测结果，并统计往返延迟与吞吐。不依赖 ORT
+//--------------------------------------------------------------------
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] <images>\n"
+              << "  --shm <name>     shared memory of the server (default: /mnist)\n"
+              << "  --raw            input is a raw u8 28x28 stream instead of IDX\n"
+              << "  --labels <idx>   also report accuracy against these labels\n"
+              << "  --depth <n>      requests in flight (default: the server's lane depth)\n"
+              << "  --quiet          print only the summary\n";
+}
+
+int main(int argc, char* argv[])
+{
+    std::string name = "/mnist";
+    const char* images_path = nullptr;
+    const char* labels_path = nullptr;
+    bool raw = false, quiet = false;
+    uint32_t depth = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--shm") && i + 1 < argc) {
+            name = argv[++i];
+        } else if (!std::strcmp(argv[i], "--raw")) {
+            raw = true;
+        } else if (!std::strcmp(argv[i], "--labels") && i + 1 < argc) {
+            labels_path = argv[++i];
+        } else if (!std::strcmp(argv[i], "--depth") && i + 1 < argc) {
+            depth = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (!std::strcmp(argv[i], "--quiet")) {
+            quiet = true;
+        } else if (argv[i][0] != '-' && !images_path) {
+            images_path = argv[i];
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (!images_path) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    try {
+        IdxFile images(images_path, raw);
+        if (images.sampleSize() != kShmImageSize || images.count() == 0) {
+            throw std::runtime_error("need at least one 28x28 image");
+        }
+        std::unique_ptr<IdxFile> labels;
+        if (labels_path) {
+            labels = std::make_unique<IdxFile>(labels_path);
+            if (labels->count() < images.count() || labels->sampleSize() != 1) {
+                throw std::runtime_error("labels do not match the images");
+            }
+        }
+
+        ShmClient client(name);
+        depth = depth ? std::min(depth, client.depth()) : client.depth();
+        if (!client.serverRunning()) {
+            std::cerr << "No server is running on " << name << "; requests wait until one starts" << std::endl;
+        }
+
+        using Clock = std::chrono::steady_clock;
+        const size_t n = images.count();
+        std::vector<Clock::time_point> submitted(n);
+        std::vector<double> latency_us(n);
+        size_t next = 0, done = 0, correct = 0;
+        const Clock::time_point start = Clock::now();
+        while (done < n) {
+            // 槽位空闲就把下一张图像直接转换进共享内存
+            while (next < n && client.pending() < depth) {
+                float* slot = client.acquire();
+                grayToTensor(images.sample(next), kShmImageSize, slot);
+                submitted[next] = Clock::now();
+                client.submit();
+                ++next;
+            }
+            const ShmResult r = client.wait();
+            latency_us[done] = std::chrono::duration<double, std::micro>(Clock::now() - submitted[done]).count();
+            if (labels && r.digit == labels->sample(done)[0]) {
+                ++correct;
+            }
+            if (!quiet) {
+                std::printf("%zu %d\n", done, r.digit);
+            }
+            ++done;
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::sort(latency_us.begin(), latency_us.end());
+        auto quantile = [&](double q) { return latency_us[std::min(n - 1, static_cast<size_t>(q * n))]; };
+        std::cerr << n << " images in " << seconds << " s (" << n / seconds << " images/sec, depth " << depth
+                  << "), round trip p50 " << quantile(0.5) << " us, p99 " << quantile(0.99) << " us" << std::endl;
+        if (labels) {
+            std::cerr << "accuracy " << static_cast<double>(correct) / n << std::endl;
+        }
+    } catch(const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
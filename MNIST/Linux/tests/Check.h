@@ -0,0 +1,89 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <exception>
+
+//--------------------------------------------------------------------
+// 单元测试用的极简框架（不依赖 ORT 与第三方库）：
+//   TEST(suite, name) { ... }   注册一个用例
+//   CHECK(cond) / CHECK_EQ(a, b) / CHECK_NEAR(a, b, tol) / CHECK_THROWS(expr, text)
+// 断言失败时记下位置并继续执行本用例；用例里抛出的异常也算失败。
+// mnist_tests <suite> 只运行一个套件，ctest 为每个套件注册一个测试
+//--------------------------------------------------------------------
+struct TestCase {
+    const char* suite;
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<TestCase>& testCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void testFailure(const char* file, int line, const std::string& what) {
+    ++testFailures();
+    std::cerr << file << ":" << line << ": " << what << std::endl;
+}
+
+struct TestRegistrar {
+    TestRegistrar(const char* suite, const char* name, void (*run)()) { testCases().push_back({suite, name, run}); }
+};
+
+#define TEST(suite, name)                                                                 \
+    static void suite##_##name();                                                         \
+    static const TestRegistrar suite##_##name##_registrar(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            testFailure(__FILE__, __LINE__, "CHECK(" #cond ") failed");    \
+        }                                                                    \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                  \
+    do {                                                                                \
+        const auto& check_a = (a);                                                      \
+        const auto& check_b = (b);                                                      \
+        if (!(check_a == check_b)) {                                                    \
+            std::ostringstream check_os;                                                \
+            check_os << "CHECK_EQ(" #a ", " #b ") failed: " << check_a << " vs " << check_b; \
+            testFailure(__FILE__, __LINE__, check_os.str());                           \
+        }                                                                               \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tolerance)                                                          \
+    do {                                                                                     \
+        const double check_a = (a), check_b = (b);                                           \
+        if (!(check_a - check_b <= (tolerance) && check_b - check_a <= (tolerance))) {       \
+            std::ostringstream check_os;                                                     \
+            check_os << "CHECK_NEAR(" #a ", " #b ") failed: " << check_a << " vs " << check_b; \
+            testFailure(__FILE__, __LINE__, check_os.str());                                \
+        }                                                                                    \
+    } while (0)
+
+// expr 须抛出 what() 中含 text 的 std::exception
+#define CHECK_THROWS(expr, text)                                                                      \
+    do {                                                                                              \
+        bool check_thrown = false;                                                                    \
+        try {                                                                                         \
+            expr;                                                                                     \
+        } catch (const std::exception& check_e) {                                                     \
+            check_thrown = true;                                                                      \
+            if (std::string(check_e.what()).find(text) == std::string::npos) {                        \
+                testFailure(__FILE__, __LINE__, std::string("unexpected error: ") + check_e.what());  \
+            }                                                                                         \
+        }                                                                                             \
+        if (!check_thrown) {                                                                          \
+            testFailure(__FILE__, __LINE__, "CHECK_THROWS(" #expr ") did not throw");                \
+        }                                                                                             \
+    } while (0)
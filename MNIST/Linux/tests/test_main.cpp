@@ -0,0 +1,41 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+
+#include "Check.h"
+
+//--------------------------------------------------------------------
+// 运行全部用例，或只运行命令行指定的套件；有失败时返回非 0
+//--------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    if (argc > 2) {
+        std::cerr << "Usage: " << argv[0] << " [suite]" << std::endl;
+        return -1;
+    }
+    const char* suite = argc == 2 ? argv[1] : nullptr;
+
+    int run = 0, failed = 0;
+    for (const TestCase& test : testCases()) {
+        if (suite && std::strcmp(test.suite, suite) != 0) {
+            continue;
+        }
+        std::cout << "[ RUN      ] " << test.suite << "." << test.name << std::endl;
+        const int before = testFailures();
+        try {
+            test.run();
+        } catch (const std::exception& e) {
+            testFailure(__FILE__, __LINE__, std::string("uncaught exception: ") + e.what());
+        }
+        const bool ok = testFailures() == before;
+        std::cout << (ok ? "[       OK ] " : "[  FAILED  ] ") << test.suite << "." << test.name << std::endl;
+        ++run;
+        failed += !ok;
+    }
+    if (run == 0) {
+        std::cerr << "No tests in suite " << (suite ? suite : "") << std::endl;
+        return -1;
+    }
+    std::cout << run - failed << " of " << run << " tests passed" << std::endl;
+    return failed ? 1 : 0;
+}
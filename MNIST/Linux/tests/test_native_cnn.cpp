@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+#include "Check.h"
+#include "NativeCnn.h"
+#include "OnnxProto.h"
+#include "ModelSource.h"
+
+//--------------------------------------------------------------------
+// OnnxProto.h / NativeCnn.h 的测试：FusedCnn 的输出与按 ONNX 图逐个节点计算的
+// 朴素参考实现对照（不经 ORT），以及解析器对截断、损坏的 protobuf 与其它结构模型的处理
+//--------------------------------------------------------------------
+namespace {
+
+std::string modelPath(const char* file) {
+    return std::string(MNIST_SOURCE_DIR) + "/" + file;
+}
+
+// 参考实现里的张量：行主序，double 累加
+struct RefTensor {
+    std::vector<int64_t> dims;
+    std::vector<double> data;
+};
+
+std::vector<int64_t> intsAttr(const OnnxNode& n, const char* name, std::vector<int64_t> fallback) {
+    const OnnxAttribute* a = n.attribute(name);
+    return a ? a->ints : fallback;
+}
+
+// numpy 式广播的逐元素加法
+RefTensor add(const RefTensor& a, const RefTensor& b) {
+    const size_t rank = std::max(a.dims.size(), b.dims.size());
+    auto padded = [rank](const std::vector<int64_t>& d) {
+        std::vector<int64_t> p(rank - d.size(), 1);
+        p.insert(p.end(), d.begin(), d.end());
+        return p;
+    };
+    const std::vector<int64_t> da = padded(a.dims), db = padded(b.dims);
+    RefTensor out;
+    for (size_t i = 0; i < rank; ++i) {
+        if (da[i] != db[i] && da[i] != 1 && db[i] != 1) {
+            throw std::runtime_error("Add shapes do not broadcast");
+        }
+        out.dims.push_back(std::max(da[i], db[i]));
+    }
+    size_t total = 1;
+    for (int64_t d : out.dims) total *= static_cast<size_t>(d);
+    out.data.resize(total);
+    std::vector<int64_t> index(rank, 0);
+    for (size_t flat = 0; flat < total; ++flat) {
+        size_t ia = 0, ib = 0;
+        for (size_t i = 0; i < rank; ++i) {
+            ia = ia * da[i] + (da[i] == 1 ? 0 : index[i]);
+            ib = ib * db[i] + (db[i] == 1 ? 0 : index[i]);
+        }
+        out.data[flat] = a.data[ia] + b.data[ib];
+        for (size_t i = rank; i-- > 0;) {
+            if (++index[i] < out.dims[i]) break;
+            index[i] = 0;
+        }
+    }
+    return out;
+}
+
+// NCHW 卷积，N = 1
+RefTensor conv(const OnnxNode& n, const RefTensor& x, const RefTensor& w, const RefTensor* bias) {
+    const int64_t in = x.dims[1], h = x.dims[2], wd = x.dims[3];
+    const int64_t out = w.dims[0], kh = w.dims[2], kw = w.dims[3];
+    const std::vector<int64_t> strides = intsAttr(n, "strides", {1, 1});
+    const OnnxAttribute* auto_pad = n.attribute("auto_pad");
+    int64_t top = 0, left = 0, oh, ow;
+    if (auto_pad && auto_pad->s.compare(0, 4, "SAME") == 0) {
+        oh = (h + strides[0] - 1) / strides[0];
+        ow = (wd + strides[1] - 1) / strides[1];
+        const int64_t ph = std::max<int64_t>(0, (oh - 1) * strides[0] + kh - h);
+        const int64_t pw = std::max<int64_t>(0, (ow - 1) * strides[1] + kw - wd);
+        const bool upper = auto_pad->s == "SAME_UPPER";
+        top = upper ? ph / 2 : (ph + 1) / 2;
+        left = upper ? pw / 2 : (pw + 1) / 2;
+    } else {
+        const std::vector<int64_t> pads = intsAttr(n, "pads", {0, 0, 0, 0});
+        top = pads[0];
+        left = pads[1];
+        oh = (h + pads[0] + pads[2] - kh) / strides[0] + 1;
+        ow = (wd + pads[1] + pads[3] - kw) / strides[1] + 1;
+    }
+    RefTensor y{{1, out, oh, ow}, std::vector<double>(static_cast<size_t>(out * oh * ow))};
+    for (int64_t o = 0; o < out; ++o) {
+        for (int64_t oy = 0; oy < oh; ++oy) {
+            for (int64_t ox = 0; ox < ow; ++ox) {
+                double s = bias ? bias->data[o] : 0.0;
+                for (int64_t c = 0; c < in; ++c) {
+                    for (int64_t ky = 0; ky < kh; ++ky) {
+                        for (int64_t kx = 0; kx < kw; ++kx) {
+                            const int64_t iy = oy * strides[0] + ky - top, ix = ox * strides[1] + kx - left;
+                            if (iy < 0 || ix < 0 || iy >= h || ix >= wd) continue;
+                            s += x.data[(c * h + iy) * wd + ix] * w.data[((o * in + c) * kh + ky) * kw + kx];
+                        }
+                    }
+                }
+                y.data[(o * oh + oy) * ow + ox] = s;
+            }
+        }
+    }
+    return y;
+}
+
+RefTensor maxPool(const OnnxNode& n, const RefTensor& x) {
+    const std::vector<int64_t> kernel = intsAttr(n, "kernel_shape", {});
+    const std::vector<int64_t> strides = intsAttr(n, "strides", {1, 1});
+    const int64_t c = x.dims[1], h = x.dims[2], w = x.dims[3];
+    const int64_t oh = (h - kernel[0]) / strides[0] + 1, ow = (w - kernel[1]) / strides[1] + 1;
+    RefTensor y{{1, c, oh, ow}, std::vector<double>(static_cast<size_t>(c * oh * ow))};
+    for (int64_t ch = 0; ch < c; ++ch) {
+        for (int64_t oy = 0; oy < oh; ++oy) {
+            for (int64_t ox = 0; ox < ow; ++ox) {
+                double m = -INFINITY;
+                for (int64_t ky = 0; ky < kernel[0]; ++ky) {
+                    for (int64_t kx = 0; kx < kernel[1]; ++kx) {
+                        m = std::max(m, x.data[(ch * h + oy * strides[0] + ky) * w + ox * strides[1] + kx]);
+                    }
+                }
+                y.data[(ch * oh + oy) * ow + ox] = m;
+            }
+        }
+    }
+    return y;
+}
+
+RefTensor matMul(const RefTensor& a, const RefTensor& b) {
+    const int64_t m = a.dims[0], k = a.dims[1], n = b.dims[1];
+    if (b.dims[0] != k) throw std::runtime_error("MatMul shapes do not match");
+    RefTensor y{{m, n}, std::vector<double>(static_cast<size_t>(m * n), 0.0)};
+    for (int64_t i = 0; i < m; ++i) {
+        for (int64_t j = 0; j < n; ++j) {
+            for (int64_t t = 0; t < k; ++t) {
+                y.data[i * n + j] += a.data[i * k + t] * b.data[t * n + j];
+            }
+        }
+    }
+    return y;
+}
+
+// 按图中节点的顺序计算一张 28×28 图像的输出；权重直接取自解析出的 initializer
+std::vector<double> referenceForward(const OnnxGraph& graph, const float* image) {
+    std::map<std::string, RefTensor> values;
+    std::map<std::string, std::vector<int64_t>> shapes;
+    for (const OnnxTensor& t : graph.initializers) {
+        if (t.data_type == 1) {
+            values[t.name] = {t.dims, std::vector<double>(t.floats.begin(), t.floats.end())};
+        } else if (t.data_type == 7) {
+            shapes[t.name] = t.ints;
+        }
+    }
+    for (const std::string& input : graph.inputs) {
+        if (!graph.initializer(input)) {
+            values[input] = {{1, 1, 28, 28}, std::vector<double>(image, image + 28 * 28)};
+        }
+    }
+    for (const OnnxNode& n : graph.nodes) {
+        const RefTensor& x = values.at(n.inputs.at(0));
+        RefTensor y;
+        if (n.op_type == "Conv") {
+            y = conv(n, x, values.at(n.inputs.at(1)), n.inputs.size() > 2 ? &values.at(n.inputs[2]) : nullptr);
+        } else if (n.op_type == "Add") {
+            y = add(x, values.at(n.inputs.at(1)));
+        } else if (n.op_type == "Relu") {
+            y = x;
+            for (double& v : y.data) v = std::max(v, 0.0);
+        } else if (n.op_type == "MaxPool") {
+            y = maxPool(n, x);
+        } else if (n.op_type == "MatMul") {
+            y = matMul(x, values.at(n.inputs.at(1)));
+        } else if (n.op_type == "Reshape") {
+            // 0 沿用原来的维度，-1 由元素总数推出
+            y.data = x.data;
+            y.dims = shapes.at(n.inputs.at(1));
+            int64_t known = 1, infer = -1;
+            for (size_t i = 0; i < y.dims.size(); ++i) {
+                if (y.dims[i] == 0) y.dims[i] = x.dims.at(i);
+                if (y.dims[i] == -1) infer = static_cast<int64_t>(i);
+                else known *= y.dims[i];
+            }
+            if (infer >= 0) y.dims[infer] = static_cast<int64_t>(x.data.size()) / known;
+        } else {
+            throw std::runtime_error("reference forward does not support " + n.op_type);
+        }
+        values[n.outputs.at(0)] = std::move(y);
+    }
+    return values.at(graph.outputs.at(0)).data;
+}
+
+// 与 MNIST 笔画相近的稀疏随机图像，外加全 0 与全 1 两张边界图像
+std::vector<float> testImages(size_t n) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    std::vector<float> images(n * 28 * 28);
+    for (float& v : images) v = u(rng) < 0.2f ? u(rng) : 0.0f;
+    std::fill(images.begin(), images.begin() + 28 * 28, 0.0f);
+    std::fill(images.begin() + 28 * 28, images.begin() + 2 * 28 * 28, 1.0f);
+    return images;
+}
+
+void checkMatchesReference(const char* file) {
+    MappedFile model(modelPath(file));
+    const OnnxGraph graph = parseOnnxGraph(model.data(), model.size());
+    auto net = std::make_unique<MnistCnn>();
+    loadMnistCnn(*net, ModelSource::fromMemory(model.data(), model.size(), file));
+
+    constexpr size_t kImages = 64;
+    const std::vector<float> images = testImages(kImages);
+    std::vector<float> logits(kImages * 10);
+    mnistCnnForward(*net, images.data(), kImages, logits.data());
+    double max_diff = 0;
+    for (size_t i = 0; i < kImages; ++i) {
+        const std::vector<double> ref = referenceForward(graph, &images[i * 28 * 28]);
+        CHECK_EQ(ref.size(), size_t(10));
+        for (size_t c = 0; c < 10; ++c) {
+            max_diff = std::max(max_diff, std::fabs(ref[c] - logits[i * 10 + c]));
+        }
+        CHECK_EQ(std::max_element(ref.begin(), ref.end()) - ref.begin(),
+                 std::max_element(&logits[i * 10], &logits[i * 10] + 10) - &logits[i * 10]);
+    }
+    CHECK_NEAR(max_diff, 0.0, 1e-5);
+
+    // 从文件路径载入与从内存载入得到同样的权重，逐张计算与批量计算一致
+    auto from_file = std::make_unique<MnistCnn>();
+    loadMnistCnn(*from_file, modelPath(file).c_str());
+    for (size_t i = 0; i < kImages; ++i) {
+        float single[10];
+        mnistCnnForward(*from_file, &images[i * 28 * 28], 1, single);
+        for (size_t c = 0; c < 10; ++c) {
+            CHECK_EQ(single[c], logits[i * 10 + c]);
+        }
+    }
+}
+
+// 按字节拼出测试用的 protobuf
+std::vector<uint8_t> bytes(std::initializer_list<int> values) {
+    return std::vector<uint8_t>(values.begin(), values.end());
+}
+
+void checkMalformed(const std::vector<uint8_t>& data, const char* error) {
+    CHECK_THROWS(parseOnnxGraph(data.data(), data.size()), error);
+}
+
+}  // namespace
+
+TEST(native_cnn, matches_reference_mnist) {
+    checkMatchesReference("mnist.onnx");
+}
+
+TEST(native_cnn, matches_reference_mnist_batch) {
+    checkMatchesReference("mnist_batch.onnx");
+}
+
+TEST(native_cnn, rejects_quantized_graphs) {
+    auto net = std::make_unique<MnistCnn>();
+    for (const char* file : {"mnist_batch_fp16.onnx", "mnist_batch_int8.onnx"}) {
+        CHECK_THROWS(loadMnistCnn(*net, modelPath(file).c_str()), "model does not match the native CNN");
+    }
+}
+
+TEST(onnx_proto, parses_mnist_graph) {
+    MappedFile model(modelPath("mnist.onnx"));
+    const OnnxGraph graph = parseOnnxGraph(model.data(), model.size());
+    CHECK_EQ(graph.nodes.size(), size_t(12));
+    CHECK_EQ(graph.initializers.size(), size_t(8));
+    CHECK_EQ(graph.outputs.size(), size_t(1));
+    CHECK_EQ(graph.outputs[0], std::string("Plus214_Output_0"));
+    const OnnxTensor* w = graph.initializer("Parameter87");
+    CHECK(w != nullptr);
+    CHECK(w->dims == std::vector<int64_t>({16, 8, 5, 5}));
+    CHECK_EQ(w->floats.size(), w->elementCount());
+    const OnnxTensor* shape = graph.initializer("Pooling160_Output_0_reshape0_shape");
+    CHECK(shape != nullptr);
+    CHECK(shape->ints == std::vector<int64_t>({1, 256}));
+    const OnnxNode* conv = graph.consumer("Input3");
+    CHECK(conv != nullptr);
+    CHECK_EQ(conv->op_type, std::string("Conv"));
+    CHECK_EQ(conv->attribute("auto_pad")->s, std::string("SAME_UPPER"));
+    CHECK(conv->attribute("kernel_shape")->ints == std::vector<int64_t>({5, 5}));
+}
+
+TEST(onnx_proto, rejects_truncated_models) {
+    // 截在任何位置都只能抛出异常，或（截在 graph 之后时）得到完整的图，不能读越界或返回半张图
+    MappedFile model(modelPath("mnist.onnx"));
+    const OnnxGraph full = parseOnnxGraph(model.data(), model.size());
+    size_t complete = 0;
+    for (size_t size = 0; size < model.size(); ++size) {
+        std::vector<uint8_t> prefix(static_cast<const uint8_t*>(model.data()),
+                                    static_cast<const uint8_t*>(model.data()) + size);
+        try {
+            const OnnxGraph g = parseOnnxGraph(prefix.data(), prefix.size());
+            CHECK_EQ(g.nodes.size(), full.nodes.size());
+            CHECK_EQ(g.initializers.size(), full.initializers.size());
+            ++complete;
+        } catch (const std::runtime_error& e) {
+            const std::string what = e.what();
+            CHECK(what == "malformed ONNX model" || what == "not an ONNX model (no graph)");
+        }
+    }
+    // 只有 graph 之后的少数尾部字段可以被截掉
+    CHECK(complete < 64);
+}
+
+TEST(onnx_proto, rejects_malformed_protobuf) {
+    checkMalformed({}, "no graph");
+    checkMalformed(bytes({0x08, 0x07}), "no graph");                       // 只有 ir_version
+    checkMalformed(bytes({0x08, 0xff, 0xff}), "malformed");                // 未结束的 varint
+    checkMalformed(bytes({0x08, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01}),
+                   "malformed");                                           // 超过 10 字节的 varint
+    checkMalformed(bytes({0x3a, 0x05, 0x0a}), "malformed");                // graph 的长度超出数据
+    checkMalformed(bytes({0x3a, 0xff, 0xff, 0xff, 0xff, 0x0f}), "malformed");  // 巨大的长度
+    checkMalformed(bytes({0x0b}), "malformed");                            // 不支持的线类型（group）
+    checkMalformed(bytes({0x09, 0x00, 0x00}), "malformed");                // 截断的 fixed64
+    checkMalformed(bytes({0x15, 0x00}), "malformed");                      // 截断的 fixed32
+    checkMalformed(bytes({0x3a, 0x03, 0x0a, 0x05, 0x0a}), "malformed");    // graph 里的节点越界
+    // 外部数据的 initializer：graph { initializer { data_location = EXTERNAL } }
+    checkMalformed(bytes({0x3a, 0x04, 0x2a, 0x02, 0x70, 0x01}), "external data");
+
+    // 合法的空 graph 与未知字段
+    const std::vector<uint8_t> empty_graph = bytes({0x08, 0x07, 0x3a, 0x00, 0x92, 0x01, 0x01, 0x00});
+    const OnnxGraph g = parseOnnxGraph(empty_graph.data(), empty_graph.size());
+    CHECK(g.nodes.empty());
+    CHECK(g.initializers.empty());
+}
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include "Check.h"
+#include "Segmentation.h"
+
+//--------------------------------------------------------------------
+// DigitSegmenter（Segmentation.h）的测试：在小的合成画布上画出矩形笔画，
+// 核对切分出的数字个数、外接框与归一化结果
+//--------------------------------------------------------------------
+namespace {
+
+// Gray8 画布：0 = 背景，255 = 笔迹
+struct Canvas {
+    Canvas(int w, int h) : width(w), height(h), pixels(static_cast<size_t>(w) * h, 0) {}
+
+    // 把 [x0, x1) × [y0, y1) 涂成 value
+    Canvas& fill(int x0, int y0, int x1, int y1, uint8_t value = 255) {
+        for (int y = y0; y < y1; ++y) {
+            std::fill(&pixels[static_cast<size_t>(y) * width + x0], &pixels[static_cast<size_t>(y) * width + x1], value);
+        }
+        return *this;
+    }
+
+    // 同一画布的 RGBA8888 版本（白底黑字）
+    std::vector<uint8_t> rgba() const {
+        std::vector<uint8_t> out(pixels.size() * 4);
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            const uint32_t c = 255u - pixels[i];
+            const uint32_t p = (c << 24) | (c << 16) | (c << 8) | 0xffu;
+            std::memcpy(&out[i * 4], &p, 4);
+        }
+        return out;
+    }
+
+    size_t segment(DigitSegmenter& segmenter) const {
+        return segmenter.segment(pixels.data(), width, height, PixelFormat::Gray8);
+    }
+
+    int width, height;
+    std::vector<uint8_t> pixels;
+};
+
+bool boxIs(const DirtyRect& box, int x0, int y0, int x1, int y1) {
+    return box.x0 == x0 && box.y0 == y0 && box.x1 == x1 && box.y1 == y1;
+}
+
+std::vector<float> normalized(DigitSegmenter& segmenter, size_t i) {
+    std::vector<float> out(28 * 28);
+    segmenter.normalize(i, out.data());
+    return out;
+}
+
+float inkOf(const std::vector<float>& image) {
+    float sum = 0;
+    for (float v : image) sum += v;
+    return sum;
+}
+
+}  // namespace
+
+TEST(segmentation, empty_canvas) {
+    DigitSegmenter segmenter;
+    CHECK_EQ(Canvas(64, 32).segment(segmenter), size_t(0));
+    CHECK(segmenter.segments().empty());
+
+    // 同一个切分器换画布重用：上一张画布的数字不会留下
+    Canvas digits(64, 32);
+    digits.fill(10, 4, 14, 28);
+    CHECK_EQ(digits.segment(segmenter), size_t(1));
+    CHECK_EQ(Canvas(64, 32).segment(segmenter), size_t(0));
+}
+
+TEST(segmentation, two_separate_digits) {
+    // 右边一个"0"、左边一个"1"，按从左到右的顺序返回
+    Canvas canvas(80, 40);
+    canvas.fill(44, 5, 62, 9).fill(44, 31, 62, 35).fill(44, 5, 48, 35).fill(58, 5, 62, 35);
+    canvas.fill(12, 5, 16, 35);
+    DigitSegmenter segmenter;
+    CHECK_EQ(canvas.segment(segmenter), size_t(2));
+    CHECK(boxIs(segmenter.segments()[0].box, 12, 5, 16, 35));
+    CHECK(boxIs(segmenter.segments()[1].box, 44, 5, 62, 35));
+    CHECK_EQ(segmenter.segments()[0].mass, uint64_t(4 * 30 * 255));
+
+    // 各自按 MNIST 方式归一化：竖笔画缩放后高 20 像素，居中放在 28×28 里
+    const std::vector<float> one = normalized(segmenter, 0);
+    CHECK(inkOf(one) > 0);
+    for (int x = 0; x < 28; ++x) {
+        CHECK_EQ(one[x], 0.0f);
+        CHECK_EQ(one[27 * 28 + x], 0.0f);
+    }
+    CHECK(one[14 * 28 + 14] > 0.5f);
+    const std::vector<float> zero = normalized(segmenter, 1);
+    CHECK(zero[14 * 28 + 14] < 0.1f);
+
+    // RGBA 画布得到同样的切分
+    const std::vector<uint8_t> rgba = canvas.rgba();
+    CHECK_EQ(segmenter.segment(rgba.data(), canvas.width, canvas.height), size_t(2));
+    CHECK(boxIs(segmenter.segments()[1].box, 44, 5, 62, 35));
+}
+
+TEST(segmentation, two_stroke_four) {
+    // 分两笔写的"4"：一笔是左竖加横，另一笔是右边不与横相连的竖。两个连通域横向重叠，并成一个数字
+    Canvas canvas(60, 40);
+    canvas.fill(10, 5, 13, 25).fill(10, 22, 34, 25);
+    canvas.fill(26, 2, 29, 20);
+    DigitSegmenter segmenter;
+    CHECK_EQ(canvas.segment(segmenter), size_t(1));
+    CHECK(boxIs(segmenter.segments()[0].box, 10, 2, 34, 25));
+    CHECK_EQ(segmenter.segments()[0].mass, uint64_t((3 * 20 + 24 * 3 - 3 * 3 + 3 * 18) * 255));
+
+    // 两个连通域的像素都进入归一化后的图像
+    Canvas first_stroke(60, 40);
+    first_stroke.fill(10, 5, 13, 25).fill(10, 22, 34, 25);
+    DigitSegmenter partial;
+    CHECK_EQ(first_stroke.segment(partial), size_t(1));
+    CHECK(inkOf(normalized(segmenter, 0)) > inkOf(normalized(partial, 0)));
+}
+
+TEST(segmentation, speck_removed) {
+    // 墨迹不足 min_pixels 个满浓度像素的斑点丢弃，不影响数字的编号
+    Canvas canvas(60, 40);
+    canvas.fill(3, 3, 6, 6);
+    canvas.fill(30, 5, 34, 35);
+    canvas.fill(50, 30, 52, 32);
+    DigitSegmenter segmenter;
+    CHECK_EQ(canvas.segment(segmenter), size_t(1));
+    CHECK(boxIs(segmenter.segments()[0].box, 30, 5, 34, 35));
+
+    CHECK_EQ(Canvas(60, 40).fill(20, 20, 23, 23).segment(segmenter), size_t(0));
+    segmenter.min_pixels = 9;
+    CHECK_EQ(Canvas(60, 40).fill(20, 20, 23, 23).segment(segmenter), size_t(1));
+}
+
+TEST(segmentation, touching_antialiased_edges) {
+    // 两个数字的淡边（低于 ink_threshold）相接，不能把它们连成一个
+    Canvas canvas(60, 40);
+    canvas.fill(10, 5, 20, 35).fill(20, 5, 21, 35, 40);
+    canvas.fill(21, 10, 22, 38, 40).fill(22, 10, 32, 38);
+    DigitSegmenter segmenter;
+    CHECK_EQ(canvas.segment(segmenter), size_t(2));
+    CHECK(boxIs(segmenter.segments()[0].box, 10, 5, 20, 35));
+    CHECK(boxIs(segmenter.segments()[1].box, 22, 10, 32, 38));
+
+    // 相接处是实笔画时就是同一个连通域
+    canvas.fill(20, 20, 22, 22, 200);
+    CHECK_EQ(canvas.segment(segmenter), size_t(1));
+    CHECK(boxIs(segmenter.segments()[0].box, 10, 5, 32, 38));
+}
+
+TEST(segmentation, neighbour_ink_excluded) {
+    // 右边数字的竖笔画伸进了左边数字的外接框，但横向重叠不足，仍是两个数字；
+    // 左边数字归一化时不带入它
+    Canvas canvas(60, 40);
+    canvas.fill(10, 10, 13, 33).fill(10, 30, 30, 33);
+    canvas.fill(26, 2, 29, 20).fill(26, 2, 46, 5);
+    DigitSegmenter segmenter;
+    CHECK_EQ(canvas.segment(segmenter), size_t(2));
+    CHECK(boxIs(segmenter.segments()[0].box, 10, 10, 30, 33));
+    CHECK(boxIs(segmenter.segments()[1].box, 26, 2, 46, 20));
+
+    Canvas alone(60, 40);
+    alone.fill(10, 10, 13, 33).fill(10, 30, 30, 33);
+    DigitSegmenter reference;
+    CHECK_EQ(alone.segment(reference), size_t(1));
+    CHECK(normalized(segmenter, 0) == normalized(reference, 0));
+}
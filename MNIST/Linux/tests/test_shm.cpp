@@ -0,0 +1,358 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Check.h"
+#include "ShmServer.h"
+#include "ShmTransport.h"
+
+//--------------------------------------------------------------------
+// 共享内存通道（ShmTransport.h / ShmServer.h）的测试。服务端接的是桩线程池，
+// 不需要 ORT；服务端重启与客户端死亡用 fork 出的子进程模拟
+//--------------------------------------------------------------------
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct StubResult {
+    int digit = -1;
+    std::array<float, kShmClasses> probabilities{};
+};
+
+struct StubCompletion {
+    using Result = StubResult;
+
+    virtual ~StubCompletion() = default;
+    virtual void complete(uint64_t tag, const Result& result) = 0;
+    virtual void fail(uint64_t tag, std::exception_ptr error) = 0;
+};
+
+// 代替 InferencePool：一个工作线程把 image[0] * 10 当作数字作答，image[0] < 0 时报错。
+// 只回答前 answer_limit 个请求，之后的请求一直挂着不写回，模拟服务端崩溃时还在推理中的请求。
+// 队列只有 kCapacity 个位置，满时 TrySubmitInPlace 返回 false
+struct StubPool {
+    using Completion = StubCompletion;
+
+    static constexpr size_t kCapacity = 4;
+
+    explicit StubPool(size_t answer_limit = SIZE_MAX) : answer_limit_(answer_limit) {
+        worker_ = std::thread([this] { run(); });
+    }
+
+    ~StubPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+    }
+
+    bool TrySubmitInPlace(const float* image, Completion& done, uint64_t tag) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (jobs_.size() >= kCapacity) {
+            return false;
+        }
+        jobs_.push_back({image, &done, tag});
+        cv_.notify_one();
+        return true;
+    }
+
+private:
+    struct Job {
+        const float* image;
+        Completion* done;
+        uint64_t tag;
+    };
+
+    void run() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+                if (stop_) {
+                    return;
+                }
+                job = jobs_.front();
+                jobs_.pop_front();
+                if (answered_ == answer_limit_) {
+                    continue;
+                }
+                ++answered_;
+            }
+            if (job.image[0] < 0) {
+                job.done->fail(job.tag, std::make_exception_ptr(std::runtime_error("negative pixel")));
+                continue;
+            }
+            StubResult result;
+            result.digit = static_cast<int>(job.image[0] * 10);
+            result.probabilities[result.digit] = 1;
+            job.done->complete(job.tag, result);
+        }
+    }
+
+    const size_t answer_limit_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;
+    size_t answered_ = 0;
+    bool stop_ = false;
+    std::thread worker_;
+};
+
+using StubServer = BasicShmServer<StubPool>;
+
+// 测试用的区域名，按 pid 区分，结束时删除
+struct RegionName {
+    explicit RegionName(const char* test) : name("/mnist_test_" + std::string(test) + "_" + std::to_string(::getpid())) {
+        ::shm_unlink(name.c_str());
+    }
+    ~RegionName() { ::shm_unlink(name.c_str()); }
+
+    const std::string name;
+};
+
+// StubPool 答出 digit 的图像
+std::vector<float> digitImage(int digit) {
+    std::vector<float> image(kShmImageSize, 0.0f);
+    image[0] = (digit + 0.5f) / 10;
+    return image;
+}
+
+// 从测试进程里直接查看区域（不认领通道）
+template <typename Fn>
+bool inspectRegion(const std::string& name, Fn&& fn) {
+    const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st{};
+    bool result = false;
+    if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= shm::headerBytes()) {
+        shm::Region region;
+        region.map(fd, static_cast<size_t>(st.st_size), name);
+        result = region.header().magic.load(std::memory_order_acquire) == kShmMagic && fn(region);
+    }
+    ::close(fd);
+    return result;
+}
+
+template <typename Fn>
+bool eventually(Fn&& fn, std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+    const Clock::time_point deadline = Clock::now() + timeout;
+    while (!fn()) {
+        if (Clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// fork 出的服务端进程：只回答前 answer_limit 个请求，直到被杀掉
+pid_t forkServer(const std::string& name, size_t answer_limit) {
+    const pid_t pid = ::fork();
+    if (pid == 0) {
+        try {
+            StubPool pool(answer_limit);
+            StubServer server(pool, {name, 2, 8});
+            for (;;) {
+                ::pause();
+            }
+        } catch (...) {
+        }
+        ::_exit(2);
+    }
+    return pid;
+}
+
+}  // namespace
+
+TEST(shm, submit_and_wait) {
+    RegionName region("submit");
+    StubPool pool;
+    StubServer server(pool, {region.name, 4, 8});
+    ShmClient client(region.name);
+    CHECK(client.serverRunning());
+    CHECK_EQ(client.depth(), 8u);
+    CHECK_EQ(server.clients(), size_t(1));
+
+    // 填满通道后 acquire() 返回 nullptr；结果按提交顺序取回
+    for (int i = 0; i < 8; ++i) {
+        float* slot = client.acquire();
+        CHECK(slot != nullptr);
+        const std::vector<float> image = digitImage(i);
+        std::copy(image.begin(), image.end(), slot);
+        client.submit();
+    }
+    CHECK(client.acquire() == nullptr);
+    CHECK_EQ(client.pending(), 8u);
+    for (int i = 0; i < 8; ++i) {
+        const ShmResult r = client.wait();
+        CHECK_EQ(r.digit, i);
+        CHECK_EQ(r.probabilities[i], 1.0f);
+    }
+    CHECK_EQ(client.pending(), 0u);
+
+    // poll() 不阻塞
+    CHECK(client.trySubmit(digitImage(6).data()));
+    ShmResult r;
+    CHECK(eventually([&] { return client.poll(r); }));
+    CHECK_EQ(r.digit, 6);
+
+    // 推理失败时 wait() 抛出服务端的错误信息，通道照常可用
+    std::vector<float> bad = digitImage(0);
+    bad[0] = -1;
+    CHECK_THROWS(client.classify(bad.data()), "inference failed: negative pixel");
+    CHECK_EQ(client.classify(digitImage(5).data()).digit, 5);
+    CHECK_EQ(server.served(), uint64_t(11));
+
+    // 分派线程睡在门铃上之后提交：客户端须敲门铃叫醒它，而不是等它 100 ms 一次的超时
+    Clock::duration slept{};
+    for (int i = 0; i < 10; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        const Clock::time_point start = Clock::now();
+        CHECK_EQ(client.classify(digitImage(i).data()).digit, i);
+        slept += Clock::now() - start;
+    }
+    CHECK(slept < std::chrono::milliseconds(300));
+}
+
+TEST(shm, concurrent_clients) {
+    RegionName region("concurrent");
+    StubPool pool;
+    StubServer server(pool, {region.name, 4, 8});
+
+    // 四个客户端各自保持满通道，线程池的队列比在途请求少，分派线程要反复等它腾出位置
+    constexpr int kClients = 4, kImages = 2000;
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kClients; ++t) {
+        threads.emplace_back([&, t] {
+            ShmClient client(region.name);
+            int next = 0, done = 0;
+            while (done < kImages) {
+                while (next < kImages && client.trySubmit(digitImage((next + t) % 10).data())) {
+                    ++next;
+                }
+                mismatches += client.wait().digit != (done + t) % 10;
+                ++done;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK_EQ(mismatches.load(), 0);
+    CHECK_EQ(server.served(), uint64_t(kClients * kImages));
+    CHECK_EQ(server.clients(), size_t(0));
+}
+
+TEST(shm, restart_with_requests_in_flight) {
+    RegionName region("restart");
+    const pid_t first = forkServer(region.name, 3);
+    CHECK(eventually([&] {
+        return inspectRegion(region.name, [&](shm::Region& r) { return r.header().server_pid.load() == first; });
+    }));
+
+    ShmClient client(region.name);
+    for (int i = 0; i < 6; ++i) {
+        CHECK(client.trySubmit(digitImage(i).data()));
+    }
+    // 第一个服务端只答了前三个：取回两个，第三个已作答但未取回，其余三个留在它的线程池里
+    CHECK_EQ(client.wait().digit, 0);
+    CHECK_EQ(client.wait().digit, 1);
+    CHECK(eventually([&] {
+        return inspectRegion(region.name, [](shm::Region& r) { return r.slot(0, 2).state.load() == shm::kDone; });
+    }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(inspectRegion(region.name, [](shm::Region& r) { return r.slot(0, 3).state.load() == shm::kQueued; }));
+
+    ::kill(first, SIGKILL);
+    ::waitpid(first, nullptr, 0);
+    CHECK(!client.serverRunning());
+    // 没有服务端时照常提交，请求留在共享内存里
+    CHECK(client.trySubmit(digitImage(6).data()));
+
+    // 同布局重启：复用区域，只重新推理未作答的槽位，客户端不重连
+    StubPool pool;
+    StubServer second(pool, {region.name, 2, 8});
+    CHECK(client.serverRunning());
+    for (int i = 2; i < 7; ++i) {
+        CHECK_EQ(client.wait().digit, i);
+    }
+    CHECK_EQ(second.served(), uint64_t(4));
+}
+
+TEST(shm, dead_client_lane_reclaimed) {
+    RegionName region("reclaim");
+    StubPool pool;
+    StubServer server(pool, {region.name, 1, 8});
+
+    // 唯一的通道被一个提交后不取回结果、也不交还通道就退出的客户端占着
+    const pid_t child = ::fork();
+    if (child == 0) {
+        try {
+            ShmClient client(region.name);
+            for (int i = 0; i < 4; ++i) {
+                client.trySubmit(digitImage(i).data());
+            }
+            ::_exit(client.wait().digit == 0 ? 0 : 1);
+        } catch (...) {
+        }
+        ::_exit(2);
+    }
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // 服务端算完它的请求后回收通道，新客户端随即能连上
+    bool connected = eventually([&] {
+        try {
+            ShmClient client(region.name);
+            CHECK_EQ(client.classify(digitImage(7).data()).digit, 7);
+            return true;
+        } catch (const std::runtime_error& e) {
+            CHECK(std::string(e.what()).find("lanes are in use") != std::string::npos);
+            return false;
+        }
+    });
+    CHECK(connected);
+    CHECK_EQ(server.served(), uint64_t(5));
+    CHECK_EQ(server.clients(), size_t(0));
+}
+
+TEST(shm, layout_change_retires_region) {
+    RegionName region("retire");
+    StubPool pool;
+    auto first = std::make_unique<StubServer>(pool, ShmServerOptions{region.name, 2, 4});
+    ShmClient old_client(region.name);
+    CHECK_EQ(old_client.classify(digitImage(1).data()).digit, 1);
+    first.reset();
+    CHECK(!old_client.serverRunning());
+
+    // 换了 depth 重启：旧区域被弃用，旧客户端的请求抛出异常，新客户端连到新区域
+    StubServer second(pool, {region.name, 2, 8});
+    CHECK(old_client.trySubmit(digitImage(2).data()));
+    ShmResult r;
+    CHECK_THROWS(old_client.wait(r, std::chrono::seconds(1)), "retired");
+
+    ShmClient client(region.name);
+    CHECK_EQ(client.depth(), 8u);
+    CHECK_EQ(client.classify(digitImage(3).data()).digit, 3);
+}